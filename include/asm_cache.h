@@ -0,0 +1,68 @@
+#ifndef ASM_CACHE_H
+#define ASM_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Content-addressed assembly cache
+//
+// Assembler output is stored under a key that hashes the source contents
+// together with the assembler version and options, so an unchanged source
+// is never parsed twice. Entries are files named by the key's hex digits in
+// one directory; a hit refreshes the entry's modification time, and a store
+// evicts the least recently used entries once the directory exceeds its
+// size limit.
+
+#define ASM_CACHE_DIR_DEFAULT   ".asm_cache"       // Override with CPU_SIM_CACHE_DIR
+#define ASM_CACHE_LIMIT_DEFAULT (64u * 1024 * 1024) // Bytes; override with CPU_SIM_CACHE_SIZE
+#define ASM_CACHE_KEY_HEX 32                       // 128-bit key as hex digits
+#define ASM_CACHE_PATH_MAX 4096
+
+typedef struct {
+    char hex[ASM_CACHE_KEY_HEX + 1];
+} AsmCacheKey;
+
+// Function Prototypes
+
+/**
+ * Checks whether caching is enabled (CPU_SIM_CACHE_DIR is not set to "off").
+ * @return 1 if enabled, 0 otherwise.
+ */
+int asm_cache_enabled(void);
+
+/**
+ * Hashes a source file with the assembler version and options (FNV-1a, 128-bit).
+ * @param source_file - Assembly source file.
+ * @param options - Every setting that changes the output, as text.
+ * @param key - Receives the key.
+ * @return 0 on success, -1 if the source cannot be read.
+ */
+int asm_cache_key(const char *source_file, const char *options, AsmCacheKey *key);
+
+/**
+ * Finds a cached entry and marks it as recently used.
+ * @param key - Key of the entry.
+ * @param path - Receives the entry's file name.
+ * @param size - Size of the path buffer.
+ * @return 1 on a hit, 0 on a miss.
+ */
+int asm_cache_lookup(const AsmCacheKey *key, char *path, size_t size);
+
+/**
+ * Copies a cached entry to an output file.
+ * @param key - Key of the entry.
+ * @param output_file - Destination.
+ * @return 1 on a hit (output written), 0 on a miss or if the copy failed.
+ */
+int asm_cache_fetch(const AsmCacheKey *key, const char *output_file);
+
+/**
+ * Stores a file under a key, then evicts least recently used entries until
+ * the cache fits its size limit. The entry appears atomically, so concurrent
+ * builds may share a cache directory. Failures only cost the cache entry.
+ * @param key - Key of the entry.
+ * @param file - Assembler output to store.
+ */
+void asm_cache_store(const AsmCacheKey *key, const char *file);
+
+#endif // ASM_CACHE_H
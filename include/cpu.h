@@ -5,7 +5,11 @@
 #include <stdbool.h>
 #include <stddef.h>
 
-#define NUM_REGISTERS 4 // Update this value to match your design
+// Size of the general-purpose register file. Override at build time with
+// `make NUM_REGISTERS=32` (4 to 32 registers are supported).
+#ifndef NUM_REGISTERS
+#define NUM_REGISTERS 16
+#endif
 
 
 // Define memory size (0x000 - 0x3FF => 1024 bytes)
@@ -25,6 +29,35 @@
 #define HEAP_START  0x300
 #define HEAP_END    0x400
 
+#include "heap.h" // Guest heap allocator state
+#include "isa.h"  // Instruction type for the predecoded stream
+#include "vector.h" // Vector register type
+
+// Dirty tracking granularity for the differential state display
+#define DIRTY_LINE_SIZE 16
+#define NUM_DIRTY_LINES (MEMORY_SIZE / DIRTY_LINE_SIZE)
+#define DIRTY_LINE_WORDS ((NUM_DIRTY_LINES + 63) / 64)
+
+// One predecoded instruction slot per code word
+#define CODE_WORDS ((CODE_END - CODE_START) / 4)
+#define CODE_WORD_BITMAPS ((CODE_WORDS + 63) / 64)
+
+// Debugger limits and watchpoint kinds
+#define MAX_WATCHPOINTS 8
+#define WATCH_READ   0x1 // Any read of the watched word
+#define WATCH_WRITE  0x2 // Any write to the watched word
+#define WATCH_CHANGE 0x4 // A write that changes the watched word
+
+// Pending events, checked once per instruction by the run loop
+#define EVENT_CODE_WRITE 0x1 // Code segment was written; predecoded stream is stale
+#define EVENT_WATCH_HIT  0x2 // A watchpoint fired during the last instruction
+
+// Nesting depth of active hardware loops (LOOP Rcount, end)
+#define LOOP_STACK_DEPTH 4
+
+// Code symbols kept from an executable, for traces and profiles
+#define MAX_PROGRAM_SYMBOLS 64
+#define PROGRAM_SYMBOL_MAX 32 // Longest name kept, plus NUL
 
 
 // Define CPU structure
@@ -34,20 +67,92 @@ typedef struct {
     uint8_t o; // Overflow flag
 } Flags;
 
+// How much state run_cpu prints after each instruction
+typedef enum {
+    TRACE_CHANGES, // Only the registers and memory lines that changed (default)
+    TRACE_FULL,    // Every memory segment and register, every step
+    TRACE_NONE     // Only program output (OUT) and errors
+} TraceMode;
+
+// Why execute_cpu returned
+typedef enum {
+    STOP_HALTED,     // HALT executed or a fatal error occurred
+    STOP_BREAKPOINT, // PC reached a breakpoint (PC points at it)
+    STOP_WATCHPOINT, // A watchpoint fired (PC points at the next instruction)
+    STOP_STEP_LIMIT  // Requested number of instructions executed
+} StopReason;
+
+typedef struct {
+    uint32_t start; // First instruction of the body
+    uint32_t end;   // Address just past the body (the end label)
+    uint32_t count; // Iterations left, including the current one
+} HardwareLoop;
+
+typedef struct {
+    uint32_t address;    // Watched word
+    uint8_t kinds;       // WATCH_READ | WATCH_WRITE | WATCH_CHANGE
+    uint32_t last_value; // Value at the last check (for WATCH_CHANGE)
+} Watchpoint;
+
+typedef struct {
+    uint32_t address;
+    char name[PROGRAM_SYMBOL_MAX];
+} ProgramSymbol;
+
 typedef struct {
     uint32_t registers[NUM_REGISTERS];   // General-purpose registers
+    VectorRegister vregisters[NUM_VREGISTERS]; // 128-bit vector registers (V0-V7)
     uint8_t memory[MEMORY_SIZE]; // Memory
     uint32_t pc;             // Program counter
     uint32_t sp;             // Stack pointer
     uint32_t heap_pointer;       // Heap pointer
+    HeapAllocator heap;      // Size-class allocator behind ALLOC/FREE
     Flags flags;             // CPU flags
     bool halted;             // Halted state
+    TraceMode trace_mode;    // Per-step display detail
+
+    // Changes since the last display (set by write_memory/write_register)
+    uint64_t dirty_lines[DIRTY_LINE_WORDS]; // One bit per 16-byte memory line
+    uint32_t dirty_registers;               // One bit per general-purpose register
+    uint32_t dirty_vregisters;              // One bit per vector register
+
+    // Active hardware loops, innermost last. The run loop redirects PC to the
+    // body start when it reaches the end address, so no instruction is dispatched.
+    HardwareLoop loop_stack[LOOP_STACK_DEPTH];
+    int loop_depth;
+
+    // Execution counters, reported when the program halts
+    uint64_t instructions_executed;
+    uint64_t vector_instructions;
+
+    // Code symbols of the loaded executable, sorted by address
+    ProgramSymbol symbols[MAX_PROGRAM_SYMBOLS];
+    int symbol_count;
+
+    // Per-word execution counts, gathered when profiling is on
+    bool profiling;
+    uint64_t profile[CODE_WORDS];
+
+    // Predecoded instruction stream (rebuilt lazily, flushed on code writes)
+    Instruction predecoded[CODE_WORDS];
+    uint64_t predecoded_valid[CODE_WORD_BITMAPS];
+
+    // Debugger state. Breakpoints are patched into the predecoded stream as BRK;
+    // watchpoints are found through a per-line bitmap, so memory accesses to
+    // unwatched lines pay only a bit test.
+    uint32_t events;                           // Pending EVENT_* bits
+    uint64_t breakpoints[CODE_WORD_BITMAPS];   // One bit per code word
+    bool at_breakpoint;                        // Stopped on a breakpoint; step over it on resume
+    uint64_t watch_lines[DIRTY_LINE_WORDS];    // Lines holding at least one watchpoint
+    Watchpoint watchpoints[MAX_WATCHPOINTS];
+    int watch_count;
+    int watch_hit;                             // Index of the last watchpoint that fired
+    uint8_t watch_hit_kind;                    // Kind of access that fired it
+    uint32_t watch_hit_old;                    // Value before the access
 } CPU;
 
-// Example global variables
+// CALLs not yet returned from, for the verbose log
 extern int call_depth;
-extern uint32_t params[10];
-extern int param_count;
 
 
 
@@ -71,6 +176,20 @@ void init_cpu(CPU *cpu);
  */
 void reset_cpu(CPU *cpu);
 
+/**
+ * Writes a general-purpose register and marks it dirty for the next display.
+ * @param cpu - Pointer to the CPU structure.
+ * @param index - Register index.
+ * @param value - Value to store.
+ */
+void write_register(CPU *cpu, uint32_t index, uint32_t value);
+
+/**
+ * Clears all dirty memory-line and register bits.
+ * @param cpu - Pointer to the CPU structure.
+ */
+void clear_dirty_state(CPU *cpu);
+
 /**
  * Displays the current state of the CPU.
  * - Prints registers, flags, and PC.
@@ -85,12 +204,29 @@ void reset_cpu(CPU *cpu);
  */
 void run_cpu(CPU *cpu);
 
+/**
+ * Executes instructions from the predecoded stream until the CPU halts,
+ * a breakpoint or watchpoint fires, or max_steps instructions have run.
+ * Resuming after a breakpoint executes the instruction underneath it.
+ * @param cpu - Pointer to the CPU structure.
+ * @param max_steps - Instruction budget (UINT64_MAX for no limit).
+ * @return The reason execution stopped.
+ */
+StopReason execute_cpu(CPU *cpu, uint64_t max_steps);
+
 
 int compile_c_file(const char *c_file);
 
 void display_memory_dump(uint8_t *memory, size_t size);
 void display_stack(CPU *cpu);
-void log_function_call(const char *func_name, int call_depth, uint32_t *params, int param_count);
+/**
+ * Print a call with the name of its target when a symbol starts there.
+ * Arguments travel in registers and on the stack, so they are not listed.
+ * @param cpu Pointer to the CPU structure.
+ * @param target Address being called.
+ * @param call_depth CALLs not yet returned from.
+ */
+void log_function_call(const CPU *cpu, uint32_t target, int call_depth);
 
 
 
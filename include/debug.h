@@ -37,5 +37,19 @@ void display_instruction_debug(const Instruction *instruction);
 
 void display_memory_segments(const CPU *cpu);
 
+/**
+ * Displays only the registers and 16-byte memory lines written since the
+ * previous display, then clears the dirty state.
+ * @param cpu - Pointer to the CPU structure.
+ */
+void display_changes(CPU *cpu);
+
+/**
+ * Displays how many instructions ran under each code symbol, busiest first.
+ * Counts come from cpu->profile, which execute_cpu fills when profiling is on.
+ * @param cpu - Pointer to the CPU structure.
+ */
+void display_profile(const CPU *cpu);
+
 
 #endif // DEBUG_H
@@ -0,0 +1,62 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+// Function Prototypes
+
+/**
+ * Sets a PC breakpoint. The predecoded slot for the address is invalidated so
+ * the next fetch patches a BRK trap into the stream.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Word-aligned address in the code segment.
+ * @return 0 on success, -1 if the address is not a code word.
+ */
+int add_breakpoint(CPU *cpu, uint32_t address);
+
+/**
+ * Removes a PC breakpoint and restores the original predecoded instruction.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Address of the breakpoint.
+ * @return 0 on success, -1 if no breakpoint was set there.
+ */
+int remove_breakpoint(CPU *cpu, uint32_t address);
+
+/**
+ * Sets a data watchpoint on the 32-bit word at an address.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Address of the watched word.
+ * @param kinds - Any combination of WATCH_READ, WATCH_WRITE and WATCH_CHANGE.
+ * @return 0 on success, -1 if the address is invalid or the table is full.
+ */
+int add_watchpoint(CPU *cpu, uint32_t address, uint8_t kinds);
+
+/**
+ * Removes the watchpoint on an address and rebuilds the watch-line bitmap.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Address of the watched word.
+ * @return 0 on success, -1 if no watchpoint was set there.
+ */
+int remove_watchpoint(CPU *cpu, uint32_t address);
+
+/**
+ * Checks a guest access against the watchpoint list. Only called when the
+ * access touches a line flagged in the watch bitmap. A hit sets EVENT_WATCH_HIT,
+ * which stops execute_cpu after the current instruction.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Start of the access.
+ * @param length - Length of the access in bytes.
+ * @param kind - WATCH_READ or WATCH_WRITE (writes also evaluate WATCH_CHANGE).
+ */
+void check_watchpoints(CPU *cpu, uint32_t address, uint32_t length, uint8_t kind);
+
+/**
+ * Runs an interactive debugger session on a loaded program.
+ * Commands are read from stdin; type "help" for the list.
+ * @param cpu - Pointer to the CPU structure with the program loaded.
+ * @return 0 when the session ends.
+ */
+int debug_program(CPU *cpu);
+
+#endif // DEBUGGER_H
@@ -0,0 +1,69 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stdint.h>
+
+// Guest heap allocator (host-side bookkeeping for ALLOC/FREE)
+//
+// Blocks are carved out of the heap segment in power-of-two size classes.
+// Each class keeps its own free list, so ALLOC and FREE never search:
+//   - ALLOC pops the class free list, splits a block from a larger class,
+//     or bumps the CPU heap pointer.
+//   - FREE pushes the block back onto the list of its class.
+// All metadata lives on the host; guest memory holds only user data.
+
+#define HEAP_GRANULE     4    // Smallest block size (one 32-bit word)
+#define HEAP_NUM_CLASSES 7    // 4, 8, 16, 32, 64, 128, 256 bytes
+#define HEAP_MAX_BLOCKS  64   // Heap segment size / HEAP_GRANULE
+#define HEAP_NO_BLOCK    0xFF // Marks a granule that does not start a block
+
+typedef struct {
+    int16_t free_head[HEAP_NUM_CLASSES];  // First free granule per class (-1 = empty)
+    int16_t next_free[HEAP_MAX_BLOCKS];   // Free list links, indexed by granule
+    uint8_t block_class[HEAP_MAX_BLOCKS]; // Class of the block starting here
+    uint8_t block_live[HEAP_MAX_BLOCKS];  // 1 if the block is allocated
+    uint16_t block_request[HEAP_MAX_BLOCKS]; // Bytes the guest asked for
+
+    // Statistics
+    uint32_t bytes_requested;   // Live bytes requested by the guest
+    uint32_t bytes_allocated;   // Live bytes handed out (rounded to class size)
+    uint32_t bytes_free_listed; // Bytes sitting in free lists
+    uint32_t peak_allocated;    // High-water mark of bytes_allocated
+    uint32_t alloc_count;       // Successful ALLOCs
+    uint32_t free_count;        // Successful FREEs
+    uint32_t failed_allocs;     // ALLOCs that returned 0
+} HeapAllocator;
+
+// Function Prototypes
+
+/**
+ * Initializes the heap allocator with empty free lists and zeroed statistics.
+ * @param heap - Pointer to the allocator.
+ */
+void heap_init(HeapAllocator *heap);
+
+/**
+ * Allocates a block in the guest heap segment.
+ * @param heap - Pointer to the allocator.
+ * @param heap_pointer - The CPU heap pointer, advanced when fresh space is used.
+ * @param size - Number of bytes requested.
+ * @return Guest address of the block, or 0 if the request cannot be satisfied.
+ */
+uint32_t heap_alloc(HeapAllocator *heap, uint32_t *heap_pointer, uint32_t size);
+
+/**
+ * Returns a block to its size-class free list.
+ * @param heap - Pointer to the allocator.
+ * @param address - Guest address previously returned by heap_alloc.
+ * @return 0 on success, -1 if the address is not a live block.
+ */
+int heap_free(HeapAllocator *heap, uint32_t address);
+
+/**
+ * Prints allocation counts, peak usage and fragmentation figures.
+ * @param heap - Pointer to the allocator.
+ * @param heap_pointer - Current CPU heap pointer.
+ */
+void heap_report_stats(const HeapAllocator *heap, uint32_t heap_pointer);
+
+#endif // HEAP_H
@@ -0,0 +1,204 @@
+#ifndef HLL_IR_H
+#define HLL_IR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "isa.h"
+#include "linker.h" // LABEL_NAME_MAX
+
+// Intermediate representation of the HLL translator
+//
+// The translator lowers its syntax tree to three-address code over an
+// unlimited supply of virtual registers: one per variable, plus one per
+// intermediate result. Each instruction is an ISA opcode applied to virtual
+// registers and constants, so once every virtual register has a home the
+// code is written out about one instruction each.
+//
+// Register allocation runs in three steps:
+//   - liveness: the code is cut into basic blocks, and the values live into
+//     and out of each block are found by iterating the dataflow equations to
+//     a fixed point. Values that never leave one block skip the dataflow.
+//   - live intervals: each value gets the range from its first to its last
+//     live position, so a value live around a loop covers the whole loop
+//   - linear scan: intervals are visited in order of their start and take
+//     a free register. When none is free, the overlapping interval with the
+//     lowest spill cost per position covered goes to memory. Each use or
+//     definition costs 1, times 8 per enclosing loop, so loop variables keep
+//     their registers and long, rarely used intervals give way first.
+// A spilled variable lives in its data word, a spilled intermediate in a
+// spill word shared with others whose intervals do not overlap. The highest register is kept back to stage spilled values.
+//
+// Functions follow the main program, each from its entry label to the next
+// one, and are allocated with it, so every parameter and local has a home of
+// its own. A call is made in the caller:
+//   - values live across the call whose homes the callee, or anything it
+//     calls, may write are pushed, and popped again afterwards
+//   - the arguments are moved into the callee's parameter homes, through the
+//     stack when the moves would overwrite each other
+//   - CALL pushes the return address; the callee returns its result in the
+//     highest register, where the caller picks it up
+// The callee zeroes the locals it may read before writing them, and saves
+// nothing.
+
+typedef enum {
+    IR_LABEL,  // label:
+    IR_SET,    // dst = a
+    IR_UNARY,  // dst = op a (NOT)
+    IR_BINARY, // dst = a op b (ADD ... LE; SHL/SHR take a constant b)
+    IR_BRANCH, // goto label if a op b (BEQ ... BLE)
+    IR_JUMP,   // goto label
+    IR_DJNZ,   // dst = dst - 1, then goto label if it is not zero
+    IR_OUT,    // print a
+    IR_HALT,
+    IR_ARG,    // Pass a to the call that follows; a call's arguments come right before it, in order
+    IR_CALL,   // dst = result of calling the function whose entry is label
+    IR_RET,    // Return a from the function
+    IR_NOP     // Deleted by the optimizer; never reaches code generation
+} IrKind;
+
+#define IR_NONE UINT32_MAX
+#define IR_MAX_PARAMS 16 // Parameters of one function
+
+// Virtual register or constant
+typedef struct {
+    uint32_t value;   // Virtual register number, or the constant
+    uint8_t constant;
+} IrOperand;
+
+typedef struct {
+    uint8_t kind;       // IrKind
+    uint8_t loop_depth; // Loops around the instruction, for spill costs
+    Opcode op;
+    uint32_t dst;       // Virtual register written (IR_SET, IR_UNARY, IR_BINARY, IR_DJNZ)
+    IrOperand a;
+    IrOperand b;
+    uint32_t label;     // IR_LABEL, IR_BRANCH, IR_JUMP, IR_DJNZ, IR_CALL
+} IrInstruction;
+
+typedef struct {
+    char name[LABEL_NAME_MAX]; // Variable name, or "" for an intermediate
+} IrValue;
+
+// Labels are written as prefix_number; a function's entry label has no
+// prefix and is written as the name of function number
+typedef struct {
+    const char *prefix;
+    unsigned number;
+} IrLabel;
+
+typedef struct {
+    char name[LABEL_NAME_MAX];
+    uint32_t label;                 // Entry label
+    uint32_t params[IR_MAX_PARAMS]; // Values receiving the arguments
+    uint32_t param_count;
+} IrFunction;
+
+typedef struct {
+    IrInstruction *code;
+    size_t count;
+    size_t capacity;
+    IrValue *values;
+    size_t value_count;
+    size_t value_capacity;
+    IrLabel *labels;
+    size_t label_count;
+    size_t label_capacity;
+    IrFunction *functions;
+    size_t function_count;
+    size_t function_capacity;
+} IrProgram;
+
+typedef struct {
+    uint32_t instructions; // Assembly instructions written
+    uint32_t values;       // Virtual registers used
+    uint32_t spilled;      // Virtual registers kept in memory
+} IrStats;
+
+// Function Prototypes
+
+/**
+ * Initializes an empty program.
+ * @param program - Pointer to the program.
+ */
+void ir_init(IrProgram *program);
+
+/**
+ * Releases a program.
+ * @param program - Pointer to the program.
+ */
+void ir_free(IrProgram *program);
+
+/**
+ * Creates a virtual register.
+ * @param program - Pointer to the program.
+ * @param name - Variable name, or "" for an intermediate value.
+ * @return The register number.
+ */
+uint32_t ir_value(IrProgram *program, const char *name);
+
+/**
+ * Creates a label; it is placed by emitting an IR_LABEL.
+ * @param program - Pointer to the program.
+ * @param prefix - Name prefix (a string literal).
+ * @param number - Number written after the prefix.
+ * @return The label number.
+ */
+uint32_t ir_label(IrProgram *program, const char *prefix, unsigned number);
+
+/**
+ * Creates a function with no parameters and its entry label; the body is
+ * emitted after the main program, starting with an IR_LABEL of the entry.
+ * @param program - Pointer to the program.
+ * @param name - Function name, also the name of its entry in the assembly.
+ * @return The function number.
+ */
+uint32_t ir_function(IrProgram *program, const char *name);
+
+/**
+ * Tells which function a label is the entry of.
+ * @param program - Pointer to the program.
+ * @param label - Label number.
+ * @return The function number, or IR_NONE for other labels.
+ */
+uint32_t ir_function_of_label(const IrProgram *program, uint32_t label);
+
+/**
+ * Appends an instruction.
+ * @param program - Pointer to the program.
+ * @param instruction - Instruction to copy.
+ */
+void ir_emit(IrProgram *program, const IrInstruction *instruction);
+
+/**
+ * Tells whether instructions of a kind write their dst.
+ * @param kind - Instruction kind.
+ * @return 1 if dst is written, 0 otherwise.
+ */
+int ir_writes_dst(IrKind kind);
+
+/**
+ * Lists the virtual registers an instruction reads.
+ * @param instruction - Instruction to inspect.
+ * @param uses - Receives up to two register numbers.
+ * @return How many registers were stored.
+ */
+int ir_uses(const IrInstruction *instruction, uint32_t uses[2]);
+
+/**
+ * Tells whether instructions of a kind end a basic block.
+ * @param kind - Instruction kind.
+ * @return 1 for branches, jumps, HALT and RET, 0 otherwise.
+ */
+int ir_ends_block(IrKind kind);
+
+/**
+ * Allocates registers and writes the program as assembly source: a data
+ * section with a word for each spilled value, then the code.
+ * @param program - Program to write.
+ * @param size - Receives the length of the text.
+ * @param stats - Receives instruction and register counts.
+ * @return The assembly source (malloc'd, NUL-terminated).
+ */
+char *ir_generate(const IrProgram *program, size_t *size, IrStats *stats);
+
+#endif // HLL_IR_H
@@ -0,0 +1,69 @@
+#ifndef HLL_OPT_H
+#define HLL_OPT_H
+
+#include <stdint.h>
+#include "hll_ir.h"
+
+// Optimizer for the HLL translator's IR
+//
+// Runs between lowering and register allocation. Each pass can be switched on
+// or off by itself; the enabled ones are repeated until none of them changes
+// anything. Facts found within a basic block carry on into the next one when
+// it can only be entered by falling through, as into the body of an if.
+//   - constant folding and propagation: values known to be constant are
+//     substituted into their uses, operations on constants are computed,
+//     identities such as x + 0 and x * 1 become copies, and branches with a
+//     known outcome become a JUMP or disappear. Variables start at zero.
+//   - strength reduction: multiplication by a power of two becomes SHL and
+//     (unsigned) division by one becomes SHR
+//   - common-subexpression elimination: value numbering finds operations
+//     already computed from the same unchanged operands and reuses the result;
+//     copies are propagated into later uses
+//   - loop-invariant code motion: operations inside a loop whose operands are
+//     not changed by the loop are computed once, just before the loop body
+//   - dead-code elimination: unreachable code, unused labels, jumps to the
+//     next instruction, results that are never read, and writes overwritten
+//     before being read
+// Division is never moved or removed unless its divisor is a nonzero
+// constant, so a division by zero still stops the program where it would.
+
+typedef enum {
+    IR_PASS_CONSTANTS = 1 << 0,
+    IR_PASS_STRENGTH  = 1 << 1,
+    IR_PASS_CSE       = 1 << 2,
+    IR_PASS_LICM      = 1 << 3,
+    IR_PASS_DEAD_CODE = 1 << 4
+} IrPass;
+
+// Passes enabled by -O1 and -O2 (-O0 runs none)
+#define IR_PASSES_O1 (IR_PASS_CONSTANTS | IR_PASS_STRENGTH | IR_PASS_DEAD_CODE)
+#define IR_PASSES_O2 (IR_PASSES_O1 | IR_PASS_CSE | IR_PASS_LICM)
+
+typedef struct {
+    uint32_t instructions; // IR instructions before optimization
+    uint32_t remaining;    // IR instructions after it
+    uint32_t folded;       // Instructions simplified by constant folding
+    uint32_t reduced;      // Multiplications and divisions turned into shifts
+    uint32_t reused;       // Recomputations replaced by an earlier result
+    uint32_t hoisted;      // Instructions moved out of loops
+} IrOptStats;
+
+// Function Prototypes
+
+/**
+ * Looks up a pass by its command-line name: constants, strength, cse, licm
+ * or dce.
+ * @param name - Pass name.
+ * @return The pass, or 0 if there is none of that name.
+ */
+unsigned ir_pass_named(const char *name);
+
+/**
+ * Optimizes a program in place.
+ * @param program - Program to optimize.
+ * @param passes - IrPass flags of the passes to run.
+ * @param stats - Receives instruction counts.
+ */
+void ir_optimize(IrProgram *program, unsigned passes, IrOptStats *stats);
+
+#endif // HLL_OPT_H
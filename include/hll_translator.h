@@ -4,12 +4,61 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "hll_ir.h" // IrStats
+
+// HLL to assembly translator
+//
+// The source is read once by a lexer into tokens, parsed by recursive descent
+// into an abstract syntax tree, and the tree is walked once to lower it to
+// the IR of hll_ir.h, so translation time is linear in the size of the program.
+//
+//   program    := (statement | function)*
+//   function   := 'function' name '(' [name (',' name)*] ')' ['{'] statement* ('}' | 'endfunction')
+//   statement  := name '=' expr | 'print' expr | 'halt' | call | 'return' [expr]
+//               | 'if' '(' expr ')' ['{'] statement* ['}'] ['else' ['{'] statement*] ('}' | 'endif')
+//               | 'while' '(' expr ')' ['{'] statement* ('}' | 'endwhile')
+//   call       := name '(' [expr (',' expr)*] ')'
+//   expr       := C operators with C precedence: || && | ^ & == != < > <= >= << >> + - * /
+//                 and the unary - ~ !, over numbers, names and calls
+//
+// Each variable is a virtual register, placed in a machine register or, when
+// spilled, in a data word named after the variable. Blocks nest to any depth,
+// and conditions become fused compare-and-branch instructions. Counted loops
+// are lowered to DJNZ. The IR can be optimized (hll_opt.h) before registers
+// are allocated.
+//
+// Functions are defined at the top level, may be called before they are
+// defined, and see only their parameters and their own variables, which
+// start at 0 on every call. A function without a return returns 0. A call to
+// the function itself in a return is a tail call and jumps back to its entry,
+// as does "return e op f(...)" for op one of + * & | ^: the function gets a
+// hidden accumulator parameter that e is folded into, so such recursion runs
+// in constant stack.
+
+#define HLL_MAX_NESTING 256 // Deepest nesting of blocks and parentheses
+#define HLL_MAX_PARAMS 8    // Parameters of a function; the IR needs one more for an accumulator
+
+#if HLL_MAX_PARAMS >= IR_MAX_PARAMS
+#error "HLL_MAX_PARAMS must leave room for an accumulator in IR_MAX_PARAMS"
+#endif
+
 /**
  * Translate a high-level language (HLL) program to assembly code.
  * @param hll_code The input HLL program as a string.
  * @param output_file The file to write the translated assembly code.
+ * @param passes IR optimizer passes to run (IrPass flags, 0 for none).
  * @return 0 on success, -1 on failure.
  */
-int translate_hll_to_assembly(const char *hll_code, const char *output_file);
+int translate_hll_to_assembly(const char *hll_code, const char *output_file, unsigned passes);
+
+/**
+ * Translate an HLL program to assembly source in memory.
+ * @param hll_code The input HLL program as a string.
+ * @param passes IR optimizer passes to run (IrPass flags, 0 for none).
+ * @param size Receives the length of the assembly source.
+ * @param stats Receives instruction and register counts.
+ * @return The assembly source (malloc'd, NUL-terminated), or NULL on an error.
+ */
+char *translate_hll_to_buffer(const char *hll_code, unsigned passes, size_t *size, IrStats *stats);
 
 #endif // HLL_TRANSLATOR_H
@@ -6,64 +6,33 @@
 #include "alu.h"
 #include "memory.h"
 
-// Define opcodes for the instruction set
-typedef enum {
-    ADD,       // 0x00
-    SUB,       // 0x01
-    MUL,       // 0x02
-    DIV,       // 0x03
-    AND,       // 0x04
-    OR,        // 0x05
-    XOR,       // 0x06
-    NOT,       // 0x07
-    SHL,       // 0x08
-    SHR,       // 0x09
-    EQ,        // 0x0A
-    NEQ,       // 0x0B
-    GT,        // 0x0C
-    LT,        // 0x0D
-    GE,        // 0x0E
-    LE,        // 0x0F
-    LOAD,      // 0x10
-    STORE,     // 0x11
-    JUMP,      // 0x12
-    JZ,        // 0x13
-    JNZ,       // 0x14
-    CALL,      // 0x15
-    RET,       // 0x16
-    PUSH,      // 0x17
-    POP,       // 0x18
-    HALT,       // 0x19
-    OUT         // 0x1A
-} Opcode;
-
-// Addressing Modes
-typedef enum {
-    IMMEDIATE,  // Operand is a constant
-    REGISTER,   // Operand is a register
-    MEMORY,     // Operand is a memory address
-    INDIRECT,   // Operand is a memory address containing the actual data address
-    INDEXED     // Operand is a base address + offset
-} AddressingMode;
-
-// Instruction structure
-typedef struct {
-    Opcode opcode;             // Operation code
-    uint32_t operands[3];      // Up to 3 operands
-    AddressingMode modes[3];   // Addressing mode for each operand
-} Instruction;
-
-
-
 // Function Prototypes
 
 /**
  * Decodes a 32-bit binary instruction into an Instruction struct.
+ * If the X flag is set the literal word is not applied; use
+ * decode_instruction_at to decode a complete extended instruction.
  * @param raw - The 32-bit binary instruction.
  * @return Decoded instruction.
  */
 Instruction decode_instruction(uint32_t raw);
 
+/**
+ * Decodes the instruction stored at an address, including its literal word.
+ * @param memory - Pointer to the memory array.
+ * @param address - Address of the base word.
+ * @return Decoded instruction with size set to 4, 8 or 12.
+ */
+Instruction decode_instruction_at(const uint8_t *memory, uint32_t address);
+
+/**
+ * Returns the operand slot an extension literal replaces for an opcode:
+ * the first operand decoded in IMMEDIATE mode.
+ * @param opcode - Opcode to query.
+ * @return Operand index 0-2, or -1 if the opcode takes no immediate.
+ */
+int literal_slot(Opcode opcode);
+
 /**
  * Executes a given instruction on the CPU.
  * @param cpu - Pointer to the CPU structure.
@@ -71,6 +40,15 @@ Instruction decode_instruction(uint32_t raw);
  */
 void execute_instruction(CPU *cpu, Instruction instruction);
 
+/**
+ * Formats an instruction in assembler syntax using the opcode descriptors.
+ * @param instruction - Instruction to format.
+ * @param buf - Output buffer.
+ * @param size - Size of the buffer.
+ * @return Length of the full text (as snprintf).
+ */
+int disassemble_instruction(const Instruction *instruction, char *buf, size_t size);
+
 /**
  * Displays the decoded instruction for debugging purposes.
  * @param instruction - Instruction to display.
@@ -78,7 +56,5 @@ void execute_instruction(CPU *cpu, Instruction instruction);
 void display_instruction(Instruction instruction);
 
 
-int translate_hll_to_assembly(const char *hll_code, const char *output_file);
-
 
 #endif // INSTRUCTIONS_H
@@ -0,0 +1,157 @@
+#ifndef ISA_H
+#define ISA_H
+
+#include <stdint.h>
+
+// Instruction format
+//   Base word:  [31] X flag | [30] M flag | [29:24] opcode | [23:16] op0 | [15:8] op1 | [7:0] op2
+//   M set:      a mode word follows the base word, overriding the opcode's
+//               implicit addressing modes:
+//               [2:0] op0 mode | [5:3] op1 mode | [8:6] op2 mode |
+//               [10:9] literal slot (3 = none) | [31:16] signed INDEXED displacement
+//   X set:      a word follows (after the mode word, if any) holding a 32-bit
+//               literal. It replaces the instruction's literal slot (without a
+//               mode word, its first immediate operand), so LOAD values, jump
+//               targets and memory addresses are not limited to 8 bits.
+#define INSTR_EXTENDED    0x80000000u
+#define INSTR_MODES       0x40000000u
+#define INSTR_OPCODE_MASK 0x3F
+#define OPERAND_MAX       0xFF // Largest value that fits an operand field
+
+#define MODE_FIELD_BITS   3    // Bits per operand mode in the mode word
+#define MODE_FIELD_MASK   0x7
+#define MODE_SLOT_SHIFT   9
+#define MODE_NO_SLOT      3
+#define MODE_DISP_SHIFT   16
+
+// How an instruction uses each operand field
+typedef enum {
+    OPK_NONE,  // Field unused
+    OPK_DEST,  // Register number written or used directly (no addressing modes)
+    OPK_REG,   // Source value, implicitly a register; any addressing mode
+    OPK_IMM,   // Source value, implicitly an immediate; any addressing mode
+    OPK_ADDR,  // Memory address, implicitly held in a register; any addressing mode
+    OPK_VREG,  // Vector register number
+    OPK_COUNT  // Raw count (SHL/SHR shift amount)
+} OperandKind;
+
+// Opcode descriptors: one line per instruction, in encoding order. Adding an
+// instruction takes one line here plus its handler in instructions.c; the
+// enum, assembler, decoder and disassembler are all generated from this list.
+//   X(opcode, operand count, operand kinds, handler)
+#define ISA_OPCODES(X) \
+    X(ADD,    3, OPK_DEST, OPK_REG,  OPK_REG,   exec_arithmetic) /* 0x00 */ \
+    X(SUB,    3, OPK_DEST, OPK_REG,  OPK_REG,   exec_arithmetic) /* 0x01 */ \
+    X(MUL,    3, OPK_DEST, OPK_REG,  OPK_REG,   exec_arithmetic) /* 0x02 */ \
+    X(DIV,    3, OPK_DEST, OPK_REG,  OPK_REG,   exec_arithmetic) /* 0x03 */ \
+    X(AND,    3, OPK_DEST, OPK_REG,  OPK_REG,   exec_logical)    /* 0x04 */ \
+    X(OR,     3, OPK_DEST, OPK_REG,  OPK_REG,   exec_logical)    /* 0x05 */ \
+    X(XOR,    3, OPK_DEST, OPK_REG,  OPK_REG,   exec_logical)    /* 0x06 */ \
+    X(NOT,    2, OPK_DEST, OPK_REG,  OPK_NONE,  exec_logical)    /* 0x07 */ \
+    X(SHL,    3, OPK_DEST, OPK_REG,  OPK_COUNT, exec_shift)      /* 0x08 */ \
+    X(SHR,    3, OPK_DEST, OPK_REG,  OPK_COUNT, exec_shift)      /* 0x09 */ \
+    X(EQ,     3, OPK_DEST, OPK_REG,  OPK_REG,   exec_compare)    /* 0x0A  Rd = 1 if equal, else 0 */ \
+    X(NEQ,    3, OPK_DEST, OPK_REG,  OPK_REG,   exec_compare)    /* 0x0B */ \
+    X(GT,     3, OPK_DEST, OPK_REG,  OPK_REG,   exec_compare)    /* 0x0C */ \
+    X(LT,     3, OPK_DEST, OPK_REG,  OPK_REG,   exec_compare)    /* 0x0D */ \
+    X(GE,     3, OPK_DEST, OPK_REG,  OPK_REG,   exec_compare)    /* 0x0E */ \
+    X(LE,     3, OPK_DEST, OPK_REG,  OPK_REG,   exec_compare)    /* 0x0F */ \
+    X(LOAD,   2, OPK_DEST, OPK_IMM,  OPK_NONE,  exec_load)       /* 0x10 */ \
+    X(STORE,  2, OPK_REG,  OPK_ADDR, OPK_NONE,  exec_store)      /* 0x11 */ \
+    X(JUMP,   1, OPK_IMM,  OPK_NONE, OPK_NONE,  exec_jump)       /* 0x12 */ \
+    X(JZ,     1, OPK_IMM,  OPK_NONE, OPK_NONE,  exec_jump)       /* 0x13 */ \
+    X(JNZ,    1, OPK_IMM,  OPK_NONE, OPK_NONE,  exec_jump)       /* 0x14 */ \
+    X(CALL,   1, OPK_IMM,  OPK_NONE, OPK_NONE,  exec_call)       /* 0x15 */ \
+    X(RET,    0, OPK_NONE, OPK_NONE, OPK_NONE,  exec_ret)        /* 0x16 */ \
+    X(PUSH,   1, OPK_REG,  OPK_NONE, OPK_NONE,  exec_push)       /* 0x17 */ \
+    X(POP,    1, OPK_DEST, OPK_NONE, OPK_NONE,  exec_pop)        /* 0x18 */ \
+    X(HALT,   0, OPK_NONE, OPK_NONE, OPK_NONE,  exec_halt)       /* 0x19 */ \
+    X(OUT,    1, OPK_DEST, OPK_NONE, OPK_NONE,  exec_out)        /* 0x1A */ \
+    X(ALLOC,  2, OPK_DEST, OPK_REG,  OPK_NONE,  exec_alloc)      /* 0x1B  ALLOC Rd, Rsize */ \
+    X(FREE,   1, OPK_REG,  OPK_NONE, OPK_NONE,  exec_free)       /* 0x1C */ \
+    X(BRK,    0, OPK_NONE, OPK_NONE, OPK_NONE,  exec_brk)        /* 0x1D  Breakpoint trap (also patched into the predecoded stream) */ \
+    X(BEQ,    3, OPK_REG,  OPK_REG,  OPK_IMM,   exec_branch)     /* 0x1E  Compare two values and branch: BEQ Ra, Rb, target */ \
+    X(BNE,    3, OPK_REG,  OPK_REG,  OPK_IMM,   exec_branch)     /* 0x1F */ \
+    X(BLT,    3, OPK_REG,  OPK_REG,  OPK_IMM,   exec_branch)     /* 0x20 */ \
+    X(BGE,    3, OPK_REG,  OPK_REG,  OPK_IMM,   exec_branch)     /* 0x21 */ \
+    X(BGT,    3, OPK_REG,  OPK_REG,  OPK_IMM,   exec_branch)     /* 0x22 */ \
+    X(BLE,    3, OPK_REG,  OPK_REG,  OPK_IMM,   exec_branch)     /* 0x23 */ \
+    X(VLOAD,  2, OPK_VREG, OPK_ADDR, OPK_NONE,  exec_vector_memory) /* 0x24  VLOAD Vd, Raddr: load 16 bytes */ \
+    X(VSTORE, 2, OPK_VREG, OPK_ADDR, OPK_NONE,  exec_vector_memory) /* 0x25 */ \
+    X(VADD,   3, OPK_VREG, OPK_VREG, OPK_VREG,  exec_vector)     /* 0x26  VADD Vd, Va, Vb (four 32-bit lanes) */ \
+    X(VSUB,   3, OPK_VREG, OPK_VREG, OPK_VREG,  exec_vector)     /* 0x27 */ \
+    X(VMUL,   3, OPK_VREG, OPK_VREG, OPK_VREG,  exec_vector)     /* 0x28 */ \
+    X(VAND,   3, OPK_VREG, OPK_VREG, OPK_VREG,  exec_vector)     /* 0x29 */ \
+    X(VOR,    3, OPK_VREG, OPK_VREG, OPK_VREG,  exec_vector)     /* 0x2A */ \
+    X(VXOR,   3, OPK_VREG, OPK_VREG, OPK_VREG,  exec_vector)     /* 0x2B */ \
+    X(VCMP,   3, OPK_VREG, OPK_VREG, OPK_VREG,  exec_vector)     /* 0x2C  Lane-wise equality mask; Z set if all lanes equal */ \
+    X(MEMCPY, 3, OPK_REG,  OPK_REG,  OPK_REG,   exec_block)      /* 0x2D  MEMCPY Rdst, Rsrc, Rlen (overlap-safe) */ \
+    X(MEMSET, 3, OPK_REG,  OPK_REG,  OPK_REG,   exec_block)      /* 0x2E  MEMSET Rdst, Rbyte, Rlen */ \
+    X(MEMCMP, 3, OPK_REG,  OPK_REG,  OPK_REG,   exec_block)      /* 0x2F  MEMCMP Ra, Rb, Rlen: Z if equal, N if a < b */ \
+    X(DJNZ,   2, OPK_DEST, OPK_IMM,  OPK_NONE,  exec_djnz)       /* 0x30  Decrement Rn, branch if non-zero */ \
+    X(LOOP,   2, OPK_REG,  OPK_IMM,  OPK_NONE,  exec_loop)       /* 0x31  LOOP Rcount, end: hardware loop */
+
+// Define opcodes for the instruction set
+#define ISA_ENUM_ENTRY(opcode, count, kind0, kind1, kind2, handler) opcode,
+typedef enum {
+    ISA_OPCODES(ISA_ENUM_ENTRY)
+    NUM_OPCODES
+} Opcode;
+
+_Static_assert(NUM_OPCODES <= INSTR_OPCODE_MASK + 1, "Opcode field is 6 bits wide");
+
+// Static description of an opcode, indexed by Opcode
+typedef struct {
+    const char *mnemonic;
+    uint8_t operand_count;
+    OperandKind kinds[3];
+} OpcodeInfo;
+
+extern const OpcodeInfo opcode_table[NUM_OPCODES];
+
+// Addressing Modes
+typedef enum {
+    IMMEDIATE,  // Operand is a constant
+    REGISTER,   // Operand is a register
+    MEMORY,     // Operand is a memory address
+    INDIRECT,   // Operand is a memory address containing the actual data address
+    INDEXED     // Operand is a base register; the data is at register + displacement
+} AddressingMode;
+
+// Instruction structure
+typedef struct {
+    Opcode opcode;             // Operation code
+    uint32_t operands[3];      // Up to 3 operands
+    AddressingMode modes[3];   // Addressing mode for each operand
+    int32_t displacement;      // Offset added to the base register of INDEXED operands
+    uint32_t size;             // Encoded length in bytes (4, plus 4 per mode/literal word)
+} Instruction;
+
+// Function Prototypes
+
+/**
+ * Looks up a mnemonic with a perfect hash (one probe, one string compare).
+ * @param mnemonic - Upper-case mnemonic, e.g. "ADD".
+ * @return The opcode, or -1 if the mnemonic is unknown.
+ */
+int find_opcode(const char *mnemonic);
+
+/**
+ * Addressing mode an operand has when no mode word overrides it.
+ * @param kind - Operand kind from the descriptor table.
+ * @return IMMEDIATE for OPK_IMM, REGISTER otherwise.
+ */
+static inline AddressingMode implicit_mode(OperandKind kind) {
+    return kind == OPK_IMM ? IMMEDIATE : REGISTER;
+}
+
+/**
+ * Whether an operand kind accepts explicit addressing modes.
+ * @param kind - Operand kind from the descriptor table.
+ * @return true for source and address operands.
+ */
+static inline int kind_takes_modes(OperandKind kind) {
+    return kind == OPK_REG || kind == OPK_IMM || kind == OPK_ADDR;
+}
+
+#endif // ISA_H
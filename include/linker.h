@@ -2,24 +2,96 @@
 #define LINKER_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include "symtab.h"
+#include "object.h"
+
+#define MAX_INSTRUCTION_WORDS 3 // Base word, mode word, literal word
+#define LABEL_NAME_MAX 32       // Longest label an operand can reference, plus NUL
+#define LINK_AMBIGUOUS UINT32_MAX // Global symbol value: defined in several files
+#define ASSEMBLER_VERSION 2       // Bump when the same source may assemble differently
+#define PARALLEL_ASSEMBLY_MIN (1u << 20)       // Sources this large are assembled in chunks
+#define PARALLEL_ASSEMBLY_CHUNK_MIN (256u << 10) // Smallest chunk worth a task
+#define PARALLEL_ASSEMBLY_CHUNKS_PER_CPU 4     // Spare chunks to even out the load
+
+// A label reference that is patched after its line was encoded: a forward
+// reference within one assembly, or a relocation in a relocatable unit
+typedef enum {
+    FIXUP_FIELD,        // 8-bit operand field of the base word
+    FIXUP_LITERAL,      // Full literal word
+    FIXUP_DISPLACEMENT  // Signed 16-bit INDEXED displacement of the mode word
+} FixupKind;
 
-// Define maximum sizes for symbols and instructions
-#define MAX_SYMBOLS 256
-#define MAX_INSTRUCTIONS 1024
-#define MAX_LABELS 100  // Adjust size as needed
+typedef struct {
+    char label[LABEL_NAME_MAX];
+    size_t word;         // Index of the patched word in its section
+    uint8_t kind;        // FixupKind
+    uint8_t shift;       // FIXUP_FIELD: bit position of the operand field
+    int8_t sign;         // FIXUP_DISPLACEMENT: -1 for [Rn-label]
+    uint8_t section;     // SECTION_CODE, or SECTION_DATA for a .word
+    uint32_t line;       // Source line, for error messages
+} Fixup;
 
-// Symbol Table Entry
 typedef struct {
-    char name[50];        // Name of the symbol (e.g., function or variable name)
-    uint32_t address;     // Address of the symbol in memory
-} Symbol;
+    Fixup *items;
+    size_t count;
+    size_t capacity;
+    size_t base;         // Output index of the word being encoded
+    uint32_t line;       // Line being encoded
+    int wide;            // Reserve a literal word for every forward label
+} FixupList;
+
+// Output of assembling one source file
+typedef struct {
+    SymbolTable symbols; // Labels, as byte offsets from the start of the code. An
+                         // executable's table also holds its data labels at
+                         // their load addresses, so one lookup resolves both.
+    SymbolTable data_symbols; // Labels in .data, as byte offsets from its start
+    uint32_t *code;
+    size_t word_count;
+    size_t capacity;
+    uint8_t *data;       // Initialized data (.data section)
+    size_t data_size;
+    size_t data_capacity;
+    int in_data;         // Assembling into .data rather than .text
+    FixupList fixups;    // Unresolved references (all label references if relocatable)
+    uint32_t lines;
+    int relocatable;     // Labels are left for the linker to resolve
+    uint32_t base;       // Load address assigned by the linker
+    uint32_t data_base;  // Offset of its data in the linked data section
+} Assembly;
+
+// Settings of one assemble command
+typedef struct {
+    int relocatable;     // Write a relocatable object instead of an executable
+    int use_cache;       // Look the output up in the assembly cache first
+    int optimize;        // Run the peephole optimizer before encoding (-O)
+} AssemblerOptions;
+
+// A run of unreachable code removed by the linker
+typedef struct {
+    int file;               // Index of the file it came from
+    uint32_t address;       // Address in the image before compaction
+    uint32_t size;          // Bytes removed
+    char label[LABEL_NAME_MAX]; // Closest label at or before it ("" if none)
+    uint32_t offset;        // Distance from that label
+} LinkRemoval;
 
 // Linker Context
 typedef struct {
-    Symbol symbols[MAX_SYMBOLS];    // Symbol table for resolving references
-    int symbol_count;               // Number of symbols in the table
-    uint32_t instructions[MAX_INSTRUCTIONS]; // Combined binary instructions
-    int instruction_count;          // Total number of instructions
+    char **files;           // Source files, in link order
+    Assembly *units;        // One relocatable unit per file
+    int file_count;
+    int file_capacity;
+    SymbolTable globals;    // Label -> absolute address (LINK_AMBIGUOUS if duplicated)
+    SymbolTable data_globals; // The globals that are data labels
+    uint32_t *image;        // Linked code
+    size_t word_count;
+    uint8_t *data;          // Linked data, loaded at DATA_START
+    size_t data_size;
+    LinkRemoval *removed;   // Code dropped by eliminate_dead_code
+    size_t removed_count;
+    size_t removed_capacity;
 } Linker;
 
 // Function Prototypes
@@ -31,38 +103,101 @@ typedef struct {
 void init_linker(Linker *linker);
 
 /**
- * Adds an assembly file to the linker.
- * Parses symbols and instructions, and integrates them into the linker context.
+ * Adds an assembly file or relocatable object to the link. Files are
+ * assembled by resolve_symbols and laid out in the order they were added;
+ * execution starts at _start, or at the first file's code without one.
  * @param linker - Pointer to the Linker context.
  * @param filename - Name of the assembly file to process.
  */
 void add_file_to_linker(Linker *linker, const char *filename);
 
 /**
- * Resolves symbols and adjusts addresses in the linker context.
+ * Assembles every file into a relocatable unit (in parallel, one worker per
+ * file up to the number of CPUs), lays the units out one after another,
+ * and applies their relocations. A label resolves to the referencing file's
+ * own definition first, then to the single file that defines it.
  * @param linker - Pointer to the Linker context.
+ * @return 0 on success, -1 on an assembly error or an unresolved label.
  */
-void resolve_symbols(Linker *linker);
+int resolve_symbols(Linker *linker);
 
 /**
- * Generates the final binary file from the linker context.
+ * Removes code that cannot run. Starting at the entry point, an instruction
+ * reaches the next one (unless it is JUMP, RET or HALT), the target of a
+ * JUMP/JZ/JNZ/CALL, compare-and-branch, DJNZ or LOOP, and every label it
+ * references as a value, since such an address may be jumped through. The
+ * rest is dropped, the units are compacted and their labels and relocations
+ * resolved again. Labels of removed code are dropped; the removed runs are
+ * recorded for the link map. Call after resolve_symbols.
  * @param linker - Pointer to the Linker context.
- * @param output_file - Name of the output binary file.
+ * @return Bytes removed, or -1 on error.
  */
-void generate_binary(Linker *linker, const char *output_file);
+long eliminate_dead_code(Linker *linker);
 
+/**
+ * Writes a link map: each file's address and size, every symbol by address,
+ * and the code removed by eliminate_dead_code.
+ * @param linker - Pointer to the Linker context.
+ * @param map_file - Name of the map file.
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int write_link_map(const Linker *linker, const char *map_file);
 
-int assemble(const char *asm_file, const char *bin_file);
+/**
+ * Writes the linked code and data as an executable object carrying every
+ * unit's labels as symbols.
+ * @param linker - Pointer to the Linker context.
+ * @param output_file - Name of the output binary file.
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int generate_binary(Linker *linker, const char *output_file);
 
+/**
+ * Releases the units, symbols and image of a linker context.
+ * @param linker - Pointer to the Linker context.
+ */
+void free_linker(Linker *linker);
 
-uint8_t get_opcode_binary(const char *opcode);
+/**
+ * Assembles a source file in a single pass over a memory-mapped copy of it.
+ * Code is emitted as lines are read; forward label references are patched
+ * from a fixup list at the end, and the image is written as an executable
+ * object whose entry point is _start (or the first instruction).
+ * Equivalent to assemble_with_options with the cache on.
+ * @param asm_file - Assembly source file.
+ * @param bin_file - Output executable.
+ * @return 0 on success, -1 on error.
+ */
+int assemble(const char *asm_file, const char *bin_file);
 
+/**
+ * Assembles a source file into an executable, or into a relocatable object
+ * for a later link (code at offset 0, labels as symbols, every label
+ * reference as a relocation). With use_cache, output for a source already
+ * assembled with the same options is copied from the assembly cache.
+ * @param asm_file - Assembly source file.
+ * @param output_file - Output executable or object.
+ * @param options - Output kind and cache use.
+ * @return 0 on success, -1 on error.
+ */
+int assemble_with_options(const char *asm_file, const char *output_file, const AssemblerOptions *options);
 
 /**
- * Translates a single line of assembly code into a 32-bit binary instruction.
- * @param line - A single line of assembly code.
- * @return The 32-bit binary instruction.
+ * Assembles source text held in memory into an executable object in memory,
+ * so nothing is read from or written to disk. The assembly cache, which is
+ * keyed by file, is not consulted.
+ * @param source - Assembly source (need not be NUL-terminated).
+ * @param size - Length of the source in bytes.
+ * @param name - Name of the source, for messages.
+ * @param optimize - Run the peephole optimizer before encoding.
+ * @param executable - Receives the code, data and symbols; release it with
+ *                     object_close.
+ * @return 0 on success, -1 on error.
  */
-uint32_t translate_assembly_line_to_binary(const char *line);
+int assemble_buffer(const char *source, size_t size, const char *name, int optimize, ObjectFile *executable);
+
+
+uint8_t get_opcode_binary(const char *opcode);
+
 
 #endif // LINKER_H
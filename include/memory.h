@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "cpu.h" // Include CPU definition here
+#include "object.h"
 
 // Function Prototypes
 
@@ -15,24 +16,118 @@
 uint32_t read_memory(const uint8_t *memory, uint32_t address);
 
 /**
- * Writes a 32-bit value to memory.
- * @param memory - Pointer to the memory array.
+ * Reads a 32-bit value for an executing instruction, firing read watchpoints.
+ * Debug displays should use read_memory instead.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Address to read from.
+ * @return The 32-bit value stored at the specified address.
+ */
+uint32_t read_data(CPU *cpu, uint32_t address);
+
+/**
+ * Writes a 32-bit value to memory and marks the touched lines dirty.
+ * @param cpu - Pointer to the CPU structure.
  * @param address - Address to write to.
  * @param value - The 32-bit value to write.
  */
-void write_memory(uint8_t *memory, uint32_t address, uint32_t value);
+void write_memory(CPU *cpu, uint32_t address, uint32_t value);
+
+/**
+ * Marks every 16-byte line overlapping a memory range as dirty.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Start of the range.
+ * @param length - Length of the range in bytes.
+ */
+void mark_memory_dirty(CPU *cpu, uint32_t address, uint32_t length);
+
+/**
+ * Checks that a block access lies entirely inside guest memory.
+ * @param address - Start of the block.
+ * @param length - Length of the block in bytes.
+ * @return true if [address, address + length) is addressable.
+ */
+bool block_in_bounds(uint32_t address, uint32_t length);
+
+/**
+ * Finds the end of the memory segment (code, data, stack or heap) containing an address.
+ * @param address - Address inside guest memory.
+ * @return One past the last byte of the segment, or 0 if the address is outside memory.
+ */
+uint32_t segment_end(uint32_t address);
+
+/**
+ * Checks that a block lies inside a single memory segment.
+ * @param address - Start of the block.
+ * @param length - Length of the block in bytes (0 is always valid).
+ * @return true if the block does not leave the segment it starts in; false
+ *         if it starts past the end of memory.
+ */
+bool block_in_segment(uint32_t address, uint32_t length);
+
+/**
+ * Records a guest read of a block: fires read watchpoints on watched lines.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Start of the block.
+ * @param length - Length of the block in bytes.
+ */
+void note_block_read(CPU *cpu, uint32_t address, uint32_t length);
+
+/**
+ * Records a guest write of a block already copied into memory: marks lines
+ * dirty, invalidates predecoded code, and fires write/change watchpoints.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Start of the block.
+ * @param length - Length of the block in bytes.
+ */
+void note_block_write(CPU *cpu, uint32_t address, uint32_t length);
 
 /**
  * Loads a program (array of 32-bit instructions) into the code segment.
- * @param memory - Pointer to the memory array.
+ * @param cpu - Pointer to the CPU structure.
  * @param program - Pointer to the array of instructions.
  * @param size - Number of instructions in the program.
  */
-int load_program(uint8_t *memory, const uint32_t *program, uint32_t size);
+int load_program(CPU *cpu, const uint32_t *program, uint32_t size);
 
 
+/**
+ * Loads a program file. An executable object has its sections copied to
+ * their load addresses, PC set to its entry point and its code symbols
+ * kept; any other file is a raw image copied to the start of the code segment.
+ * @param cpu - Pointer to the CPU structure.
+ * @param file_path - Executable or raw binary file.
+ * @return 0 on success, -1 if the file cannot be read or does not fit.
+ */
 int load_binary_program(CPU *cpu, const char *file_path);
 
+/**
+ * Loads an executable object already in memory, such as one from
+ * assemble_buffer, the way load_binary_program loads one from a file.
+ * @param cpu - Pointer to the CPU structure.
+ * @param object - Executable object.
+ * @param name - Name of the program, for messages.
+ * @return 0 on success, -1 if it is not an executable or does not fit.
+ */
+int load_executable_object(CPU *cpu, const ObjectFile *object, const char *name);
+
+/**
+ * Finds the code symbol an address belongs to: the last one at or below it.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Code address.
+ * @param offset - Receives the distance from the symbol.
+ * @return The symbol, or NULL if no symbol precedes the address.
+ */
+const ProgramSymbol *symbol_for_address(const CPU *cpu, uint32_t address, uint32_t *offset);
+
+/**
+ * Looks up a code symbol by name.
+ * @param cpu - Pointer to the CPU structure.
+ * @param name - Symbol name.
+ * @param address - Receives its address.
+ * @return 0 if found, -1 otherwise.
+ */
+int symbol_address(const CPU *cpu, const char *name, uint32_t *address);
+
 
 /**
  * Displays the contents of memory in hexadecimal or ASCII format.
@@ -0,0 +1,135 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Object and executable file format
+//
+//   ObjectHeader                    at offset 0
+//   code section contents           page-aligned
+//   data section contents           page-aligned
+//   ObjectSymbol[symbol_count]      after the last section
+//   string table (NUL-terminated names)
+//   ObjectReloc[reloc_count]        relocatable objects only
+//
+// Section contents start on OBJ_PAGE_SIZE boundaries so a loader can map
+// each one directly; bss occupies no file space. All fields are little-endian.
+
+#define OBJ_MAGIC     0x464F5343u // "CSOF"
+#define OBJ_VERSION   1
+#define OBJ_PAGE_SIZE 4096
+
+typedef enum {
+    OBJ_EXECUTABLE = 1,  // Sections at their load addresses, relocations applied
+    OBJ_RELOCATABLE = 2  // Sections at 0, relocations pending for the linker
+} ObjectType;
+
+typedef enum {
+    SECTION_CODE,
+    SECTION_DATA,
+    SECTION_BSS,
+    OBJ_NUM_SECTIONS
+} SectionIndex;
+
+#define SECTION_UNDEFINED 0xFF // Symbol section: referenced but defined elsewhere
+
+typedef struct {
+    uint32_t address;   // Load address (0 in relocatable objects)
+    uint32_t offset;    // File offset of the contents (0 for bss or empty sections)
+    uint32_t size;      // Size in bytes
+    uint32_t reserved;
+} ObjectSection;
+
+typedef struct {
+    uint32_t magic;     // OBJ_MAGIC
+    uint16_t version;   // OBJ_VERSION
+    uint16_t type;      // ObjectType
+    uint32_t entry;     // Address execution starts at
+    uint32_t page_size; // Alignment of section contents in the file
+    ObjectSection sections[OBJ_NUM_SECTIONS];
+    uint32_t symbol_offset;
+    uint32_t symbol_count;
+    uint32_t string_offset;
+    uint32_t string_size;
+    uint32_t reloc_offset;
+    uint32_t reloc_count;
+} ObjectHeader;
+
+typedef struct {
+    uint32_t name;      // Offset in the string table
+    uint32_t value;     // Address (executables) or offset in its section
+    uint8_t section;    // SectionIndex, or SECTION_UNDEFINED
+    uint8_t reserved[3];
+} ObjectSymbol;
+
+typedef struct {
+    uint32_t offset;    // Byte offset of the patched word in its section
+    uint32_t symbol;    // Index in the symbol table
+    uint32_t line;      // Source line of the reference, for error messages
+    uint8_t section;    // Section holding the patched word
+    uint8_t kind;       // FixupKind
+    uint8_t shift;      // FIXUP_FIELD: bit position of the operand field
+    int8_t sign;        // FIXUP_DISPLACEMENT: -1 for [Rn-label]
+} ObjectReloc;
+
+_Static_assert(sizeof(ObjectHeader) == 88, "ObjectHeader must have no padding");
+_Static_assert(sizeof(ObjectSymbol) == 12, "ObjectSymbol must have no padding");
+_Static_assert(sizeof(ObjectReloc) == 16, "ObjectReloc must have no padding");
+
+// An object in memory. When opened from a file, every pointer refers into a
+// read-only mapping of it; an object assembled in memory (assemble_buffer)
+// owns its contents and tables instead, and mapping is NULL.
+typedef struct {
+    ObjectHeader header;
+    const uint8_t *contents[OBJ_NUM_SECTIONS]; // Section contents (NULL for bss)
+    const ObjectSymbol *symbols;
+    const char *strings;
+    const ObjectReloc *relocs;
+    void *mapping;
+    size_t mapping_size;
+} ObjectFile;
+
+// Function Prototypes
+
+/**
+ * Writes an object file, placing each section on a page boundary. The
+ * header's offsets are computed here; its sizes and counts must be set.
+ * @param path - Output file.
+ * @param object - Header, contents and tables to write.
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int object_write(const char *path, const ObjectFile *object);
+
+/**
+ * Checks whether a file starts with the object magic number.
+ * @param path - File to check.
+ * @return 1 for an object file, 0 otherwise (including unreadable files).
+ */
+int object_is_object_file(const char *path);
+
+/**
+ * Maps an object file read-only and validates its header and tables.
+ * @param path - File to open.
+ * @param object - Receives the header and pointers into the mapping.
+ * @return 0 on success, -1 on an I/O error or malformed file.
+ */
+int object_open(const char *path, ObjectFile *object);
+
+/**
+ * Unmaps an object opened with object_open, or frees one assembled in memory.
+ * @param object - The object.
+ */
+void object_close(ObjectFile *object);
+
+/**
+ * Name of a symbol in an object.
+ * @param object - The object.
+ * @param symbol - One of its symbols.
+ * @return The NUL-terminated name.
+ */
+static inline const char *object_symbol_name(const ObjectFile *object, const ObjectSymbol *symbol) {
+    return object->strings + symbol->name;
+}
+
+#endif // OBJECT_H
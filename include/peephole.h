@@ -0,0 +1,47 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Peephole optimizer for assembly source
+//
+// Runs between parsing and encoding when the assembler is given -O. The
+// source is parsed into labels and instructions, rewritten by local passes
+// over each basic block (a label or a control transfer ends a block), and
+// handed back to the assembler as source text. Every surviving line keeps its
+// original line number, so errors still point at the right place.
+//
+// Passes, repeated until nothing changes:
+//   - redundant load/store elimination: a LOAD of a value a register already
+//     holds is dropped, a LOAD from a location a register mirrors becomes a
+//     register copy, and a STORE of a value just loaded from there is dropped
+//   - constant propagation: registers set by LOAD immediates are tracked, so
+//     operations on known values fold into a LOAD and compare-and-branch
+//     instructions with known operands become a JUMP or disappear
+//   - jump threading: a jump to a JUMP goes straight to its target, and a
+//     jump to the next instruction is removed
+//   - dead-instruction removal: code after JUMP/RET/HALT up to the next label,
+//     and register writes that are overwritten before being read
+
+typedef struct {
+    uint32_t instructions; // Instructions before optimization
+    uint32_t removed;      // Instructions deleted
+    uint32_t rewritten;    // Instructions replaced by cheaper ones
+} PeepholeStats;
+
+// Function Prototypes
+
+/**
+ * Optimizes assembly source. Lines the optimizer does not understand
+ * (directives, malformed instructions) are kept verbatim and act as barriers.
+ * @param source - Assembly source (need not be NUL-terminated).
+ * @param size - Length of the source in bytes.
+ * @param optimized_size - Receives the length of the result.
+ * @param stats - Receives instruction counts.
+ * @return The optimized source (malloc'd, NUL-terminated), or NULL on a line
+ *         longer than the assembler accepts.
+ */
+char *peephole_optimize(const char *source, size_t size, size_t *optimized_size, PeepholeStats *stats);
+
+#endif // PEEPHOLE_H
@@ -0,0 +1,52 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include "cpu.h"
+
+// In-memory build pipeline
+//
+// Carries an HLL or assembly program from source to a loaded CPU without
+// going through the disk: the translator hands its assembly to the assembler
+// as a buffer, the assembler builds the executable object in memory, and the
+// object is copied into the CPU just as `run` copies one from a file. The
+// source file is read once; intermediate files are written only on request.
+
+typedef enum {
+    SOURCE_AUTO,    // By extension: .hll is HLL, anything else assembly
+    SOURCE_HLL,
+    SOURCE_ASSEMBLY
+} SourceKind;
+
+typedef struct {
+    SourceKind kind;
+    unsigned passes;      // HLL optimizer passes (IrPass flags)
+    int optimize;         // Run the peephole optimizer on the assembly
+    const char *save_asm; // Also write the translated assembly here, or NULL
+    const char *save_bin; // Also write the executable here, or NULL
+} PipelineOptions;
+
+// Function Prototypes
+
+/**
+ * Translates (for HLL), assembles and loads a program held in memory, leaving
+ * the CPU ready to run from the program's entry point.
+ * @param cpu - Pointer to an initialized CPU.
+ * @param source - Program source; HLL source must be NUL-terminated.
+ * @param size - Length of the source in bytes.
+ * @param name - Name of the program, for messages and SOURCE_AUTO.
+ * @param options - Source kind, optimizations and files to keep.
+ * @return 0 on success, -1 on error.
+ */
+int load_source(CPU *cpu, const char *source, size_t size, const char *name, const PipelineOptions *options);
+
+/**
+ * Reads a source file once and passes it to load_source.
+ * @param cpu - Pointer to an initialized CPU.
+ * @param path - HLL or assembly source file.
+ * @param options - Source kind, optimizations and files to keep.
+ * @return 0 on success, -1 on error.
+ */
+int load_source_file(CPU *cpu, const char *path, const PipelineOptions *options);
+
+#endif // PIPELINE_H
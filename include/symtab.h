@@ -0,0 +1,82 @@
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Assembler symbol table
+//
+// An open-addressing hash table (linear probing, power-of-two capacity) that
+// doubles when it is 3/4 full. Names are interned into one growing string
+// arena and referenced by offset, so entries stay small and the arena can be
+// reallocated without fixing up pointers. Each assembly owns its own table.
+
+#define SYMTAB_INITIAL_CAPACITY 64
+
+typedef struct {
+    uint32_t name;    // Offset of the interned name in the string arena
+    uint32_t hash;    // Cached hash of the name (0 marks an empty slot)
+    uint32_t address; // Value bound to the symbol
+} SymbolEntry;
+
+typedef struct {
+    SymbolEntry *entries;
+    uint32_t capacity;     // Number of slots (power of two)
+    uint32_t count;        // Occupied slots
+    char *strings;         // Interned names, NUL-separated
+    size_t strings_used;
+    size_t strings_capacity;
+} SymbolTable;
+
+// Function Prototypes
+
+/**
+ * Initializes an empty symbol table.
+ * @param table - Pointer to the table.
+ */
+void symtab_init(SymbolTable *table);
+
+/**
+ * Releases the slots and string arena of a table.
+ * @param table - Pointer to the table.
+ */
+void symtab_free(SymbolTable *table);
+
+/**
+ * Defines a symbol.
+ * @param table - Pointer to the table.
+ * @param name - Symbol name (copied into the arena).
+ * @param address - Value bound to the name.
+ * @return 0 on success, -1 if the name is already defined.
+ */
+int symtab_define(SymbolTable *table, const char *name, uint32_t address);
+
+/**
+ * Looks a symbol up.
+ * @param table - Pointer to the table.
+ * @param name - Symbol name.
+ * @param address - Receives the bound value when found.
+ * @return 1 if the symbol is defined, 0 otherwise.
+ */
+int symtab_lookup(const SymbolTable *table, const char *name, uint32_t *address);
+
+/**
+ * Binds a new value to a symbol that is already defined.
+ * @param table - Pointer to the table.
+ * @param name - Symbol name.
+ * @param address - New value.
+ * @return 0 on success, -1 if the name is not defined.
+ */
+int symtab_update(SymbolTable *table, const char *name, uint32_t address);
+
+/**
+ * Name of an occupied entry, for walking table->entries directly.
+ * @param table - Pointer to the table.
+ * @param entry - An entry of the table with a non-zero hash.
+ * @return The interned name.
+ */
+static inline const char *symtab_entry_name(const SymbolTable *table, const SymbolEntry *entry) {
+    return table->strings + entry->name;
+}
+
+#endif // SYMTAB_H
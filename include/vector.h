@@ -0,0 +1,78 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Guest SIMD extension: 128-bit vector registers of four 32-bit lanes.
+// Lane arithmetic is done with SSE2/SSE4.1 intrinsics when the host compiler
+// targets them, and with a scalar loop otherwise.
+
+#define NUM_VREGISTERS 8
+#define VECTOR_LANES   4
+#define VECTOR_BYTES   (VECTOR_LANES * 4)
+
+typedef struct {
+    uint32_t lanes[VECTOR_LANES];
+} __attribute__((aligned(16))) VectorRegister;
+
+// Function Prototypes
+
+/**
+ * Lane-wise addition (wrapping): d = a + b.
+ * @param d - Destination register.
+ * @param a - First operand.
+ * @param b - Second operand.
+ */
+void vector_add(VectorRegister *d, const VectorRegister *a, const VectorRegister *b);
+
+/**
+ * Lane-wise subtraction (wrapping): d = a - b.
+ * @param d - Destination register.
+ * @param a - First operand.
+ * @param b - Second operand.
+ */
+void vector_sub(VectorRegister *d, const VectorRegister *a, const VectorRegister *b);
+
+/**
+ * Lane-wise multiplication, keeping the low 32 bits: d = a * b.
+ * @param d - Destination register.
+ * @param a - First operand.
+ * @param b - Second operand.
+ */
+void vector_mul(VectorRegister *d, const VectorRegister *a, const VectorRegister *b);
+
+/**
+ * Lane-wise bitwise AND: d = a & b.
+ * @param d - Destination register.
+ * @param a - First operand.
+ * @param b - Second operand.
+ */
+void vector_and(VectorRegister *d, const VectorRegister *a, const VectorRegister *b);
+
+/**
+ * Lane-wise bitwise OR: d = a | b.
+ * @param d - Destination register.
+ * @param a - First operand.
+ * @param b - Second operand.
+ */
+void vector_or(VectorRegister *d, const VectorRegister *a, const VectorRegister *b);
+
+/**
+ * Lane-wise bitwise XOR: d = a ^ b.
+ * @param d - Destination register.
+ * @param a - First operand.
+ * @param b - Second operand.
+ */
+void vector_xor(VectorRegister *d, const VectorRegister *a, const VectorRegister *b);
+
+/**
+ * Lane-wise equality: each lane of d becomes 0xFFFFFFFF if equal, 0 otherwise.
+ * @param d - Destination register.
+ * @param a - First operand.
+ * @param b - Second operand.
+ * @return true if every lane compared equal.
+ */
+bool vector_cmpeq(VectorRegister *d, const VectorRegister *a, const VectorRegister *b);
+
+#endif // VECTOR_H
@@ -1,28 +1,21 @@
 ; hello.asm - Hello, World example (numeric output)
 ; Outputs ASCII codes for "Hello, World" using register 0.
 ; Expected output: 72, 101, 108, 108, 111, 44, 32, 87, 111, 114, 108, 100
-        LOAD 0, 72         ; 'H'
-        OUT 0
-        LOAD 0, 101        ; 'e'
-        OUT 0
-        LOAD 0, 108        ; 'l'
-        OUT 0
-        LOAD 0, 108        ; 'l'
-        OUT 0
-        LOAD 0, 111        ; 'o'
-        OUT 0
-        LOAD 0, 44         ; ',' (comma)
-        OUT 0
-        LOAD 0, 32         ; ' ' (space)
-        OUT 0
-        LOAD 0, 87         ; 'W'
-        OUT 0
-        LOAD 0, 111        ; 'o'
-        OUT 0
-        LOAD 0, 114        ; 'r'
-        OUT 0
-        LOAD 0, 108        ; 'l'
-        OUT 0
-        LOAD 0, 100        ; 'd'
-        OUT 0
+        .data
+MESSAGE:
+        .string "Hello, World"  ; Loaded with the program: no instructions build it
+
+        .text
+        LOAD R1, MESSAGE   ; Address of the next character
+        LOAD R2, 0xFF      ; Byte mask
+        LOAD R3, 1
+        LOAD R4, 0
+NEXT:
+        LOAD R0, [R1]      ; Read a word; its low byte is the character
+        AND R0, R0, R2
+        BEQ R0, R4, DONE   ; Stop at the NUL terminator
+        OUT R0
+        ADD R1, R1, R3
+        JUMP NEXT
+DONE:
         HALT
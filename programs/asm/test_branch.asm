@@ -0,0 +1,16 @@
+; test_branch.asm - Test comparison opcodes and fused compare-and-branch
+; Should print: R2=1 (5 > 3), then R0=0, R0=1, R0=2 (BLT loop), then R3=0 (5 == 3)
+
+LOAD R0, 5
+LOAD R1, 3
+GT R2, R0, R1
+OUT R2
+EQ R3, R0, R1
+LOAD R0, 0
+LOAD R4, 1
+LOOP:
+OUT R0
+ADD R0, R0, R4
+BLT R0, R1, LOOP
+OUT R3
+HALT
@@ -0,0 +1,32 @@
+; test_data.asm - Test data directives and the preinitialized data section
+; Should print: R0=0000000A (sum of TABLE), R1=00216948 ("Hi!" read as one word),
+; R2=00000041 ('A' through POINTER), R5=FFFFFFFF (.space fill)
+
+        .data
+TABLE:  .word 1, 2, 3, 4
+GREETING:
+        .string "Hi!"        ; Four bytes with the NUL
+LETTER: .byte 'A', 0, 0, 0
+        .align 4
+POINTER:
+        .word LETTER         ; Address of another data label
+PAD:    .space 4, 0xFF
+
+        .text
+        LOAD R1, TABLE       ; A data label is its address
+        LOAD R2, 4
+        LOAD R3, 4
+        LOAD R0, 0
+SUM:
+        LOAD R4, [R1]
+        ADD R0, R0, R4
+        ADD R1, R1, R3
+        DJNZ R2, SUM
+        OUT R0
+        LOAD R1, [GREETING]
+        OUT R1
+        LOAD R2, [[POINTER]]
+        OUT R2
+        LOAD R5, [PAD]
+        OUT R5
+        HALT
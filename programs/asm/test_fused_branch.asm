@@ -0,0 +1,32 @@
+; test_fused_branch.asm - Test compares followed by JZ/JNZ
+; Should print: R1=5 (count up while R1 < R2), R3=3 (count down until
+; R3 == 3), then R5=7 (the compare result is read after the branch), with
+; or without assemble -O, which fuses the first two pairs into BLT and BNE.
+
+        LOAD R1, 0
+        LOAD R2, 5
+        LOAD R4, 1
+UP:
+        ADD R1, R1, R4
+        LT R0, R1, R2
+        JNZ UP
+        LOAD R0, 0          ; R0 and the flags are rewritten on the way out
+        OUT R1
+        LOAD R3, 10
+        LOAD R6, 3
+        SUB R3, R3, R4
+
+DOWN:
+        SUB R3, R3, R4
+        EQ R0, R3, R6
+        JZ DOWN
+        LOAD R0, 0
+        OUT R3
+
+        LOAD R5, 6
+        GT R7, R2, R6
+        JZ SKIP             ; Not fused: R7 is read below
+        ADD R5, R5, R7
+SKIP:
+        OUT R5
+        HALT
@@ -0,0 +1,13 @@
+; test_heap.asm - Test ALLOC/FREE on the guest heap
+; Should print: R0=300 (first block), R1=308 (second block), R2=300 (reused block)
+
+LOAD 3, 8
+ALLOC 0, 3
+OUT 0
+ALLOC 1, 3
+OUT 1
+FREE 0
+LOAD 3, 5
+ALLOC 2, 3
+OUT 2
+HALT
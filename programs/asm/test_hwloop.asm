@@ -0,0 +1,19 @@
+; test_hwloop.asm - Test DJNZ and nested hardware loops
+; Should print: R0=3, R0=2, R0=1 (DJNZ countdown), then R2=6 (2x3 nested LOOP body runs)
+
+        LOAD R0, 3
+COUNT:
+        OUT R0
+        DJNZ R0, COUNT
+
+        LOAD R1, 2
+        LOAD R3, 3
+        LOAD R4, 1
+        LOAD R2, 0
+        LOOP R1, OUTER_END
+        LOOP R3, INNER_END
+        ADD R2, R2, R4      ; Body: runs 2 * 3 times, no loop-control dispatch
+INNER_END:
+OUTER_END:
+        OUT R2
+        HALT
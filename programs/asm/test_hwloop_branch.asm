@@ -0,0 +1,19 @@
+; test_hwloop_branch.asm - Test a branch to the end of a hardware loop
+; Should print: R2=3 (the body runs 3 times), with or without assemble -O.
+; The JUMP at END must not be threaded into JNZ: the loop counts an
+; iteration when the PC reaches END.
+
+        LOAD R1, 3
+        LOAD R2, 0
+        LOAD R4, 1
+        LOOP R1, END
+        ADD R2, R2, R4
+        JNZ END             ; Always taken: skips the OUT
+        OUT R1
+END:
+        JUMP DONE
+OTHER:
+        OUT R1
+DONE:
+        OUT R2
+        HALT
@@ -0,0 +1,43 @@
+; test_memory.asm - Test bulk memory instructions
+; Fills 16 bytes with 0xAB, copies them, compares the copies.
+; Should print: R0=ABABABAB (copied word), R9=1 (MEMCMP equal), R10=1 (MEMCMP differs after a store),
+; then stop with "MEMSET destination range 00002000-0000200F (16 bytes) leaves its segment"
+; (an address past the end of memory) before the final OUT.
+
+LOAD R1, 0x100
+LOAD R2, 0xAB
+LOAD R3, 16
+MEMSET R1, R2, R3
+LOAD R4, 0x140
+MEMCPY R4, R1, R3
+MEMCMP R1, R4, R3
+LOAD R9, 0
+JNZ DIFF
+LOAD R9, 1
+DIFF:
+
+; Change the last word of the copy and compare again
+LOAD R5, 0x14C
+LOAD R6, 0xFFFFFFFF
+STORE R6, R5
+MEMCMP R1, R4, R3
+LOAD R10, 1
+JNZ SAME
+LOAD R10, 0
+SAME:
+
+; Read one copied word back through the stack
+PUSH R0
+LOAD R7, 0x2FC
+LOAD R8, 4
+MEMCPY R7, R4, R8
+POP R0
+OUT R0
+OUT R9
+OUT R10
+
+; A block past the end of memory belongs to no segment
+LOAD R11, 0x2000
+MEMSET R11, R2, R3
+OUT R11
+HALT
@@ -0,0 +1,27 @@
+; test_modes.asm - Test memory, indirect, indexed and immediate operands
+; Should print: R0=0x3C (10+20+30 summed from memory with indexed operands),
+; then R1=0x46 (0x3C + [0x10C] via a memory operand), R2=0x0A (through a pointer),
+; then R3=0x41 (0x3C + #5)
+
+        STORE #10, [0x100]        ; Build the array at 0x100
+        STORE #20, [0x104]
+        STORE #30, [0x108]
+        STORE #10, [0x10C]
+        LOAD R6, 0x100
+        STORE R6, [0x110]         ; Pointer to the first element
+
+        LOAD R0, 0
+        LOAD R4, 0x100          ; R4 walks the array
+        LOAD R5, 3
+        LOOP R5, SUMMED
+        ADD R0, R0, [R4]        ; No separate LOAD per element
+        ADD R4, R4, #4
+SUMMED:
+        OUT R0
+        ADD R1, R0, [0x10C]
+        OUT R1
+        LOAD R2, [[0x110]]
+        OUT R2
+        ADD R3, R0, #5
+        OUT R3
+        HALT
@@ -0,0 +1,66 @@
+; test_vector.asm - Test 128-bit vector registers
+; Adds [1 2 3 4] + [10 20 30 40] lane-wise, then multiplies by [2 2 2 2].
+; Should print: 0x16, 0x2C, 0x42, 0x58 (22, 44, 66, 88), then R9=1 (VCMP equal)
+
+; Build the two source arrays in the data segment
+LOAD R1, 0x100
+LOAD R2, 0x110
+LOAD R3, 4
+LOAD R4, 1
+LOAD R5, 10
+LOAD R6, 0
+FILL:
+STORE R4, R1
+STORE R5, R2
+ADD R1, R1, R3
+ADD R2, R2, R3
+LOAD R7, 1
+ADD R4, R4, R7
+LOAD R7, 10
+ADD R5, R5, R7
+ADD R6, R6, R7
+LOAD R7, 40
+BLT R6, R7, FILL
+
+LOAD R1, 0x100
+LOAD R2, 0x110
+VLOAD V0, R1
+VLOAD V1, R2
+VADD V2, V0, V1
+
+; Broadcast 2 into V3 and multiply
+LOAD R4, 2
+LOAD R1, 0x120
+STORE R4, R1
+ADD R1, R1, R3
+STORE R4, R1
+ADD R1, R1, R3
+STORE R4, R1
+ADD R1, R1, R3
+STORE R4, R1
+LOAD R1, 0x120
+VLOAD V3, R1
+VMUL V2, V2, V3
+VCMP V4, V2, V2
+LOAD R9, 0
+JNZ SKIP
+LOAD R9, 1
+SKIP:
+
+; Read the lanes back through the stack: reserve 16 bytes, store, pop
+PUSH R0
+PUSH R0
+PUSH R0
+PUSH R0
+LOAD R1, 0x2F0
+VSTORE V2, R1
+POP R0
+OUT R0
+POP R0
+OUT R0
+POP R0
+OUT R0
+POP R0
+OUT R0
+OUT R9
+HALT
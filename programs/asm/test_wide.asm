@@ -0,0 +1,13 @@
+; test_wide.asm - Test 32-bit literals (extended encoding)
+; Should print: R0=000186A0 (100000), R1=FFFFFFFF (-1), R2=12345678
+
+LOAD 0, 100000
+OUT 0
+LOAD 1, -1
+OUT 1
+LOAD 2, 0x12345678
+JUMP DONE
+LOAD 2, 0
+DONE:
+OUT 2
+HALT
@@ -0,0 +1,199 @@
+#include "asm_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdatomic.h>
+
+static const char *cache_dir(void) {
+    const char *dir = getenv("CPU_SIM_CACHE_DIR");
+    return (dir && *dir) ? dir : ASM_CACHE_DIR_DEFAULT;
+}
+
+static uint64_t cache_limit(void) {
+    const char *limit = getenv("CPU_SIM_CACHE_SIZE");
+    return (limit && *limit) ? strtoull(limit, NULL, 0) : ASM_CACHE_LIMIT_DEFAULT;
+}
+
+int asm_cache_enabled(void) {
+    return strcmp(cache_dir(), "off") != 0;
+}
+
+// FNV-1a with the 128-bit parameters: prime 2^88 + 0x13B
+static unsigned __int128 hash_bytes(unsigned __int128 hash, const uint8_t *bytes, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash = (hash << 88) + hash * 0x13B;
+    }
+    return hash;
+}
+
+int asm_cache_key(const char *source_file, const char *options, AsmCacheKey *key) {
+    int fd = open(source_file, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    const uint8_t *source = NULL;
+    if (info.st_size > 0) {
+        source = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (source == MAP_FAILED) {
+        return -1;
+    }
+
+    // Options first, NUL-separated, so no source can alias another option string
+    unsigned __int128 hash = ((unsigned __int128)0x6C62272E07BB0142ull << 64) | 0x62B821756295C58Dull;
+    hash = hash_bytes(hash, (const uint8_t *)options, strlen(options) + 1);
+    hash = hash_bytes(hash, source, (size_t)info.st_size);
+    if (source) {
+        munmap((void *)source, (size_t)info.st_size);
+    }
+    snprintf(key->hex, sizeof(key->hex), "%016llx%016llx",
+             (unsigned long long)(hash >> 64), (unsigned long long)hash);
+    return 0;
+}
+
+static void entry_path(const AsmCacheKey *key, char *path, size_t size) {
+    snprintf(path, size, "%s/%s", cache_dir(), key->hex);
+}
+
+int asm_cache_lookup(const AsmCacheKey *key, char *path, size_t size) {
+    entry_path(key, path, size);
+    if (access(path, R_OK) != 0) {
+        return 0;
+    }
+    utimensat(AT_FDCWD, path, NULL, 0); // Most recently used now
+    return 1;
+}
+
+static int copy_file(const char *from, const char *to) {
+    int in = open(from, O_RDONLY);
+    if (in < 0) {
+        return -1;
+    }
+    int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out < 0) {
+        close(in);
+        return -1;
+    }
+    char buffer[65536];
+    ssize_t count;
+    int status = 0;
+    while ((count = read(in, buffer, sizeof(buffer))) > 0) {
+        if (write(out, buffer, (size_t)count) != count) {
+            status = -1;
+            break;
+        }
+    }
+    if (count < 0) {
+        status = -1;
+    }
+    close(in);
+    if (close(out) != 0) {
+        status = -1;
+    }
+    return status;
+}
+
+int asm_cache_fetch(const AsmCacheKey *key, const char *output_file) {
+    char path[ASM_CACHE_PATH_MAX];
+    if (!asm_cache_lookup(key, path, sizeof(path))) {
+        return 0;
+    }
+    return copy_file(path, output_file) == 0;
+}
+
+typedef struct {
+    char name[ASM_CACHE_KEY_HEX + 1];
+    off_t size;
+    struct timespec used;
+} CacheEntry;
+
+static int compare_last_use(const void *a, const void *b) {
+    const struct timespec *x = &((const CacheEntry *)a)->used;
+    const struct timespec *y = &((const CacheEntry *)b)->used;
+    if (x->tv_sec != y->tv_sec) {
+        return x->tv_sec < y->tv_sec ? -1 : 1;
+    }
+    return (x->tv_nsec > y->tv_nsec) - (x->tv_nsec < y->tv_nsec);
+}
+
+// Remove least recently used entries until the directory fits the limit,
+// keeping the entry just stored
+static void evict(const AsmCacheKey *keep) {
+    DIR *dir = opendir(cache_dir());
+    if (!dir) {
+        return;
+    }
+    CacheEntry *entries = NULL;
+    size_t count = 0, capacity = 0;
+    uint64_t total = 0;
+    char path[ASM_CACHE_PATH_MAX];
+    struct dirent *item;
+    while ((item = readdir(dir)) != NULL) {
+        struct stat info;
+        if (strlen(item->d_name) != ASM_CACHE_KEY_HEX) {
+            continue; // ".", "..", and temporaries
+        }
+        snprintf(path, sizeof(path), "%s/%s", cache_dir(), item->d_name);
+        if (stat(path, &info) != 0 || !S_ISREG(info.st_mode)) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            CacheEntry *grown = realloc(entries, capacity * sizeof(CacheEntry));
+            if (!grown) {
+                break;
+            }
+            entries = grown;
+        }
+        memcpy(entries[count].name, item->d_name, sizeof(entries[count].name));
+        entries[count].size = info.st_size;
+        entries[count].used = info.st_mtim;
+        total += (uint64_t)info.st_size;
+        count++;
+    }
+    closedir(dir);
+
+    uint64_t limit = cache_limit();
+    if (total > limit) {
+        qsort(entries, count, sizeof(CacheEntry), compare_last_use);
+        for (size_t i = 0; i < count && total > limit; i++) {
+            if (strcmp(entries[i].name, keep->hex) == 0) {
+                continue;
+            }
+            snprintf(path, sizeof(path), "%s/%s", cache_dir(), entries[i].name);
+            if (unlink(path) == 0) {
+                total -= (uint64_t)entries[i].size;
+            }
+        }
+    }
+    free(entries);
+}
+
+void asm_cache_store(const AsmCacheKey *key, const char *file) {
+    static atomic_uint sequence;
+    char temporary[ASM_CACHE_PATH_MAX], path[ASM_CACHE_PATH_MAX];
+    if (mkdir(cache_dir(), 0777) != 0 && access(cache_dir(), W_OK) != 0) {
+        return;
+    }
+
+    // Write under a private name, then rename into place
+    snprintf(temporary, sizeof(temporary), "%s/%s.tmp.%ld.%u", cache_dir(), key->hex,
+             (long)getpid(), atomic_fetch_add(&sequence, 1));
+    entry_path(key, path, sizeof(path));
+    if (copy_file(file, temporary) != 0 || rename(temporary, path) != 0) {
+        unlink(temporary);
+        return;
+    }
+    evict(key);
+}
@@ -5,14 +5,34 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include "debug.h"
+#include "memory.h" // Program symbols for the trace
+
+_Static_assert(NUM_REGISTERS >= 4 && NUM_REGISTERS <= 32,
+               "NUM_REGISTERS must be between 4 and 32 (dirty_registers is a 32-bit mask)");
 
 int call_depth = 0;
-uint32_t params[10] = {0};
-int param_count = 0;
+
+// Drop breakpoints, watchpoints, pending events and the predecoded stream
+static void clear_debug_state(CPU *cpu) {
+    memset(cpu->predecoded_valid, 0, sizeof(cpu->predecoded_valid));
+    memset(cpu->breakpoints, 0, sizeof(cpu->breakpoints));
+    memset(cpu->watch_lines, 0, sizeof(cpu->watch_lines));
+    cpu->events = 0;
+    cpu->at_breakpoint = false;
+    cpu->watch_count = 0;
+    cpu->watch_hit = -1;
+}
 
 // Initialize the CPU
 void init_cpu(CPU *cpu) {
     memset(cpu->registers, 0, sizeof(cpu->registers)); // Clear all registers
+    memset(cpu->vregisters, 0, sizeof(cpu->vregisters)); // Clear vector registers
+    cpu->instructions_executed = 0;
+    cpu->vector_instructions = 0;
+    cpu->loop_depth = 0;
+    cpu->symbol_count = 0;                             // No program symbols until one is loaded
+    cpu->profiling = false;
+    memset(cpu->profile, 0, sizeof(cpu->profile));
 
     // Clear all flags
     cpu->flags.z = 0;
@@ -24,13 +44,24 @@ void init_cpu(CPU *cpu) {
 
     cpu->sp = STACK_END;                               // Set SP to the top of the stack
     cpu->heap_pointer = HEAP_START;                    // Set heap pointer to start of heap
+    heap_init(&cpu->heap);                             // Empty free lists, zeroed statistics
     memset(cpu->memory, 0, MEMORY_SIZE);               // Clear memory
     cpu->halted = false;                               // Ensure CPU is not halted
+    cpu->trace_mode = TRACE_CHANGES;                   // Differential display by default
+    clear_dirty_state(cpu);                            // Nothing changed yet
+    clear_debug_state(cpu);                            // No breakpoints, watchpoints or predecoded code
 }
 
 // Reset the CPU
 void reset_cpu(CPU *cpu) {
     memset(cpu->registers, 0, sizeof(cpu->registers)); // Clear all registers
+    memset(cpu->vregisters, 0, sizeof(cpu->vregisters)); // Clear vector registers
+    cpu->instructions_executed = 0;
+    cpu->vector_instructions = 0;
+    cpu->loop_depth = 0;
+    cpu->symbol_count = 0;                             // No program symbols until one is loaded
+    cpu->profiling = false;
+    memset(cpu->profile, 0, sizeof(cpu->profile));
 
     // Clear all flags
     cpu->flags.z = 0;
@@ -40,15 +71,37 @@ void reset_cpu(CPU *cpu) {
     cpu->pc = CODE_START;                              // Reset PC
     cpu->sp = STACK_END;                               // Reset SP
     cpu->heap_pointer = HEAP_START;                    // Reset heap pointer
+    heap_init(&cpu->heap);                             // Reset allocator
     memset(cpu->memory, 0, MEMORY_SIZE);               // Clear memory
     cpu->halted = false;                               // Ensure CPU is not halted
+    cpu->trace_mode = TRACE_CHANGES;                   // Differential display by default
+    clear_dirty_state(cpu);                            // Nothing changed yet
+    clear_debug_state(cpu);                            // No breakpoints, watchpoints or predecoded code
 }
 
 
+// Write a register and remember it changed
+void write_register(CPU *cpu, uint32_t index, uint32_t value) {
+    if (index >= NUM_REGISTERS) {
+        fprintf(stderr, "Error: Register index %u out of bounds at PC %08X.\n", index, cpu->pc);
+        cpu->halted = true;
+        return;
+    }
+    cpu->registers[index] = value;
+    cpu->dirty_registers |= 1u << index;
+}
+
+// Forget all recorded changes
+void clear_dirty_state(CPU *cpu) {
+    memset(cpu->dirty_lines, 0, sizeof(cpu->dirty_lines));
+    cpu->dirty_registers = 0;
+    cpu->dirty_vregisters = 0;
+}
+
 
 // Fetch an instruction from memory
 static uint32_t fetch_instruction(CPU *cpu) {
-    if (cpu->pc < CODE_START || cpu->pc > CODE_END) {
+    if (cpu->pc < CODE_START || cpu->pc + sizeof(uint32_t) > CODE_END) {
         fprintf(stderr, "Error: PC out of memory bounds at %08X.\n", cpu->pc);
         cpu->halted = true;
         return 0;
@@ -56,6 +109,19 @@ static uint32_t fetch_instruction(CPU *cpu) {
     return *((uint32_t *)&cpu->memory[cpu->pc]);
 }
 
+// Decode the word at PC into the predecoded stream. Breakpoints are patched
+// in here, so the run loop never has to look them up.
+static void predecode_instruction(CPU *cpu, uint32_t index) {
+    uint64_t bit = 1ull << (index % 64);
+    if (cpu->breakpoints[index / 64] & bit) {
+        Instruction trap = { .opcode = BRK };
+        cpu->predecoded[index] = trap;
+    } else {
+        cpu->predecoded[index] = decode_instruction_at(cpu->memory, CODE_START + index * 4);
+    }
+    cpu->predecoded_valid[index / 64] |= bit;
+}
+
 
 int compile_c_file(const char *c_file) {
     printf("Compiling %s...\n", c_file);
@@ -71,39 +137,146 @@ int compile_c_file(const char *c_file) {
 }
 
 
-// Run the CPU (fetch-decode-execute loop)
+// Execute instructions until halt, breakpoint, watchpoint or step limit
+StopReason execute_cpu(CPU *cpu, uint64_t max_steps) {
+    bool resume = cpu->at_breakpoint; // Step over the breakpoint we stopped on
+    cpu->at_breakpoint = false;
 
-void run_cpu(CPU *cpu) {
-    printf("Initial CPU state:\n");
-    display_memory_segments(cpu); // Display initial memory layout
+    for (uint64_t steps = 0; !cpu->halted; steps++) {
+        // Slow path: only taken after a code write or a watchpoint hit
+        if (cpu->events) {
+            if (cpu->events & EVENT_CODE_WRITE) {
+                memset(cpu->predecoded_valid, 0, sizeof(cpu->predecoded_valid));
+            }
+            if (cpu->events & EVENT_WATCH_HIT) {
+                cpu->events = 0;
+                return STOP_WATCHPOINT;
+            }
+            cpu->events = 0;
+        }
+        if (steps == max_steps) {
+            return STOP_STEP_LIMIT;
+        }
 
-    while (!cpu->halted) {
-        printf("\nExecuting instruction at PC: %08X\n", cpu->pc);
         uint32_t old_pc = cpu->pc; // Save PC before execution
-        uint32_t raw_instruction = fetch_instruction(cpu);
-        Instruction instruction = decode_instruction(raw_instruction);
+        Instruction instruction;
+        if (cpu->pc >= CODE_START && cpu->pc + sizeof(uint32_t) <= CODE_END && cpu->pc % 4 == 0) {
+            // Predecoded slots are per word; an extended instruction's slot
+            // already carries its literal, so the literal word is never fetched.
+            uint32_t index = (cpu->pc - CODE_START) / 4;
+            if (!(cpu->predecoded_valid[index / 64] & (1ull << (index % 64)))) {
+                predecode_instruction(cpu, index);
+            }
+            instruction = cpu->predecoded[index];
+            if (cpu->profiling) {
+                cpu->profile[index]++;
+            }
+        } else {
+            fetch_instruction(cpu); // Reports an out-of-bounds PC and halts
+            if (cpu->halted) {
+                break;
+            }
+            instruction = decode_instruction_at(cpu->memory, cpu->pc); // Unaligned PC: not predecoded
+        }
+
+        if (instruction.opcode == BRK) {
+            if (!resume) {
+                cpu->at_breakpoint = true;
+                return STOP_BREAKPOINT;
+            }
+            uint32_t index = (cpu->pc - CODE_START) / 4;
+            if (cpu->breakpoints[index / 64] & (1ull << (index % 64))) {
+                // Patched breakpoint: run the original instruction underneath
+                instruction = decode_instruction_at(cpu->memory, cpu->pc);
+            } else {
+                // BRK assembled into the program: resuming just moves past it
+                cpu->pc += sizeof(uint32_t);
+                resume = false;
+                continue;
+            }
+        }
+        resume = false;
+
+        if (cpu->trace_mode != TRACE_NONE) {
+            uint32_t offset;
+            const ProgramSymbol *symbol = symbol_for_address(cpu, cpu->pc, &offset);
+            if (symbol) {
+                printf("\nExecuting instruction at PC: %08X <%s+%u>\n", cpu->pc, symbol->name, offset);
+            } else {
+                printf("\nExecuting instruction at PC: %08X\n", cpu->pc);
+            }
+        }
 
         // Execute instruction
         execute_instruction(cpu, instruction);
+        cpu->instructions_executed++;
 
         // Display memory and register changes
-        printf("\nUpdated Memory Segments:\n");
-        display_memory_segments(cpu);
-        printf("\nUpdated Registers:\n");
-        display_registers(cpu);
+        if (cpu->trace_mode == TRACE_FULL) {
+            printf("\nUpdated Memory Segments:\n");
+            display_memory_segments(cpu);
+            printf("\nUpdated Registers:\n");
+            display_registers(cpu);
+            clear_dirty_state(cpu);
+        } else if (cpu->trace_mode == TRACE_CHANGES) {
+            display_changes(cpu);
+        }
 
         if (!cpu->halted) {
             // Only advance PC if it wasn't changed by a jump instruction
             if (cpu->pc == old_pc) {
-                cpu->pc += sizeof(uint32_t);
+                cpu->pc += instruction.size;
+            }
+
+            // Hardware loops: reaching the end address re-enters the body
+            // without dispatching a loop-control instruction
+            while (cpu->loop_depth && cpu->pc == cpu->loop_stack[cpu->loop_depth - 1].end) {
+                HardwareLoop *loop = &cpu->loop_stack[cpu->loop_depth - 1];
+                if (--loop->count) {
+                    cpu->pc = loop->start;
+                    break;
+                }
+                cpu->loop_depth--; // Done; an enclosing loop may end here too
             }
         }
     }
+    return STOP_HALTED;
+}
 
-    printf("\nCPU halted at PC: %08X\n", cpu->pc);
-    display_memory_segments(cpu);
-    printf("\nFinal CPU state:\n");
-    display_registers(cpu);
+// Run the CPU (fetch-decode-execute loop)
+
+void run_cpu(CPU *cpu) {
+    if (cpu->trace_mode != TRACE_NONE) {
+        printf("Initial CPU state:\n");
+        display_memory_segments(cpu); // Display initial memory layout
+    }
+    clear_dirty_state(cpu);       // Later displays are relative to this one
+
+    // Without a debugger attached, BRK instructions are reported and skipped
+    while (execute_cpu(cpu, UINT64_MAX) != STOP_HALTED) {
+        printf("Breakpoint at PC: %08X (continuing)\n", cpu->pc);
+    }
+
+    if (cpu->trace_mode != TRACE_NONE) {
+        printf("\nCPU halted at PC: %08X\n", cpu->pc);
+        display_memory_segments(cpu);
+        printf("\nFinal CPU state:\n");
+        display_registers(cpu);
+    }
+
+    printf("Instructions executed: %llu", (unsigned long long)cpu->instructions_executed);
+    if (cpu->vector_instructions) {
+        printf(" (%llu vector, %llu lane operations)", (unsigned long long)cpu->vector_instructions,
+               (unsigned long long)cpu->vector_instructions * VECTOR_LANES);
+    }
+    printf("\n");
+
+    if (cpu->heap.alloc_count || cpu->heap.failed_allocs) {
+        heap_report_stats(&cpu->heap, cpu->heap_pointer);
+    }
+    if (cpu->profiling) {
+        display_profile(cpu);
+    }
 }
 
 
@@ -187,11 +360,13 @@ void display_stack(CPU *cpu) {
     }
 }
 
-void log_function_call(const char *func_name, int call_depth, uint32_t *params, int param_count) {
-    printf("Function Call: %s (Depth: %d)\n", func_name, call_depth);
-    printf("Parameters:\n");
-    for (int i = 0; i < param_count; ++i) {
-        printf("  Param %d: %08X\n", i + 1, params[i]);
+void log_function_call(const CPU *cpu, uint32_t target, int call_depth) {
+    uint32_t offset;
+    const ProgramSymbol *symbol = symbol_for_address(cpu, target, &offset);
+    if (symbol && offset == 0) {
+        printf("Function Call: %s (Depth: %d)\n", symbol->name, call_depth);
+    } else {
+        printf("Function Call: %08X (Depth: %d)\n", target, call_depth);
     }
 }
 
@@ -1,14 +1,72 @@
 #include "debug.h"
+#include "memory.h" // Program symbols
 #include <stdio.h>
 #include <ctype.h> // For isprint()
 
 // Display the contents of all registers
 void display_registers(const CPU *cpu) {
     for (int i = 0; i < NUM_REGISTERS; i++) {
-        printf("R%d: %08X\n", i, cpu->registers[i]);
+        // Four registers per row keeps 16/32-register files readable
+        printf("R%-2d: %08X%s", i, cpu->registers[i], (i % 4 == 3 || i == NUM_REGISTERS - 1) ? "\n" : "  ");
+    }
+    for (int i = 0; i < NUM_VREGISTERS; i++) {
+        const uint32_t *lanes = cpu->vregisters[i].lanes;
+        if (lanes[0] | lanes[1] | lanes[2] | lanes[3]) { // Only vector registers in use
+            printf("V%d: %08X %08X %08X %08X\n", i, lanes[0], lanes[1], lanes[2], lanes[3]);
+        }
     }
     printf("PC: %08X SP: %08X Flags: Z=%d N=%d O=%d\n",
            cpu->pc, cpu->sp, cpu->flags.z, cpu->flags.n, cpu->flags.o);
+    for (int i = cpu->loop_depth - 1; i >= 0; i--) { // Innermost first
+        const HardwareLoop *loop = &cpu->loop_stack[i];
+        printf("Loop %d: body %08X-%08X, %u iteration(s) left\n", i, loop->start, loop->end, loop->count);
+    }
+}
+
+// Name of the segment containing an address
+static const char *segment_name(uint32_t address) {
+    if (address < CODE_END) return "Code";
+    if (address < DATA_END) return "Data";
+    if (address < STACK_END) return "Stack";
+    return "Heap";
+}
+
+// Display what changed since the last display
+void display_changes(CPU *cpu) {
+    printf("\nChanged Registers:");
+    if (cpu->dirty_registers == 0 && cpu->dirty_vregisters == 0) {
+        printf(" none");
+    }
+    for (int i = 0; i < NUM_REGISTERS; i++) {
+        if (cpu->dirty_registers & (1u << i)) {
+            printf(" R%d=%08X", i, cpu->registers[i]);
+        }
+    }
+    for (int i = 0; i < NUM_VREGISTERS; i++) {
+        if (cpu->dirty_vregisters & (1u << i)) {
+            const uint32_t *lanes = cpu->vregisters[i].lanes;
+            printf(" V%d=[%08X %08X %08X %08X]", i, lanes[0], lanes[1], lanes[2], lanes[3]);
+        }
+    }
+    printf("\nPC: %08X SP: %08X Flags: Z=%d N=%d O=%d\n",
+           cpu->pc, cpu->sp, cpu->flags.z, cpu->flags.n, cpu->flags.o);
+
+    for (int word = 0; word < DIRTY_LINE_WORDS; word++) {
+        uint64_t bits = cpu->dirty_lines[word];
+        while (bits) {
+            int line = word * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+
+            uint32_t addr = (uint32_t)line * DIRTY_LINE_SIZE;
+            printf("%-5s 0x%08X: ", segment_name(addr), addr);
+            for (int i = 0; i < DIRTY_LINE_SIZE; i++) {
+                printf("%02X ", cpu->memory[addr + i]);
+            }
+            printf("\n");
+        }
+    }
+
+    clear_dirty_state(cpu);
 }
 
 // Display the current state of memory in a specified range
@@ -37,7 +95,7 @@ void display_cpu_state(const CPU *cpu) {
     printf("=== CPU State ===\n");
 
     // Display registers
-    for (int i = 0; i < 4; i++) {
+    for (int i = 0; i < NUM_REGISTERS; i++) {
         printf("R%d: %08X\n", i, cpu->registers[i]);
     }
 
@@ -56,9 +114,41 @@ void display_cpu_state(const CPU *cpu) {
 // Display the decoded instruction for debugging purposes
 void display_instruction_debug(const Instruction *instruction) {
     printf("\n=== Decoded Instruction ===\n");
-    printf("Opcode: %02X\n", instruction->opcode);
+    char text[64];
+    disassemble_instruction(instruction, text, sizeof(text));
+    printf("Opcode: %02X (%s)\n", instruction->opcode, text);
     printf("Operands: %u, %u, %u\n",
            instruction->operands[0],
            instruction->operands[1],
            instruction->operands[2]);
 }
+
+// Instructions executed per code symbol, busiest first
+void display_profile(const CPU *cpu) {
+    uint64_t counts[MAX_PROGRAM_SYMBOLS + 1] = {0}; // Last slot: code before the first symbol
+    for (int index = 0; index < CODE_WORDS; index++) {
+        if (cpu->profile[index] == 0) {
+            continue;
+        }
+        uint32_t offset;
+        const ProgramSymbol *symbol = symbol_for_address(cpu, CODE_START + index * 4, &offset);
+        counts[symbol ? symbol - cpu->symbols : MAX_PROGRAM_SYMBOLS] += cpu->profile[index];
+    }
+
+    printf("Profile (instructions per symbol):\n");
+    for (;;) {
+        int busiest = -1;
+        for (int i = 0; i <= MAX_PROGRAM_SYMBOLS; i++) {
+            if (counts[i] && (busiest < 0 || counts[i] > counts[busiest])) {
+                busiest = i;
+            }
+        }
+        if (busiest < 0) {
+            break;
+        }
+        const char *name = busiest < MAX_PROGRAM_SYMBOLS ? cpu->symbols[busiest].name : "(no symbol)";
+        printf("  %10llu  %5.1f%%  %s\n", (unsigned long long)counts[busiest],
+               cpu->instructions_executed ? 100.0 * counts[busiest] / cpu->instructions_executed : 0.0, name);
+        counts[busiest] = 0;
+    }
+}
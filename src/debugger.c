@@ -0,0 +1,241 @@
+#include "debugger.h"
+#include "debug.h"
+#include "memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Set or clear the watch bit for every line the word at address touches
+static void mark_watch_lines(CPU *cpu, uint32_t address) {
+    uint32_t first = address / DIRTY_LINE_SIZE;
+    uint32_t last = (address + 3) / DIRTY_LINE_SIZE;
+    cpu->watch_lines[first / 64] |= 1ull << (first % 64);
+    cpu->watch_lines[last / 64] |= 1ull << (last % 64);
+}
+
+static int code_word_index(uint32_t address) {
+    if (address < CODE_START || address + sizeof(uint32_t) > CODE_END || address % 4 != 0) {
+        return -1;
+    }
+    return (int)((address - CODE_START) / 4);
+}
+
+int add_breakpoint(CPU *cpu, uint32_t address) {
+    int index = code_word_index(address);
+    if (index < 0) {
+        return -1;
+    }
+    cpu->breakpoints[index / 64] |= 1ull << (index % 64);
+    cpu->predecoded_valid[index / 64] &= ~(1ull << (index % 64)); // Re-patch on next fetch
+    return 0;
+}
+
+int remove_breakpoint(CPU *cpu, uint32_t address) {
+    int index = code_word_index(address);
+    if (index < 0 || !(cpu->breakpoints[index / 64] & (1ull << (index % 64)))) {
+        return -1;
+    }
+    cpu->breakpoints[index / 64] &= ~(1ull << (index % 64));
+    cpu->predecoded_valid[index / 64] &= ~(1ull << (index % 64));
+    return 0;
+}
+
+int add_watchpoint(CPU *cpu, uint32_t address, uint8_t kinds) {
+    if (address + sizeof(uint32_t) > MEMORY_SIZE || kinds == 0) {
+        return -1;
+    }
+    for (int i = 0; i < cpu->watch_count; i++) {
+        if (cpu->watchpoints[i].address == address) {
+            cpu->watchpoints[i].kinds |= kinds;
+            return 0;
+        }
+    }
+    if (cpu->watch_count >= MAX_WATCHPOINTS) {
+        return -1;
+    }
+
+    Watchpoint *watch = &cpu->watchpoints[cpu->watch_count++];
+    watch->address = address;
+    watch->kinds = kinds;
+    watch->last_value = read_memory(cpu->memory, address);
+    mark_watch_lines(cpu, address);
+    return 0;
+}
+
+int remove_watchpoint(CPU *cpu, uint32_t address) {
+    for (int i = 0; i < cpu->watch_count; i++) {
+        if (cpu->watchpoints[i].address == address) {
+            cpu->watchpoints[i] = cpu->watchpoints[--cpu->watch_count];
+
+            // Lines may be shared between watchpoints, so rebuild the bitmap
+            memset(cpu->watch_lines, 0, sizeof(cpu->watch_lines));
+            for (int j = 0; j < cpu->watch_count; j++) {
+                mark_watch_lines(cpu, cpu->watchpoints[j].address);
+            }
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void check_watchpoints(CPU *cpu, uint32_t address, uint32_t length, uint8_t kind) {
+    for (int i = 0; i < cpu->watch_count; i++) {
+        Watchpoint *watch = &cpu->watchpoints[i];
+        if (address >= watch->address + sizeof(uint32_t) || address + length <= watch->address) {
+            continue; // Same line, different word
+        }
+
+        uint8_t fired = 0;
+        uint32_t old_value = watch->last_value;
+        if (kind == WATCH_READ) {
+            fired = watch->kinds & WATCH_READ;
+        } else {
+            uint32_t new_value = read_memory(cpu->memory, watch->address);
+            if (watch->kinds & WATCH_WRITE) {
+                fired = WATCH_WRITE;
+            } else if ((watch->kinds & WATCH_CHANGE) && new_value != old_value) {
+                fired = WATCH_CHANGE;
+            }
+            watch->last_value = new_value;
+        }
+
+        if (fired) {
+            cpu->events |= EVENT_WATCH_HIT;
+            cpu->watch_hit = i;
+            cpu->watch_hit_kind = fired;
+            cpu->watch_hit_old = old_value;
+        }
+    }
+}
+
+static const char *watch_kind_name(uint8_t kind) {
+    switch (kind) {
+        case WATCH_READ: return "read";
+        case WATCH_WRITE: return "write";
+        case WATCH_CHANGE: return "change";
+        default: return "access";
+    }
+}
+
+static uint8_t parse_watch_kinds(const char *text) {
+    uint8_t kinds = 0;
+    for (; *text; text++) {
+        if (*text == 'r') kinds |= WATCH_READ;
+        else if (*text == 'w') kinds |= WATCH_WRITE;
+        else if (*text == 'c') kinds |= WATCH_CHANGE;
+        else return 0;
+    }
+    return kinds;
+}
+
+static void report_stop(CPU *cpu, StopReason reason) {
+    switch (reason) {
+        case STOP_BREAKPOINT:
+            printf("Breakpoint at PC: %08X\n", cpu->pc);
+            break;
+        case STOP_WATCHPOINT: {
+            const Watchpoint *watch = &cpu->watchpoints[cpu->watch_hit];
+            printf("Watchpoint on 0x%08X (%s): %08X -> %08X, next PC: %08X\n",
+                   watch->address, watch_kind_name(cpu->watch_hit_kind),
+                   cpu->watch_hit_old, read_memory(cpu->memory, watch->address), cpu->pc);
+            break;
+        }
+        case STOP_HALTED:
+            printf("Program halted at PC: %08X\n", cpu->pc);
+            break;
+        case STOP_STEP_LIMIT:
+            break;
+    }
+}
+
+static void list_debug_points(const CPU *cpu) {
+    printf("Breakpoints:");
+    for (int index = 0; index < CODE_WORDS; index++) {
+        if (cpu->breakpoints[index / 64] & (1ull << (index % 64))) {
+            printf(" %08X", CODE_START + index * 4);
+        }
+    }
+    printf("\nWatchpoints:");
+    for (int i = 0; i < cpu->watch_count; i++) {
+        const Watchpoint *watch = &cpu->watchpoints[i];
+        printf(" %08X[%s%s%s]", watch->address,
+               (watch->kinds & WATCH_READ) ? "r" : "",
+               (watch->kinds & WATCH_WRITE) ? "w" : "",
+               (watch->kinds & WATCH_CHANGE) ? "c" : "");
+    }
+    printf("\n");
+}
+
+static void print_debugger_help(void) {
+    printf("Commands:\n");
+    printf("  break <addr|symbol>  Set a breakpoint (b)\n");
+    printf("  delete <addr>        Remove a breakpoint\n");
+    printf("  watch <addr> [rwc]   Watch a word for reads/writes/changes (default: w)\n");
+    printf("  unwatch <addr>       Remove a watchpoint\n");
+    printf("  list                 List breakpoints and watchpoints\n");
+    printf("  step [n]             Execute n instructions, showing changes (s)\n");
+    printf("  continue             Run until a breakpoint, watchpoint or HALT (c)\n");
+    printf("  regs                 Show registers (r)\n");
+    printf("  changes              Show registers and memory lines changed since last display\n");
+    printf("  dump                 Show every memory segment\n");
+    printf("  quit                 Leave the debugger (q)\n");
+}
+
+int debug_program(CPU *cpu) {
+    char line[128];
+    clear_dirty_state(cpu);
+    printf("Debugger ready at PC: %08X (type 'help' for commands)\n", cpu->pc);
+
+    while (printf("(dbg) "), fflush(stdout), fgets(line, sizeof(line), stdin)) {
+        char command[16] = "", arg1[32] = "", arg2[16] = "";
+        if (sscanf(line, "%15s %31s %15s", command, arg1, arg2) < 1) {
+            continue;
+        }
+        uint32_t address;
+        if (symbol_address(cpu, arg1, &address) != 0) {
+            address = (uint32_t)strtoul(arg1, NULL, 0); // Not a symbol: a numeric address
+        }
+
+        if (strcmp(command, "break") == 0 || strcmp(command, "b") == 0) {
+            if (add_breakpoint(cpu, address) != 0) {
+                fprintf(stderr, "Error: 0x%08X is not a code word.\n", address);
+            }
+        } else if (strcmp(command, "delete") == 0) {
+            if (remove_breakpoint(cpu, address) != 0) {
+                fprintf(stderr, "Error: No breakpoint at 0x%08X.\n", address);
+            }
+        } else if (strcmp(command, "watch") == 0) {
+            uint8_t kinds = arg2[0] ? parse_watch_kinds(arg2) : WATCH_WRITE;
+            if (add_watchpoint(cpu, address, kinds) != 0) {
+                fprintf(stderr, "Error: Cannot watch 0x%08X.\n", address);
+            }
+        } else if (strcmp(command, "unwatch") == 0) {
+            if (remove_watchpoint(cpu, address) != 0) {
+                fprintf(stderr, "Error: No watchpoint at 0x%08X.\n", address);
+            }
+        } else if (strcmp(command, "list") == 0) {
+            list_debug_points(cpu);
+        } else if (strcmp(command, "step") == 0 || strcmp(command, "s") == 0) {
+            uint64_t count = arg1[0] ? strtoull(arg1, NULL, 0) : 1;
+            cpu->trace_mode = TRACE_CHANGES;
+            report_stop(cpu, execute_cpu(cpu, count));
+        } else if (strcmp(command, "continue") == 0 || strcmp(command, "c") == 0) {
+            cpu->trace_mode = TRACE_NONE;
+            report_stop(cpu, execute_cpu(cpu, UINT64_MAX));
+        } else if (strcmp(command, "regs") == 0 || strcmp(command, "r") == 0) {
+            display_registers(cpu);
+        } else if (strcmp(command, "changes") == 0) {
+            display_changes(cpu);
+        } else if (strcmp(command, "dump") == 0) {
+            display_memory_segments(cpu);
+            display_registers(cpu);
+        } else if (strcmp(command, "quit") == 0 || strcmp(command, "q") == 0) {
+            break;
+        } else if (strcmp(command, "help") == 0) {
+            print_debugger_help();
+        } else {
+            fprintf(stderr, "Error: Unknown debugger command '%s'.\n", command);
+        }
+    }
+    return 0;
+}
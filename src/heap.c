@@ -0,0 +1,150 @@
+#include "cpu.h"
+#include "heap.h"
+#include <stdio.h>
+#include <string.h>
+
+_Static_assert((HEAP_END - HEAP_START) / HEAP_GRANULE == HEAP_MAX_BLOCKS,
+               "HEAP_MAX_BLOCKS must cover the heap segment");
+
+// Size of a block in the given class, in bytes
+static uint32_t class_bytes(int cls) {
+    return (uint32_t)HEAP_GRANULE << cls;
+}
+
+// Smallest class that can hold the request, or -1 if it is too large
+static int size_class(uint32_t size) {
+    if (size == 0) {
+        return -1;
+    }
+    for (int cls = 0; cls < HEAP_NUM_CLASSES; cls++) {
+        if (size <= class_bytes(cls)) {
+            return cls;
+        }
+    }
+    return -1;
+}
+
+static uint32_t granule_address(int granule) {
+    return HEAP_START + (uint32_t)granule * HEAP_GRANULE;
+}
+
+static void push_free(HeapAllocator *heap, int granule, int cls) {
+    heap->block_class[granule] = (uint8_t)cls;
+    heap->block_live[granule] = 0;
+    heap->next_free[granule] = heap->free_head[cls];
+    heap->free_head[cls] = (int16_t)granule;
+    heap->bytes_free_listed += class_bytes(cls);
+}
+
+static int pop_free(HeapAllocator *heap, int cls) {
+    int granule = heap->free_head[cls];
+    heap->free_head[cls] = heap->next_free[granule];
+    heap->next_free[granule] = -1;
+    heap->bytes_free_listed -= class_bytes(cls);
+    return granule;
+}
+
+void heap_init(HeapAllocator *heap) {
+    memset(heap, 0, sizeof(*heap));
+    for (int cls = 0; cls < HEAP_NUM_CLASSES; cls++) {
+        heap->free_head[cls] = -1;
+    }
+    for (int i = 0; i < HEAP_MAX_BLOCKS; i++) {
+        heap->next_free[i] = -1;
+        heap->block_class[i] = HEAP_NO_BLOCK;
+    }
+}
+
+uint32_t heap_alloc(HeapAllocator *heap, uint32_t *heap_pointer, uint32_t size) {
+    int cls = size_class(size);
+    if (cls < 0) {
+        heap->failed_allocs++;
+        return 0;
+    }
+
+    // Find the smallest non-empty free list that fits (bounded by HEAP_NUM_CLASSES)
+    int source = cls;
+    while (source < HEAP_NUM_CLASSES && heap->free_head[source] < 0) {
+        source++;
+    }
+
+    int granule;
+    if (source < HEAP_NUM_CLASSES) {
+        granule = pop_free(heap, source);
+        // Split oversized blocks, returning the upper halves to the smaller lists
+        while (source > cls) {
+            source--;
+            push_free(heap, granule + (int)(class_bytes(source) / HEAP_GRANULE), source);
+        }
+    } else {
+        // Nothing reusable: take fresh space from the top of the heap
+        if (*heap_pointer + class_bytes(cls) > HEAP_END) {
+            heap->failed_allocs++;
+            return 0;
+        }
+        granule = (int)((*heap_pointer - HEAP_START) / HEAP_GRANULE);
+        *heap_pointer += class_bytes(cls);
+    }
+
+    heap->block_class[granule] = (uint8_t)cls;
+    heap->block_live[granule] = 1;
+    heap->block_request[granule] = (uint16_t)size;
+
+    heap->bytes_requested += size;
+    heap->bytes_allocated += class_bytes(cls);
+    if (heap->bytes_allocated > heap->peak_allocated) {
+        heap->peak_allocated = heap->bytes_allocated;
+    }
+    heap->alloc_count++;
+    return granule_address(granule);
+}
+
+int heap_free(HeapAllocator *heap, uint32_t address) {
+    if (address < HEAP_START || address >= HEAP_END || (address - HEAP_START) % HEAP_GRANULE != 0) {
+        return -1;
+    }
+    int granule = (int)((address - HEAP_START) / HEAP_GRANULE);
+    if (heap->block_class[granule] == HEAP_NO_BLOCK || !heap->block_live[granule]) {
+        return -1; // Not a block start, or a double free
+    }
+
+    int cls = heap->block_class[granule];
+    heap->bytes_requested -= heap->block_request[granule];
+    heap->bytes_allocated -= class_bytes(cls);
+    heap->block_request[granule] = 0;
+    push_free(heap, granule, cls);
+    heap->free_count++;
+    return 0;
+}
+
+void heap_report_stats(const HeapAllocator *heap, uint32_t heap_pointer) {
+    uint32_t untouched = HEAP_END - heap_pointer;
+    uint32_t total_free = heap->bytes_free_listed + untouched;
+
+    // Largest block a single ALLOC could still be served from
+    uint32_t largest_free = untouched;
+    for (int cls = HEAP_NUM_CLASSES - 1; cls >= 0; cls--) {
+        if (heap->free_head[cls] >= 0) {
+            if (class_bytes(cls) > largest_free) {
+                largest_free = class_bytes(cls);
+            }
+            break;
+        }
+    }
+
+    unsigned internal_pct = heap->bytes_allocated
+        ? (unsigned)(100 * (heap->bytes_allocated - heap->bytes_requested) / heap->bytes_allocated)
+        : 0;
+    unsigned external_pct = total_free
+        ? (unsigned)(100 * (total_free - largest_free) / total_free)
+        : 0;
+
+    printf("\nHeap Statistics:\n");
+    printf("  Allocs: %u  Frees: %u  Failed: %u\n",
+           heap->alloc_count, heap->free_count, heap->failed_allocs);
+    printf("  In use: %u bytes (%u requested)  Peak: %u bytes\n",
+           heap->bytes_allocated, heap->bytes_requested, heap->peak_allocated);
+    printf("  Free: %u bytes (%u in free lists, largest block %u)\n",
+           total_free, heap->bytes_free_listed, largest_free);
+    printf("  Fragmentation: internal %u%%, external %u%%\n", internal_pct, external_pct);
+}
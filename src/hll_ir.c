@@ -0,0 +1,953 @@
+#include "hll_ir.h"
+#include "cpu.h" // NUM_REGISTERS, opcode descriptors
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#define SCRATCH_REGISTER (NUM_REGISTERS - 1) // Stages spilled values
+#define SPILL_COST_SHIFT 3                   // Cost factor 8 per enclosing loop
+#define SPILL_COST_MAX_DEPTH 8               // Deeper loops cost the same
+#define IN_MEMORY (-1)
+
+static void *grow(void *array, size_t *capacity, size_t count, size_t size) {
+    if (count < *capacity) {
+        return array;
+    }
+    *capacity = *capacity ? *capacity * 2 : 256;
+    array = realloc(array, *capacity * size);
+    if (!array) {
+        fprintf(stderr, "Error: Out of memory in the HLL translator.\n");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+static void *allocate(size_t count, size_t size) {
+    void *array = calloc(count ? count : 1, size);
+    if (!array) {
+        fprintf(stderr, "Error: Out of memory in the HLL translator.\n");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+void ir_init(IrProgram *program) {
+    memset(program, 0, sizeof(*program));
+}
+
+void ir_free(IrProgram *program) {
+    free(program->code);
+    free(program->values);
+    free(program->labels);
+    free(program->functions);
+    memset(program, 0, sizeof(*program));
+}
+
+uint32_t ir_value(IrProgram *program, const char *name) {
+    program->values = grow(program->values, &program->value_capacity, program->value_count, sizeof(IrValue));
+    snprintf(program->values[program->value_count].name, LABEL_NAME_MAX, "%s", name);
+    return (uint32_t)program->value_count++;
+}
+
+uint32_t ir_label(IrProgram *program, const char *prefix, unsigned number) {
+    program->labels = grow(program->labels, &program->label_capacity, program->label_count, sizeof(IrLabel));
+    program->labels[program->label_count].prefix = prefix;
+    program->labels[program->label_count].number = number;
+    return (uint32_t)program->label_count++;
+}
+
+uint32_t ir_function(IrProgram *program, const char *name) {
+    program->functions = grow(program->functions, &program->function_capacity, program->function_count,
+                              sizeof(IrFunction));
+    uint32_t number = (uint32_t)program->function_count++;
+    IrFunction *function = &program->functions[number];
+    memset(function, 0, sizeof(*function));
+    snprintf(function->name, LABEL_NAME_MAX, "%s", name);
+    function->label = ir_label(program, NULL, number);
+    return number;
+}
+
+uint32_t ir_function_of_label(const IrProgram *program, uint32_t label) {
+    return program->labels[label].prefix ? IR_NONE : program->labels[label].number;
+}
+
+void ir_emit(IrProgram *program, const IrInstruction *instruction) {
+    program->code = grow(program->code, &program->capacity, program->count, sizeof(IrInstruction));
+    program->code[program->count++] = *instruction;
+}
+
+int ir_writes_dst(IrKind kind) {
+    return kind == IR_SET || kind == IR_UNARY || kind == IR_BINARY || kind == IR_DJNZ || kind == IR_CALL;
+}
+
+int ir_uses(const IrInstruction *instruction, uint32_t uses[2]) {
+    int count = 0;
+    switch (instruction->kind) {
+        case IR_BINARY:
+        case IR_BRANCH:
+            if (!instruction->b.constant) {
+                uses[count++] = instruction->b.value;
+            }
+            // fall through
+        case IR_SET:
+        case IR_UNARY:
+        case IR_OUT:
+        case IR_ARG:
+        case IR_RET:
+            if (!instruction->a.constant) {
+                uses[count++] = instruction->a.value;
+            }
+            break;
+        case IR_DJNZ:
+            uses[count++] = instruction->dst;
+            break;
+        default:
+            break;
+    }
+    return count;
+}
+
+int ir_ends_block(IrKind kind) {
+    return kind == IR_BRANCH || kind == IR_JUMP || kind == IR_DJNZ || kind == IR_HALT || kind == IR_RET;
+}
+
+// ---------------------------------------------------------------- Liveness
+
+typedef struct {
+    size_t first;           // First instruction
+    size_t last;            // Last instruction
+    uint32_t successors[2]; // Blocks control can pass to, or IR_NONE
+} Block;
+
+typedef struct {
+    char *text;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+typedef struct {
+    const IrProgram *program;
+    Block *blocks;
+    size_t block_count;
+    uint32_t *global;          // Per value: index among values live across blocks, or IR_NONE
+    uint32_t *global_values;   // Value of each global index
+    uint32_t global_count;
+    size_t words;              // Bitset words per block
+    uint64_t *use;             // Globals read in a block before any write
+    uint64_t *def;             // Globals written in a block
+    uint64_t *live_in;
+    uint64_t *live_out;
+    uint32_t *start;           // Live interval per value, in half positions:
+    uint32_t *end;             // instruction p reads at 2p and writes at 2p + 1
+    uint64_t *cost;            // Spill cost
+    int *location;             // Register, or IN_MEMORY
+    uint32_t *slot;            // Spill word of a spilled intermediate
+    uint32_t spill_words;
+    uint32_t *entry_block;     // Per function: the block its entry label starts
+    size_t home_words;         // Bitset words per function
+    uint64_t *clobbers;        // Per function: homes it or its callees may write
+    uint32_t *saved;           // Values pushed around the call being written
+    Buffer out;
+    IrStats *stats;
+} Allocator;
+
+static int test_bit(const uint64_t *set, uint32_t bit) {
+    return (set[bit / 64] >> (bit % 64)) & 1;
+}
+
+static void set_bit(uint64_t *set, uint32_t bit) {
+    set[bit / 64] |= 1ull << (bit % 64);
+}
+
+static void build_blocks(Allocator *a) {
+    const IrProgram *program = a->program;
+    uint32_t *block_of_label = allocate(program->label_count, sizeof(uint32_t));
+    a->blocks = allocate(program->count, sizeof(Block));
+    a->entry_block = allocate(program->function_count, sizeof(uint32_t));
+    for (size_t f = 0; f < program->function_count; f++) {
+        a->entry_block[f] = IR_NONE; // Until its entry label turns up; unused functions may have lost it
+    }
+    for (size_t i = 0; i < program->count; i++) {
+        const IrInstruction *instruction = &program->code[i];
+        if (i == 0 || instruction->kind == IR_LABEL || ir_ends_block(program->code[i - 1].kind)) {
+            a->blocks[a->block_count++].first = i;
+        }
+        a->blocks[a->block_count - 1].last = i;
+        if (instruction->kind == IR_LABEL) {
+            block_of_label[instruction->label] = (uint32_t)(a->block_count - 1);
+            uint32_t function = ir_function_of_label(program, instruction->label);
+            if (function != IR_NONE) {
+                a->entry_block[function] = (uint32_t)(a->block_count - 1);
+            }
+        }
+    }
+    for (size_t b = 0; b < a->block_count; b++) {
+        const IrInstruction *last = &program->code[a->blocks[b].last];
+        uint32_t next = b + 1 < a->block_count ? (uint32_t)(b + 1) : IR_NONE;
+        a->blocks[b].successors[0] = last->kind == IR_JUMP ? block_of_label[last->label]
+                                   : (last->kind == IR_HALT || last->kind == IR_RET) ? IR_NONE : next;
+        a->blocks[b].successors[1] = (last->kind == IR_BRANCH || last->kind == IR_DJNZ)
+                                   ? block_of_label[last->label] : IR_NONE;
+    }
+    free(block_of_label);
+}
+
+// Variables, and intermediates that are read in another block than the one
+// that wrote them, take part in the dataflow; other values live and die
+// inside one block
+static void find_globals(Allocator *a) {
+    const IrProgram *program = a->program;
+    uint32_t *home = allocate(program->value_count, sizeof(uint32_t));
+    a->global = allocate(program->value_count, sizeof(uint32_t));
+    for (size_t v = 0; v < program->value_count; v++) {
+        home[v] = IR_NONE;
+        a->global[v] = program->values[v].name[0] ? 0 : IR_NONE;
+    }
+    for (size_t b = 0; b < a->block_count; b++) {
+        for (size_t i = a->blocks[b].first; i <= a->blocks[b].last; i++) {
+            const IrInstruction *instruction = &program->code[i];
+            uint32_t uses[2];
+            int count = ir_uses(instruction, uses);
+            for (int k = 0; k < count; k++) {
+                if (home[uses[k]] != b) {
+                    a->global[uses[k]] = 0; // Read before it is written here
+                }
+            }
+            if (ir_writes_dst(instruction->kind)) {
+                if (home[instruction->dst] != IR_NONE && home[instruction->dst] != b) {
+                    a->global[instruction->dst] = 0;
+                }
+                home[instruction->dst] = (uint32_t)b;
+            }
+        }
+    }
+    a->global_values = allocate(program->value_count, sizeof(uint32_t));
+    for (size_t v = 0; v < program->value_count; v++) {
+        if (a->global[v] == 0) {
+            a->global_values[a->global_count] = (uint32_t)v;
+            a->global[v] = a->global_count++;
+        }
+    }
+    free(home);
+}
+
+static void compute_liveness(Allocator *a) {
+    const IrProgram *program = a->program;
+    size_t words = a->words = (a->global_count + 63) / 64;
+    size_t total = a->block_count * words;
+    a->use = allocate(total, sizeof(uint64_t));
+    a->def = allocate(total, sizeof(uint64_t));
+    a->live_in = allocate(total, sizeof(uint64_t));
+    a->live_out = allocate(total, sizeof(uint64_t));
+
+    for (size_t b = 0; b < a->block_count; b++) {
+        uint64_t *use = a->use + b * words, *def = a->def + b * words;
+        for (size_t i = a->blocks[b].first; i <= a->blocks[b].last; i++) {
+            const IrInstruction *instruction = &program->code[i];
+            uint32_t uses[2];
+            int count = ir_uses(instruction, uses);
+            for (int k = 0; k < count; k++) {
+                uint32_t g = a->global[uses[k]];
+                if (g != IR_NONE && !test_bit(def, g)) {
+                    set_bit(use, g);
+                }
+            }
+            if (ir_writes_dst(instruction->kind) && a->global[instruction->dst] != IR_NONE) {
+                set_bit(def, a->global[instruction->dst]);
+            }
+        }
+    }
+
+    // out(b) = union of in(successors); in(b) = use(b) | (out(b) & ~def(b)).
+    // Visiting blocks backwards settles straight-line code in one pass.
+    int changed;
+    do {
+        changed = 0;
+        for (size_t b = a->block_count; b-- > 0; ) {
+            uint64_t *out = a->live_out + b * words, *in = a->live_in + b * words;
+            for (int s = 0; s < 2; s++) {
+                uint32_t successor = a->blocks[b].successors[s];
+                if (successor != IR_NONE) {
+                    const uint64_t *from = a->live_in + successor * words;
+                    for (size_t w = 0; w < words; w++) {
+                        out[w] |= from[w];
+                    }
+                }
+            }
+            const uint64_t *use = a->use + b * words, *def = a->def + b * words;
+            for (size_t w = 0; w < words; w++) {
+                uint64_t value = use[w] | (out[w] & ~def[w]);
+                if (value != in[w]) {
+                    in[w] = value;
+                    changed = 1;
+                }
+            }
+        }
+    } while (changed);
+}
+
+// ---------------------------------------------------------------- Linear scan
+
+static void extend(Allocator *a, uint32_t value, uint32_t position) {
+    if (position < a->start[value]) {
+        a->start[value] = position;
+    }
+    if (position > a->end[value]) {
+        a->end[value] = position;
+    }
+}
+
+static void build_intervals(Allocator *a) {
+    const IrProgram *program = a->program;
+    a->start = allocate(program->value_count, sizeof(uint32_t));
+    a->end = allocate(program->value_count, sizeof(uint32_t));
+    a->cost = allocate(program->value_count, sizeof(uint64_t));
+    for (size_t v = 0; v < program->value_count; v++) {
+        a->start[v] = UINT32_MAX;
+    }
+    for (size_t i = 0; i < program->count; i++) {
+        const IrInstruction *instruction = &program->code[i];
+        unsigned depth = instruction->loop_depth < SPILL_COST_MAX_DEPTH ? instruction->loop_depth : SPILL_COST_MAX_DEPTH;
+        uint64_t weight = 1ull << (SPILL_COST_SHIFT * depth);
+        uint32_t uses[2];
+        int count = ir_uses(instruction, uses);
+        for (int k = 0; k < count; k++) {
+            extend(a, uses[k], (uint32_t)(2 * i));
+            a->cost[uses[k]] += weight;
+        }
+        if (ir_writes_dst(instruction->kind)) {
+            extend(a, instruction->dst, (uint32_t)(2 * i + 1));
+            a->cost[instruction->dst] += weight;
+        }
+    }
+    // A global live into a block is live from its first position, and one
+    // live out of it until after its last
+    for (size_t b = 0; b < a->block_count; b++) {
+        const uint64_t *in = a->live_in + b * a->words, *out = a->live_out + b * a->words;
+        for (uint32_t g = 0; g < a->global_count; g++) {
+            if (test_bit(in, g)) {
+                extend(a, a->global_values[g], (uint32_t)(2 * a->blocks[b].first));
+            }
+            if (test_bit(out, g)) {
+                extend(a, a->global_values[g], (uint32_t)(2 * a->blocks[b].last + 1));
+            }
+        }
+    }
+}
+
+static const Allocator *sort_allocator;
+
+static int compare_start(const void *x, const void *y) {
+    uint32_t a = *(const uint32_t *)x, b = *(const uint32_t *)y;
+    if (sort_allocator->start[a] != sort_allocator->start[b]) {
+        return sort_allocator->start[a] < sort_allocator->start[b] ? -1 : 1;
+    }
+    return (a > b) - (a < b);
+}
+
+// Cheaper to keep in memory: lower cost for each position it holds a
+// register, so a variable live across the whole program goes before the
+// short intermediates computed while it waits
+static int cheaper(const Allocator *a, uint32_t x, uint32_t y) {
+    double density_x = (double)a->cost[x] / (a->end[x] - a->start[x] + 1);
+    double density_y = (double)a->cost[y] / (a->end[y] - a->start[y] + 1);
+    return density_x < density_y || (density_x == density_y && a->end[x] > a->end[y]);
+}
+
+// Spill words in use, ordered by the end of their value's interval
+typedef struct {
+    uint32_t *end;
+    uint32_t *slot;
+    size_t count;
+} SlotHeap;
+
+static void heap_push(SlotHeap *heap, uint32_t end, uint32_t slot) {
+    size_t i = heap->count++;
+    while (i > 0 && heap->end[(i - 1) / 2] > end) {
+        heap->end[i] = heap->end[(i - 1) / 2];
+        heap->slot[i] = heap->slot[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->end[i] = end;
+    heap->slot[i] = slot;
+}
+
+static uint32_t heap_pop(SlotHeap *heap) {
+    uint32_t top = heap->slot[0];
+    uint32_t end = heap->end[--heap->count], slot = heap->slot[heap->count];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= heap->count) {
+            break;
+        }
+        if (child + 1 < heap->count && heap->end[child + 1] < heap->end[child]) {
+            child++;
+        }
+        if (heap->end[child] >= end) {
+            break;
+        }
+        heap->end[i] = heap->end[child];
+        heap->slot[i] = heap->slot[child];
+        i = child;
+    }
+    heap->end[i] = end;
+    heap->slot[i] = slot;
+    return top;
+}
+
+static void linear_scan(Allocator *a) {
+    const IrProgram *program = a->program;
+    uint32_t *order = allocate(program->value_count, sizeof(uint32_t));
+    size_t count = 0;
+    a->location = allocate(program->value_count, sizeof(int));
+    for (size_t v = 0; v < program->value_count; v++) {
+        a->location[v] = IN_MEMORY;
+        if (a->start[v] != UINT32_MAX) {
+            order[count++] = (uint32_t)v;
+        }
+    }
+    sort_allocator = a;
+    qsort(order, count, sizeof(uint32_t), compare_start);
+
+    uint32_t active[NUM_REGISTERS];
+    int active_count = 0;
+    int in_use[NUM_REGISTERS] = {0};
+    for (size_t k = 0; k < count; k++) {
+        uint32_t value = order[k];
+        // Registers of intervals that ended before this one starts are free again
+        for (int i = 0; i < active_count; ) {
+            if (a->end[active[i]] < a->start[value]) {
+                in_use[a->location[active[i]]] = 0;
+                active[i] = active[--active_count];
+            } else {
+                i++;
+            }
+        }
+        int reg = 0;
+        while (reg < SCRATCH_REGISTER && in_use[reg]) {
+            reg++;
+        }
+        if (reg < SCRATCH_REGISTER) {
+            a->location[value] = reg;
+            in_use[reg] = 1;
+            active[active_count++] = value;
+            continue;
+        }
+        // No register is free: the cheapest overlapping interval goes to memory
+        int victim = -1;
+        for (int i = 0; i < active_count; i++) {
+            if (cheaper(a, active[i], victim < 0 ? value : active[victim])) {
+                victim = i;
+            }
+        }
+        if (victim >= 0) {
+            a->location[value] = a->location[active[victim]];
+            a->location[active[victim]] = IN_MEMORY;
+            active[victim] = value;
+        }
+    }
+
+    a->stats->values = (uint32_t)count;
+    // Spilled intermediates share spill words once their intervals are over
+    SlotHeap busy = {allocate(count, sizeof(uint32_t)), allocate(count, sizeof(uint32_t)), 0};
+    uint32_t *free_slots = allocate(count, sizeof(uint32_t));
+    size_t free_count = 0;
+    a->slot = allocate(program->value_count, sizeof(uint32_t));
+    for (size_t k = 0; k < count; k++) {
+        uint32_t value = order[k];
+        if (a->location[value] != IN_MEMORY) {
+            continue;
+        }
+        a->stats->spilled++;
+        if (program->values[value].name[0]) {
+            continue;
+        }
+        while (busy.count > 0 && busy.end[0] < a->start[value]) {
+            free_slots[free_count++] = heap_pop(&busy);
+        }
+        a->slot[value] = free_count > 0 ? free_slots[--free_count] : a->spill_words++;
+        heap_push(&busy, a->end[value], a->slot[value]);
+    }
+    free(busy.end);
+    free(busy.slot);
+    free(free_slots);
+    free(order);
+}
+
+// ---------------------------------------------------------------- Calls
+
+// A value's home as one number: its register, or past the registers its data
+// word (a variable's own, by value number, or a spill word)
+static uint32_t home_of(const Allocator *a, uint32_t value) {
+    if (a->location[value] != IN_MEMORY) {
+        return (uint32_t)a->location[value];
+    }
+    const IrProgram *program = a->program;
+    return NUM_REGISTERS + (program->values[value].name[0] ? value : (uint32_t)program->value_count + a->slot[value]);
+}
+
+// Whether a function may read a value before writing it: its parameters
+// that receive arguments, and the locals it zeroes
+static int live_on_entry(const Allocator *a, uint32_t function, uint32_t value) {
+    uint32_t g = a->global[value];
+    return a->entry_block[function] != IR_NONE && g != IR_NONE &&
+           test_bit(a->live_in + a->entry_block[function] * a->words, g);
+}
+
+// Homes each function may write, itself or through the functions it calls.
+// The code from a function's entry label to the next one is its own, and
+// the values live on entry count as written: the caller or the function
+// itself sets them there.
+static void find_clobbers(Allocator *a) {
+    const IrProgram *program = a->program;
+    size_t words = a->home_words = (NUM_REGISTERS + program->value_count + a->spill_words + 63) / 64;
+    a->clobbers = allocate(program->function_count * words, sizeof(uint64_t));
+    a->saved = allocate(program->value_count, sizeof(uint32_t));
+    if (program->function_count == 0) {
+        return;
+    }
+    uint32_t *callers = allocate(program->count, sizeof(uint32_t));
+    uint32_t *callees = allocate(program->count, sizeof(uint32_t));
+    size_t calls = 0;
+    uint32_t function = IR_NONE; // The main program
+    for (size_t i = 0; i < program->count; i++) {
+        const IrInstruction *instruction = &program->code[i];
+        if (instruction->kind == IR_LABEL && ir_function_of_label(program, instruction->label) != IR_NONE) {
+            function = ir_function_of_label(program, instruction->label);
+        }
+        if (function == IR_NONE) {
+            continue;
+        }
+        if (ir_writes_dst(instruction->kind)) {
+            set_bit(a->clobbers + function * words, home_of(a, instruction->dst));
+        }
+        if (instruction->kind == IR_CALL) {
+            callers[calls] = function;
+            callees[calls++] = ir_function_of_label(program, instruction->label);
+        }
+    }
+    for (uint32_t f = 0; f < program->function_count; f++) {
+        for (uint32_t g = 0; g < a->global_count; g++) {
+            if (live_on_entry(a, f, a->global_values[g])) {
+                set_bit(a->clobbers + f * words, home_of(a, a->global_values[g]));
+            }
+        }
+    }
+    int changed;
+    do {
+        changed = 0;
+        for (size_t c = 0; c < calls; c++) {
+            uint64_t *to = a->clobbers + callers[c] * words;
+            const uint64_t *from = a->clobbers + callees[c] * words;
+            for (size_t w = 0; w < words; w++) {
+                if ((from[w] & ~to[w]) != 0) {
+                    to[w] |= from[w];
+                    changed = 1;
+                }
+            }
+        }
+    } while (changed);
+    free(callers);
+    free(callees);
+}
+
+// ---------------------------------------------------------------- Assembly output
+
+static void append(Buffer *buffer, const char *format, ...) {
+    for (;;) {
+        size_t room = buffer->capacity - buffer->size;
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer->text + buffer->size, room, format, args);
+        va_end(args);
+        if ((size_t)length < room) {
+            buffer->size += (size_t)length;
+            return;
+        }
+        buffer->capacity = buffer->capacity * 2 + (size_t)length;
+        buffer->text = realloc(buffer->text, buffer->capacity);
+        if (!buffer->text) {
+            fprintf(stderr, "Error: Out of memory in the HLL translator.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+#define emit(a, ...) ((a)->stats->instructions++, append(&(a)->out, __VA_ARGS__))
+
+// Register, constant or memory word, as assembler text
+typedef struct {
+    char text[LABEL_NAME_MAX + 4];
+    int reg;  // Register holding the value, or IN_MEMORY
+    int wide; // Takes the instruction's one literal word
+} Operand;
+
+// Data word of a spilled value: the variable's own, or a spill word
+static void memory_name(const Allocator *a, uint32_t value, char *text, size_t size) {
+    if (a->program->values[value].name[0]) {
+        snprintf(text, size, "%s", a->program->values[value].name);
+    } else {
+        snprintf(text, size, "_spill%u", a->slot[value]);
+    }
+}
+
+static void memory_operand(const Allocator *a, uint32_t value, char *text, size_t size) {
+    char name[LABEL_NAME_MAX];
+    memory_name(a, value, name, sizeof(name));
+    snprintf(text, size, "[%s]", name);
+}
+
+static void make_operand(const Allocator *a, IrOperand source, Operand *operand) {
+    if (source.constant) {
+        snprintf(operand->text, sizeof(operand->text), "#%d", (int32_t)source.value);
+        operand->reg = IN_MEMORY;
+        operand->wide = source.value > OPERAND_MAX; // Negative numbers too
+    } else if (a->location[source.value] != IN_MEMORY) {
+        operand->reg = a->location[source.value];
+        snprintf(operand->text, sizeof(operand->text), "R%d", operand->reg);
+        operand->wide = 0;
+    } else {
+        memory_operand(a, source.value, operand->text, sizeof(operand->text));
+        operand->reg = IN_MEMORY;
+        operand->wide = 1; // Data addresses start above the 8-bit range
+    }
+}
+
+// Bring an operand into the scratch register
+static void stage(Allocator *a, Operand *operand) {
+    emit(a, "LOAD R%d, %s\n", SCRATCH_REGISTER, operand->text);
+    operand->reg = SCRATCH_REGISTER;
+    snprintf(operand->text, sizeof(operand->text), "R%d", SCRATCH_REGISTER);
+    operand->wide = 0;
+}
+
+// Comparison computing the condition of a branch
+static Opcode compare_opcode(Opcode branch) {
+    switch (branch) {
+        case BEQ: return EQ;
+        case BNE: return NEQ;
+        case BLT: return LT;
+        case BGE: return GE;
+        case BGT: return GT;
+        default:  return LE;
+    }
+}
+
+static void write_label(Allocator *a, uint32_t label, char *text) {
+    const IrLabel *entry = &a->program->labels[label];
+    if (!entry->prefix) {
+        snprintf(text, LABEL_NAME_MAX, "%s", a->program->functions[entry->number].name);
+    } else {
+        snprintf(text, LABEL_NAME_MAX, "%s_%u", entry->prefix, entry->number);
+    }
+}
+
+// dst = source
+static void write_copy(Allocator *a, uint32_t dst, IrOperand source) {
+    Operand x;
+    make_operand(a, source, &x);
+    if (a->location[dst] != IN_MEMORY) {
+        if (x.reg != a->location[dst]) {
+            emit(a, "LOAD R%d, %s\n", a->location[dst], x.text);
+        }
+    } else {
+        char memory[LABEL_NAME_MAX + 4];
+        memory_operand(a, dst, memory, sizeof(memory));
+        if (x.reg == IN_MEMORY) {
+            stage(a, &x);
+        }
+        emit(a, "STORE %s, %s\n", x.text, memory);
+    }
+}
+
+static void push_operand(Allocator *a, IrOperand source) {
+    Operand x;
+    make_operand(a, source, &x);
+    emit(a, "PUSH %s\n", x.text);
+}
+
+static void pop_value(Allocator *a, uint32_t value) {
+    if (a->location[value] != IN_MEMORY) {
+        emit(a, "POP R%d\n", a->location[value]);
+    } else {
+        char memory[LABEL_NAME_MAX + 4];
+        memory_operand(a, value, memory, sizeof(memory));
+        emit(a, "POP R%d\n", SCRATCH_REGISTER);
+        emit(a, "STORE R%d, %s\n", SCRATCH_REGISTER, memory);
+    }
+}
+
+// Move arguments into parameters as one parallel assignment: a move is made
+// once no other pending move reads its destination, and moves left waiting
+// on each other go through the stack
+static void move_arguments(Allocator *a, const uint32_t *params, const IrOperand *arguments, int count) {
+    int done[IR_MAX_PARAMS] = {0};
+    int pending = count, progress = 1;
+    while (pending > 0 && progress) {
+        progress = 0;
+        for (int i = 0; i < count; i++) {
+            int blocked = 0;
+            for (int j = 0; j < count && !done[i] && !blocked; j++) {
+                blocked = j != i && !done[j] && !arguments[j].constant &&
+                          home_of(a, arguments[j].value) == home_of(a, params[i]);
+            }
+            if (!done[i] && !blocked) {
+                write_copy(a, params[i], arguments[i]);
+                done[i] = 1;
+                pending--;
+                progress = 1;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (!done[i]) {
+            push_operand(a, arguments[i]);
+        }
+    }
+    for (int i = count; i-- > 0; ) {
+        if (!done[i]) {
+            pop_value(a, params[i]);
+        }
+    }
+}
+
+// Save, pass the arguments, call, take the result, restore (see hll_ir.h)
+static void write_call(Allocator *a, size_t index) {
+    const IrProgram *program = a->program;
+    const IrInstruction *call = &program->code[index];
+    uint32_t callee = ir_function_of_label(program, call->label);
+    const IrFunction *function = &program->functions[callee];
+    const uint64_t *clobbers = a->clobbers + callee * a->home_words;
+    uint32_t position = (uint32_t)(2 * index);
+
+    uint32_t saved = 0;
+    for (uint32_t v = 0; v < program->value_count; v++) {
+        if (v != call->dst && a->start[v] <= position && a->end[v] > position + 1 &&
+            test_bit(clobbers, home_of(a, v))) {
+            IrOperand value = {v, 0};
+            push_operand(a, value);
+            a->saved[saved++] = v;
+        }
+    }
+
+    // The arguments are the IR_ARGs right before the call. Parameters the
+    // function writes before reading need none, and neither do arguments
+    // already at home.
+    uint32_t params[IR_MAX_PARAMS];
+    IrOperand arguments[IR_MAX_PARAMS];
+    int count = 0;
+    size_t first = index;
+    while (first > 0 && program->code[first - 1].kind == IR_ARG) {
+        first--;
+    }
+    for (size_t k = first; k < index; k++) {
+        uint32_t param = function->params[k - first];
+        IrOperand argument = program->code[k].a;
+        if (live_on_entry(a, callee, param) &&
+            (argument.constant || home_of(a, argument.value) != home_of(a, param))) {
+            params[count] = param;
+            arguments[count++] = argument;
+        }
+    }
+    move_arguments(a, params, arguments, count);
+
+    emit(a, "CALL %s\n", function->name);
+    if (a->end[call->dst] > position + 1) { // The result is read
+        if (a->location[call->dst] != IN_MEMORY) {
+            emit(a, "LOAD R%d, R%d\n", a->location[call->dst], SCRATCH_REGISTER);
+        } else {
+            char memory[LABEL_NAME_MAX + 4];
+            memory_operand(a, call->dst, memory, sizeof(memory));
+            emit(a, "STORE R%d, %s\n", SCRATCH_REGISTER, memory);
+        }
+    }
+    while (saved > 0) {
+        pop_value(a, a->saved[--saved]);
+    }
+}
+
+// Locals a function may read before writing them start at zero on every call
+static void zero_locals(Allocator *a, uint32_t function) {
+    const IrFunction *entry = &a->program->functions[function];
+    int staged = 0;
+    for (uint32_t g = 0; g < a->global_count; g++) {
+        uint32_t value = a->global_values[g];
+        int param = 0;
+        for (uint32_t p = 0; p < entry->param_count && !param; p++) {
+            param = entry->params[p] == value;
+        }
+        if (param || !live_on_entry(a, function, value)) {
+            continue;
+        }
+        if (a->location[value] != IN_MEMORY) {
+            emit(a, "LOAD R%d, #0\n", a->location[value]);
+        } else {
+            char memory[LABEL_NAME_MAX + 4];
+            memory_operand(a, value, memory, sizeof(memory));
+            if (!staged) {
+                emit(a, "LOAD R%d, #0\n", SCRATCH_REGISTER);
+                staged = 1;
+            }
+            emit(a, "STORE R%d, %s\n", SCRATCH_REGISTER, memory);
+        }
+    }
+}
+
+static void write_instruction(Allocator *a, size_t index) {
+    const IrInstruction *instruction = &a->program->code[index];
+    Operand x, y;
+    char label[LABEL_NAME_MAX], memory[LABEL_NAME_MAX + 4];
+    const char *mnemonic = opcode_table[instruction->op].mnemonic;
+    int dst = ir_writes_dst(instruction->kind) ? a->location[instruction->dst] : IN_MEMORY;
+    int target = dst != IN_MEMORY ? dst : SCRATCH_REGISTER;
+    if (ir_writes_dst(instruction->kind) && dst == IN_MEMORY) {
+        memory_operand(a, instruction->dst, memory, sizeof(memory));
+    }
+    if (instruction->kind == IR_LABEL || instruction->kind == IR_BRANCH ||
+        instruction->kind == IR_JUMP || instruction->kind == IR_DJNZ || instruction->kind == IR_CALL) {
+        write_label(a, instruction->label, label);
+    }
+
+    switch (instruction->kind) {
+        case IR_LABEL:
+            append(&a->out, "%s:\n", label);
+            if (ir_function_of_label(a->program, instruction->label) != IR_NONE) {
+                zero_locals(a, ir_function_of_label(a->program, instruction->label));
+            }
+            break;
+        case IR_SET:
+            write_copy(a, instruction->dst, instruction->a);
+            break;
+        case IR_UNARY:
+        case IR_BINARY:
+            make_operand(a, instruction->a, &x);
+            if (instruction->kind == IR_UNARY) {
+                emit(a, "%s R%d, %s\n", mnemonic, target, x.text);
+            } else if (instruction->op == SHL || instruction->op == SHR) {
+                emit(a, "%s R%d, %s, %u\n", mnemonic, target, x.text, instruction->b.value);
+            } else {
+                make_operand(a, instruction->b, &y);
+                if (x.wide && y.wide) {
+                    stage(a, &x);
+                }
+                emit(a, "%s R%d, %s, %s\n", mnemonic, target, x.text, y.text);
+            }
+            if (dst == IN_MEMORY) {
+                emit(a, "STORE R%d, %s\n", SCRATCH_REGISTER, memory);
+            }
+            break;
+        case IR_BRANCH:
+            // Once the code outgrows 8 bits a label takes the literal word
+            // itself, so the compared values must both be registers
+            make_operand(a, instruction->a, &x);
+            make_operand(a, instruction->b, &y);
+            if (x.wide && y.wide) {
+                stage(a, &x);
+                emit(a, "%s R%d, R%d, %s\n", opcode_table[compare_opcode(instruction->op)].mnemonic,
+                     SCRATCH_REGISTER, SCRATCH_REGISTER, y.text);
+                emit(a, "BNE R%d, #0, %s\n", SCRATCH_REGISTER, label);
+                break;
+            }
+            if (x.wide) {
+                stage(a, &x);
+            } else if (y.wide) {
+                stage(a, &y);
+            }
+            emit(a, "%s %s, %s, %s\n", mnemonic, x.text, y.text, label);
+            break;
+        case IR_JUMP:
+            emit(a, "JUMP %s\n", label);
+            break;
+        case IR_DJNZ:
+            if (dst != IN_MEMORY) {
+                emit(a, "DJNZ R%d, %s\n", dst, label);
+            } else {
+                emit(a, "LOAD R%d, %s\n", SCRATCH_REGISTER, memory);
+                emit(a, "SUB R%d, R%d, #1\n", SCRATCH_REGISTER, SCRATCH_REGISTER);
+                emit(a, "STORE R%d, %s\n", SCRATCH_REGISTER, memory);
+                emit(a, "BNE R%d, #0, %s\n", SCRATCH_REGISTER, label);
+            }
+            break;
+        case IR_OUT:
+            make_operand(a, instruction->a, &x);
+            if (x.reg == IN_MEMORY) {
+                stage(a, &x);
+            }
+            emit(a, "OUT %s\n", x.text);
+            break;
+        case IR_HALT:
+            emit(a, "HALT\n");
+            break;
+        case IR_ARG:
+            break; // Passed by the call
+        case IR_CALL:
+            write_call(a, index);
+            break;
+        case IR_RET:
+            make_operand(a, instruction->a, &x);
+            emit(a, "LOAD R%d, %s\n", SCRATCH_REGISTER, x.text);
+            emit(a, "RET\n");
+            break;
+    }
+}
+
+char *ir_generate(const IrProgram *program, size_t *size, IrStats *stats) {
+    Allocator a;
+    memset(&a, 0, sizeof(a));
+    memset(stats, 0, sizeof(*stats));
+    a.program = program;
+    a.stats = stats;
+    build_blocks(&a);
+    find_globals(&a);
+    compute_liveness(&a);
+    build_intervals(&a);
+    linear_scan(&a);
+    find_clobbers(&a);
+
+    a.out.capacity = 4096 + program->count * 16;
+    a.out.text = allocate(a.out.capacity, 1);
+    if (stats->spilled > 0) {
+        append(&a.out, ".data\n");
+        for (size_t v = 0; v < program->value_count; v++) {
+            if (a.location[v] == IN_MEMORY && a.start[v] != UINT32_MAX && program->values[v].name[0]) {
+                append(&a.out, "%s: .word 0\n", program->values[v].name);
+            }
+        }
+        for (uint32_t slot = 0; slot < a.spill_words; slot++) {
+            append(&a.out, "_spill%u: .word 0\n", slot);
+        }
+        append(&a.out, ".text\n");
+    }
+    // Variables read before they are written start at zero
+    if (a.block_count > 0) {
+        for (uint32_t g = 0; g < a.global_count; g++) {
+            uint32_t value = a.global_values[g];
+            if (test_bit(a.live_in, g) && a.location[value] != IN_MEMORY) {
+                emit(&a, "LOAD R%d, #0\n", a.location[value]);
+            }
+        }
+    }
+    for (size_t i = 0; i < program->count; i++) {
+        write_instruction(&a, i);
+    }
+
+    free(a.blocks);
+    free(a.global);
+    free(a.global_values);
+    free(a.use);
+    free(a.def);
+    free(a.live_in);
+    free(a.live_out);
+    free(a.start);
+    free(a.end);
+    free(a.cost);
+    free(a.location);
+    free(a.slot);
+    free(a.entry_block);
+    free(a.clobbers);
+    free(a.saved);
+    *size = a.out.size;
+    return a.out.text;
+}
@@ -0,0 +1,837 @@
+#include "hll_opt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_ROUNDS 8 // The passes repeat until nothing changes, at most this often
+
+static const struct {
+    const char *name;
+    IrPass pass;
+} pass_names[] = {
+    {"constants", IR_PASS_CONSTANTS},
+    {"strength",  IR_PASS_STRENGTH},
+    {"cse",       IR_PASS_CSE},
+    {"licm",      IR_PASS_LICM},
+    {"dce",       IR_PASS_DEAD_CODE},
+};
+
+unsigned ir_pass_named(const char *name) {
+    for (size_t i = 0; i < sizeof(pass_names) / sizeof(pass_names[0]); i++) {
+        if (strcmp(name, pass_names[i].name) == 0) {
+            return pass_names[i].pass;
+        }
+    }
+    return 0;
+}
+
+static void *allocate(size_t count, size_t size) {
+    void *array = calloc(count ? count : 1, size);
+    if (!array) {
+        fprintf(stderr, "Error: Out of memory in the HLL optimizer.\n");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+static const IrOperand no_operand = {0, 1};
+
+static IrOperand constant(uint32_t value) {
+    IrOperand operand = {value, 1};
+    return operand;
+}
+
+static int same_operand(IrOperand x, IrOperand y) {
+    return x.constant == y.constant && x.value == y.value;
+}
+
+static int targets_label(IrKind kind) {
+    return kind == IR_BRANCH || kind == IR_JUMP || kind == IR_DJNZ || kind == IR_CALL;
+}
+
+// Control does not fall through to the next instruction
+static int ends_flow(IrKind kind) {
+    return kind == IR_JUMP || kind == IR_HALT || kind == IR_RET;
+}
+
+static void make_set(IrInstruction *instruction, IrOperand value) {
+    instruction->kind = IR_SET;
+    instruction->op = LOAD;
+    instruction->a = value;
+    instruction->b = no_operand;
+}
+
+// A division that may be by zero stops the program, so it must stay in place
+static int may_fault(const IrInstruction *instruction) {
+    return instruction->kind == IR_BINARY && instruction->op == DIV &&
+           !(instruction->b.constant && instruction->b.value != 0);
+}
+
+// Instructions whose only effect is writing dst
+static int is_pure(const IrInstruction *instruction) {
+    return (instruction->kind == IR_SET || instruction->kind == IR_UNARY || instruction->kind == IR_BINARY) &&
+           !may_fault(instruction);
+}
+
+static uint32_t *count_references(const IrProgram *program) {
+    uint32_t *references = allocate(program->label_count, sizeof(uint32_t));
+    for (size_t i = 0; i < program->count; i++) {
+        if (targets_label(program->code[i].kind)) {
+            references[program->code[i].label]++;
+        }
+    }
+    return references;
+}
+
+// Whether facts known before instruction i still hold at it: only a label
+// that something jumps to lets control in from elsewhere
+static int starts_fresh(const IrProgram *program, const uint32_t *references, size_t i) {
+    const IrInstruction *instruction = &program->code[i];
+    return instruction->kind == IR_LABEL && references[instruction->label] > 0;
+}
+
+// Drop deleted instructions; returns how many there were
+static size_t compact(IrProgram *program) {
+    size_t kept = 0;
+    for (size_t i = 0; i < program->count; i++) {
+        if (program->code[i].kind != IR_NOP) {
+            program->code[kept++] = program->code[i];
+        }
+    }
+    size_t removed = program->count - kept;
+    program->count = kept;
+    return removed;
+}
+
+// ---------------------------------------------------------------- Constant folding and propagation
+
+// Result of an operation on constants; 0 if it must be left to run time
+static int evaluate(Opcode op, uint32_t a, uint32_t b, uint32_t *result) {
+    switch (op) {
+        case ADD: *result = a + b; return 1;
+        case SUB: *result = a - b; return 1;
+        case MUL: *result = a * b; return 1;
+        case DIV:
+            if (b == 0) {
+                return 0; // Leave the run-time error in place
+            }
+            *result = a / b;
+            return 1;
+        case AND: *result = a & b; return 1;
+        case OR:  *result = a | b; return 1;
+        case XOR: *result = a ^ b; return 1;
+        case NOT: *result = ~a; return 1;
+        case SHL: *result = a << b; return 1;
+        case SHR: *result = a >> b; return 1;
+        case EQ:  *result = a == b; return 1;
+        case NEQ: *result = a != b; return 1;
+        case GT:  *result = (int32_t)a > (int32_t)b; return 1;
+        case LT:  *result = (int32_t)a < (int32_t)b; return 1;
+        case GE:  *result = (int32_t)a >= (int32_t)b; return 1;
+        case LE:  *result = (int32_t)a <= (int32_t)b; return 1;
+        default:  return 0;
+    }
+}
+
+static int branch_taken(Opcode op, int32_t a, int32_t b) {
+    switch (op) {
+        case BEQ: return a == b;
+        case BNE: return a != b;
+        case BLT: return a < b;
+        case BGE: return a >= b;
+        case BGT: return a > b;
+        default:  return a <= b;
+    }
+}
+
+// x op c and c op x that come down to x or to a constant
+static int simplify_identity(IrInstruction *instruction) {
+    IrOperand a = instruction->a, b = instruction->b;
+    Opcode op = instruction->op;
+    if (b.constant) {
+        if ((b.value == 0 && (op == ADD || op == SUB || op == OR || op == XOR || op == SHL || op == SHR)) ||
+            (b.value == 1 && (op == MUL || op == DIV))) {
+            make_set(instruction, a);
+            return 1;
+        }
+        if (b.value == 0 && (op == MUL || op == AND)) {
+            make_set(instruction, constant(0));
+            return 1;
+        }
+    }
+    if (a.constant) {
+        if ((a.value == 0 && (op == ADD || op == OR || op == XOR)) || (a.value == 1 && op == MUL)) {
+            make_set(instruction, b);
+            return 1;
+        }
+        if (a.value == 0 && (op == MUL || op == AND || op == SHL || op == SHR)) {
+            make_set(instruction, constant(0));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    uint32_t *known;   // Generation in which the value was last known
+    uint32_t *value;   // Its constant then
+    uint32_t generation;
+} ConstantState;
+
+static void substitute(const ConstantState *state, IrOperand *operand, int *changed) {
+    if (!operand->constant && state->known[operand->value] == state->generation) {
+        *operand = constant(state->value[operand->value]);
+        *changed = 1;
+    }
+}
+
+static int fold_constants(IrProgram *program, IrOptStats *stats) {
+    ConstantState state;
+    state.known = allocate(program->value_count, sizeof(uint32_t));
+    state.value = allocate(program->value_count, sizeof(uint32_t));
+    state.generation = 1;
+    for (size_t v = 0; v < program->value_count; v++) {
+        state.known[v] = state.generation; // Everything starts at zero
+    }
+    uint32_t *references = count_references(program);
+    int any = 0;
+
+    for (size_t i = 0; i < program->count; i++) {
+        IrInstruction *instruction = &program->code[i];
+        if (starts_fresh(program, references, i)) {
+            state.generation++;
+        }
+        int changed = 0;
+        uint32_t result;
+        switch (instruction->kind) {
+            case IR_SET:
+            case IR_OUT:
+            case IR_ARG:
+            case IR_RET:
+                substitute(&state, &instruction->a, &changed);
+                break;
+            case IR_UNARY:
+                substitute(&state, &instruction->a, &changed);
+                if (instruction->a.constant && evaluate(instruction->op, instruction->a.value, 0, &result)) {
+                    make_set(instruction, constant(result));
+                    changed = 1;
+                }
+                break;
+            case IR_BINARY:
+                substitute(&state, &instruction->a, &changed);
+                substitute(&state, &instruction->b, &changed);
+                if (instruction->a.constant && instruction->b.constant &&
+                    evaluate(instruction->op, instruction->a.value, instruction->b.value, &result)) {
+                    make_set(instruction, constant(result));
+                    changed = 1;
+                } else if (simplify_identity(instruction)) {
+                    changed = 1;
+                }
+                break;
+            case IR_BRANCH:
+                substitute(&state, &instruction->a, &changed);
+                substitute(&state, &instruction->b, &changed);
+                if (instruction->a.constant && instruction->b.constant) {
+                    if (branch_taken(instruction->op, (int32_t)instruction->a.value, (int32_t)instruction->b.value)) {
+                        instruction->kind = IR_JUMP;
+                        instruction->op = JUMP;
+                        instruction->a = instruction->b = no_operand;
+                    } else {
+                        references[instruction->label]--;
+                        instruction->kind = IR_NOP;
+                    }
+                    changed = 1;
+                }
+                break;
+            default:
+                break;
+        }
+        if (changed) {
+            stats->folded++;
+            any = 1;
+        }
+
+        switch (instruction->kind) {
+            case IR_SET:
+            case IR_UNARY:
+            case IR_BINARY:
+            case IR_CALL:
+                if (instruction->kind == IR_SET && instruction->a.constant) {
+                    state.known[instruction->dst] = state.generation;
+                    state.value[instruction->dst] = instruction->a.value;
+                } else {
+                    state.known[instruction->dst] = 0;
+                }
+                break;
+            case IR_DJNZ:
+                // Falling out of the loop means the counter reached zero
+                state.known[instruction->dst] = state.generation;
+                state.value[instruction->dst] = 0;
+                break;
+            case IR_BRANCH:
+                // Falling through BNE x, c means x equals c
+                if (instruction->op == BNE && instruction->a.constant != instruction->b.constant) {
+                    IrOperand x = instruction->a.constant ? instruction->b : instruction->a;
+                    IrOperand c = instruction->a.constant ? instruction->a : instruction->b;
+                    state.known[x.value] = state.generation;
+                    state.value[x.value] = c.value;
+                }
+                break;
+            case IR_JUMP:
+            case IR_HALT:
+            case IR_RET:
+                state.generation++; // What follows is reached only through a label
+                break;
+            default:
+                break;
+        }
+    }
+
+    free(state.known);
+    free(state.value);
+    free(references);
+    return any;
+}
+
+// ---------------------------------------------------------------- Strength reduction
+
+static int power_of_two(IrOperand operand, uint32_t *shift) {
+    if (!operand.constant || operand.value == 0 || (operand.value & (operand.value - 1)) != 0) {
+        return 0;
+    }
+    for (*shift = 0; (1u << *shift) != operand.value; (*shift)++) {
+    }
+    return 1;
+}
+
+static int reduce_strength(IrProgram *program, IrOptStats *stats) {
+    int any = 0;
+    for (size_t i = 0; i < program->count; i++) {
+        IrInstruction *instruction = &program->code[i];
+        uint32_t shift;
+        if (instruction->kind != IR_BINARY) {
+            continue;
+        }
+        if (instruction->op == MUL && !instruction->b.constant && power_of_two(instruction->a, &shift)) {
+            instruction->a = instruction->b;
+            instruction->b = constant(shift);
+            instruction->op = SHL;
+        } else if (instruction->op == MUL && power_of_two(instruction->b, &shift)) {
+            instruction->b = constant(shift);
+            instruction->op = SHL;
+        } else if (instruction->op == DIV && power_of_two(instruction->b, &shift)) {
+            instruction->b = constant(shift); // DIV is unsigned, so this is exact
+            instruction->op = SHR;
+        } else {
+            continue;
+        }
+        stats->reduced++;
+        any = 1;
+    }
+    return any;
+}
+
+// ---------------------------------------------------------------- Common subexpressions
+
+// An operation on operands at given versions, and the value holding its result
+typedef struct {
+    uint32_t generation;
+    uint8_t kind;
+    Opcode op;
+    IrOperand a;
+    IrOperand b;
+    uint32_t a_version;
+    uint32_t b_version;
+    uint32_t holder;
+    uint32_t holder_version;
+} Expression;
+
+typedef struct {
+    uint32_t *version;        // Per value: bumped on every write
+    uint32_t *copy_generation; // Per value: generation of the copy it holds
+    uint32_t *copy_source;    // The value it was copied from
+    uint32_t *copy_version;   // Its own version when copied
+    uint32_t *source_version; // The source's version then
+    Expression *table;        // Open addressing, stale generations are free
+    size_t mask;
+    uint32_t generation;
+} ValueNumbering;
+
+static int is_commutative(Opcode op) {
+    return op == ADD || op == MUL || op == AND || op == OR || op == XOR || op == EQ || op == NEQ;
+}
+
+static uint32_t operand_version(const ValueNumbering *numbering, IrOperand operand) {
+    return operand.constant ? 0 : numbering->version[operand.value];
+}
+
+static size_t hash_expression(const Expression *e) {
+    uint64_t hash = (uint64_t)e->op * 0x9E3779B97F4A7C15ull;
+    uint64_t parts[6] = {e->kind, e->a.value, (uint64_t)e->a.constant << 32 | e->a_version,
+                         e->b.value, (uint64_t)e->b.constant << 32 | e->b_version, 0};
+    for (int i = 0; i < 5; i++) {
+        hash = (hash ^ parts[i]) * 0x100000001B3ull;
+    }
+    return (size_t)(hash ^ (hash >> 29));
+}
+
+static int same_expression(const Expression *x, const Expression *y) {
+    return x->kind == y->kind && x->op == y->op && same_operand(x->a, y->a) && same_operand(x->b, y->b) &&
+           x->a_version == y->a_version && x->b_version == y->b_version;
+}
+
+// Replace a value copied earlier in the block by its source, if neither changed since
+static void propagate_copy(const ValueNumbering *numbering, IrOperand *operand, int *changed) {
+    uint32_t v = operand->value;
+    if (operand->constant || numbering->copy_generation[v] != numbering->generation ||
+        numbering->version[v] != numbering->copy_version[v]) {
+        return;
+    }
+    uint32_t source = numbering->copy_source[v];
+    if (numbering->version[source] == numbering->source_version[v]) {
+        operand->value = source;
+        *changed = 1;
+    }
+}
+
+static int eliminate_common_subexpressions(IrProgram *program, IrOptStats *stats) {
+    ValueNumbering numbering;
+    size_t size = 16;
+    while (size < program->count * 2) {
+        size *= 2;
+    }
+    numbering.version = allocate(program->value_count, sizeof(uint32_t));
+    numbering.copy_generation = allocate(program->value_count, sizeof(uint32_t));
+    numbering.copy_source = allocate(program->value_count, sizeof(uint32_t));
+    numbering.copy_version = allocate(program->value_count, sizeof(uint32_t));
+    numbering.source_version = allocate(program->value_count, sizeof(uint32_t));
+    numbering.table = allocate(size, sizeof(Expression));
+    numbering.mask = size - 1;
+    numbering.generation = 1;
+    uint32_t *references = count_references(program);
+    int any = 0;
+
+    for (size_t i = 0; i < program->count; i++) {
+        IrInstruction *instruction = &program->code[i];
+        if (starts_fresh(program, references, i)) {
+            numbering.generation++;
+        }
+        int changed = 0;
+        switch (instruction->kind) {
+            case IR_BINARY:
+            case IR_BRANCH:
+                propagate_copy(&numbering, &instruction->b, &changed);
+                // fall through
+            case IR_SET:
+            case IR_UNARY:
+            case IR_OUT:
+            case IR_ARG:
+            case IR_RET:
+                propagate_copy(&numbering, &instruction->a, &changed);
+                break;
+            default:
+                break;
+        }
+        any |= changed;
+
+        if (instruction->kind == IR_UNARY || instruction->kind == IR_BINARY) {
+            Expression key;
+            memset(&key, 0, sizeof(key));
+            key.kind = instruction->kind;
+            key.op = instruction->op;
+            key.a = instruction->a;
+            key.b = instruction->b;
+            if (is_commutative(key.op) &&
+                (key.a.constant > key.b.constant || (key.a.constant == key.b.constant && key.a.value > key.b.value))) {
+                key.a = instruction->b;
+                key.b = instruction->a;
+            }
+            key.a_version = operand_version(&numbering, key.a);
+            key.b_version = operand_version(&numbering, key.b);
+            size_t slot = hash_expression(&key) & numbering.mask;
+            Expression *found = NULL;
+            while (numbering.table[slot].generation == numbering.generation) {
+                Expression *entry = &numbering.table[slot];
+                if (same_expression(entry, &key)) {
+                    if (numbering.version[entry->holder] == entry->holder_version) {
+                        found = entry;
+                    }
+                    break;
+                }
+                slot = (slot + 1) & numbering.mask;
+            }
+            if (found) {
+                IrOperand holder = {found->holder, 0};
+                make_set(instruction, holder);
+                stats->reused++;
+                any = 1;
+            } else {
+                key.generation = numbering.generation;
+                key.holder = instruction->dst;
+                key.holder_version = numbering.version[instruction->dst] + 1;
+                numbering.table[slot] = key;
+            }
+        }
+
+        if (ir_writes_dst(instruction->kind)) {
+            uint32_t dst = instruction->dst;
+            numbering.version[dst]++;
+            if (instruction->kind == IR_SET && !instruction->a.constant && instruction->a.value != dst) {
+                numbering.copy_generation[dst] = numbering.generation;
+                numbering.copy_source[dst] = instruction->a.value;
+                numbering.copy_version[dst] = numbering.version[dst];
+                numbering.source_version[dst] = numbering.version[instruction->a.value];
+            }
+        }
+        if (ends_flow(instruction->kind)) {
+            numbering.generation++;
+        }
+    }
+
+    free(numbering.version);
+    free(numbering.copy_generation);
+    free(numbering.copy_source);
+    free(numbering.copy_version);
+    free(numbering.source_version);
+    free(numbering.table);
+    free(references);
+    return any;
+}
+
+// ---------------------------------------------------------------- Loop-invariant code motion
+
+// Loops are found by their back edges. The translator's loops are rotated,
+// so the body runs from its label to the branch back to it, and is entered
+// only through the label after the entry test: code placed just before the
+// label runs once, and only when the body will run. A tail call jumping back
+// to a function's entry is not such a loop, since nothing runs before it.
+typedef struct {
+    size_t header; // Index of the body label
+    size_t end;    // Index of the branch back to it
+} Loop;
+
+typedef struct {
+    size_t position; // Inserted before this instruction
+    size_t order;
+    IrInstruction instruction;
+} Insertion;
+
+static int compare_loops(const void *x, const void *y) {
+    const Loop *a = x, *b = y;
+    size_t length_a = a->end - a->header, length_b = b->end - b->header;
+    if (length_a != length_b) {
+        return length_a < length_b ? -1 : 1;
+    }
+    return (a->header > b->header) - (a->header < b->header);
+}
+
+static int compare_insertions(const void *x, const void *y) {
+    const Insertion *a = x, *b = y;
+    if (a->position != b->position) {
+        return a->position < b->position ? -1 : 1;
+    }
+    return (a->order > b->order) - (a->order < b->order);
+}
+
+static int hoist_invariants(IrProgram *program, IrOptStats *stats) {
+    size_t count = program->count;
+    size_t value_count = program->value_count;
+    size_t *label_at = allocate(program->label_count, sizeof(size_t));
+    size_t *loop_end = allocate(count, sizeof(size_t));
+    for (size_t i = 0; i < count; i++) {
+        if (program->code[i].kind == IR_LABEL) {
+            label_at[program->code[i].label] = i;
+        }
+    }
+    size_t loop_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        const IrInstruction *instruction = &program->code[i];
+        if (targets_label(instruction->kind) && instruction->kind != IR_CALL && label_at[instruction->label] < i &&
+            ir_function_of_label(program, instruction->label) == IR_NONE) {
+            size_t header = label_at[instruction->label];
+            loop_count += loop_end[header] == 0;
+            loop_end[header] = i;
+        }
+    }
+    if (loop_count == 0) {
+        free(label_at);
+        free(loop_end);
+        return 0;
+    }
+    Loop *loops = allocate(loop_count, sizeof(Loop));
+    loop_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (loop_end[i] != 0) {
+            loops[loop_count].header = i;
+            loops[loop_count++].end = loop_end[i];
+        }
+    }
+    qsort(loops, loop_count, sizeof(Loop), compare_loops); // Inner loops first
+
+    uint32_t *definitions = allocate(value_count, sizeof(uint32_t));
+    uint32_t *defined_in = allocate(value_count, sizeof(uint32_t)); // Loop number + 1
+    for (size_t i = 0; i < count; i++) {
+        if (ir_writes_dst(program->code[i].kind)) {
+            definitions[program->code[i].dst]++;
+        }
+    }
+    size_t *hoisted_headers = allocate(loop_count, sizeof(size_t));
+    size_t hoisted_loops = 0;
+    Insertion *insertions = NULL;
+    size_t insertion_count = 0, insertion_capacity = 0;
+
+    for (size_t k = 0; k < loop_count; k++) {
+        const Loop *loop = &loops[k];
+        // An enclosing loop waits for the next round: what was taken out of
+        // the inner loop is not in place yet
+        int blocked = 0;
+        for (size_t h = 0; h < hoisted_loops && !blocked; h++) {
+            blocked = hoisted_headers[h] > loop->header && hoisted_headers[h] <= loop->end;
+        }
+        if (blocked) {
+            continue;
+        }
+        uint32_t mark = (uint32_t)k + 1;
+        for (size_t i = loop->header; i <= loop->end; i++) {
+            if (ir_writes_dst(program->code[i].kind)) {
+                defined_in[program->code[i].dst] = mark;
+            }
+        }
+        uint8_t depth = program->code[loop->header].loop_depth;
+        size_t before = insertion_count;
+        for (size_t i = loop->header + 1; i < loop->end; i++) {
+            IrInstruction *instruction = &program->code[i];
+            if ((instruction->kind != IR_UNARY && instruction->kind != IR_BINARY) || !is_pure(instruction) ||
+                (!instruction->a.constant && defined_in[instruction->a.value] == mark) ||
+                (instruction->kind == IR_BINARY && !instruction->b.constant &&
+                 defined_in[instruction->b.value] == mark)) {
+                continue;
+            }
+            if (insertion_count == insertion_capacity) {
+                insertion_capacity = insertion_capacity ? insertion_capacity * 2 : 64;
+                insertions = realloc(insertions, insertion_capacity * sizeof(Insertion));
+                if (!insertions) {
+                    fprintf(stderr, "Error: Out of memory in the HLL optimizer.\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            Insertion *insertion = &insertions[insertion_count];
+            insertion->position = loop->header;
+            insertion->order = insertion_count++;
+            insertion->instruction = *instruction;
+            insertion->instruction.loop_depth = depth;
+            uint32_t dst = instruction->dst;
+            if (!program->values[dst].name[0] && definitions[dst] == 1) {
+                // An intermediate written only here moves out whole, and what
+                // is computed from it may follow
+                instruction->kind = IR_NOP;
+                defined_in[dst] = 0;
+            } else {
+                // A variable keeps its assignment in the loop, copied from a
+                // new intermediate computed before it
+                uint32_t temporary = ir_value(program, "");
+                IrOperand value = {temporary, 0};
+                insertion->instruction.dst = temporary;
+                make_set(instruction, value);
+            }
+            stats->hoisted++;
+        }
+        if (insertion_count > before) {
+            hoisted_headers[hoisted_loops++] = loop->header;
+        }
+    }
+
+    if (insertion_count > 0) {
+        qsort(insertions, insertion_count, sizeof(Insertion), compare_insertions);
+        IrInstruction *code = allocate(count + insertion_count, sizeof(IrInstruction));
+        size_t next = 0, written = 0;
+        for (size_t i = 0; i < count; i++) {
+            while (next < insertion_count && insertions[next].position == i) {
+                code[written++] = insertions[next++].instruction;
+            }
+            code[written++] = program->code[i];
+        }
+        free(program->code);
+        program->code = code;
+        program->count = written;
+        program->capacity = count + insertion_count;
+    }
+
+    free(label_at);
+    free(loop_end);
+    free(loops);
+    free(definitions);
+    free(defined_in);
+    free(hoisted_headers);
+    free(insertions);
+    return insertion_count > 0;
+}
+
+// ---------------------------------------------------------------- Dead code
+
+// Unreachable code, unused labels, and jumps to where control goes anyway
+static int remove_dead_control(IrProgram *program, uint32_t *references) {
+    int any = 0;
+    int reachable = 1;
+    for (size_t i = 0; i < program->count; i++) {
+        IrInstruction *instruction = &program->code[i];
+        if (instruction->kind == IR_LABEL) {
+            if (references[instruction->label] == 0) {
+                instruction->kind = IR_NOP;
+                continue;
+            }
+            reachable = 1;
+        }
+        if (!reachable) {
+            if (targets_label(instruction->kind)) {
+                references[instruction->label]--;
+            }
+            instruction->kind = IR_NOP;
+            any = 1;
+            continue;
+        }
+        if (instruction->kind == IR_JUMP || instruction->kind == IR_BRANCH) {
+            // Only labels between here and the target: falling through gets there
+            size_t next = i + 1;
+            while (next < program->count && program->code[next].kind == IR_LABEL &&
+                   program->code[next].label != instruction->label) {
+                next++;
+            }
+            if (next < program->count && program->code[next].kind == IR_LABEL &&
+                program->code[next].label == instruction->label) {
+                references[instruction->label]--;
+                instruction->kind = IR_NOP;
+                any = 1;
+                continue;
+            }
+        }
+        if (instruction->kind == IR_SET && !instruction->a.constant && instruction->a.value == instruction->dst) {
+            instruction->kind = IR_NOP;
+            any = 1;
+        } else if (ends_flow(instruction->kind)) {
+            reachable = 0;
+        }
+    }
+    return any;
+}
+
+// Writes overwritten later in the same block before anything reads them
+static int remove_overwritten(IrProgram *program, const uint32_t *references) {
+    uint32_t *overwritten = allocate(program->value_count, sizeof(uint32_t)); // Block stamp
+    uint32_t block = 1;
+    int any = 0;
+    for (size_t i = program->count; i-- > 0; ) {
+        IrInstruction *instruction = &program->code[i];
+        if (ir_ends_block(instruction->kind)) {
+            block++;
+        }
+        if (is_pure(instruction) && overwritten[instruction->dst] == block) {
+            instruction->kind = IR_NOP;
+            any = 1;
+            continue;
+        }
+        if (ir_writes_dst(instruction->kind)) {
+            overwritten[instruction->dst] = block;
+        }
+        uint32_t uses[2];
+        int count = ir_uses(instruction, uses);
+        for (int k = 0; k < count; k++) {
+            overwritten[uses[k]] = 0;
+        }
+        if (starts_fresh(program, references, i)) {
+            block++;
+        }
+    }
+    free(overwritten);
+    return any;
+}
+
+// Results nobody reads, and then the operands only they read
+static int remove_unused(IrProgram *program) {
+    uint32_t *readers = allocate(program->value_count, sizeof(uint32_t));
+    size_t *writers_head = allocate(program->value_count, sizeof(size_t)); // Instruction + 1
+    size_t *writers_next = allocate(program->count, sizeof(size_t));
+    uint32_t *worklist = allocate(program->value_count, sizeof(uint32_t));
+    size_t pending = 0;
+    for (size_t i = 0; i < program->count; i++) {
+        const IrInstruction *instruction = &program->code[i];
+        uint32_t uses[2];
+        int count = ir_uses(instruction, uses);
+        for (int k = 0; k < count; k++) {
+            readers[uses[k]]++;
+        }
+        if (ir_writes_dst(instruction->kind)) {
+            writers_next[i] = writers_head[instruction->dst];
+            writers_head[instruction->dst] = i + 1;
+        }
+    }
+    for (size_t v = 0; v < program->value_count; v++) {
+        if (readers[v] == 0 && writers_head[v] != 0) {
+            worklist[pending++] = (uint32_t)v;
+        }
+    }
+    int any = 0;
+    while (pending > 0) {
+        uint32_t value = worklist[--pending];
+        for (size_t w = writers_head[value]; w != 0; w = writers_next[w - 1]) {
+            IrInstruction *instruction = &program->code[w - 1];
+            if (instruction->kind == IR_NOP || !is_pure(instruction)) {
+                continue;
+            }
+            uint32_t uses[2];
+            int count = ir_uses(instruction, uses);
+            instruction->kind = IR_NOP;
+            any = 1;
+            for (int k = 0; k < count; k++) {
+                if (--readers[uses[k]] == 0 && uses[k] != value) {
+                    worklist[pending++] = uses[k];
+                }
+            }
+        }
+    }
+    free(readers);
+    free(writers_head);
+    free(writers_next);
+    free(worklist);
+    return any;
+}
+
+static int remove_dead_code(IrProgram *program) {
+    uint32_t *references = count_references(program);
+    int any = remove_dead_control(program, references);
+    any |= remove_overwritten(program, references);
+    free(references);
+    compact(program);
+    any |= remove_unused(program);
+    return any;
+}
+
+void ir_optimize(IrProgram *program, unsigned passes, IrOptStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->instructions = (uint32_t)program->count;
+    for (int round = 0; round < MAX_ROUNDS; round++) {
+        int changed = 0;
+        if (passes & IR_PASS_CONSTANTS) {
+            changed |= fold_constants(program, stats);
+            compact(program);
+        }
+        if (passes & IR_PASS_STRENGTH) {
+            changed |= reduce_strength(program, stats);
+        }
+        if (passes & IR_PASS_CSE) {
+            changed |= eliminate_common_subexpressions(program, stats);
+        }
+        if (passes & IR_PASS_LICM) {
+            changed |= hoist_invariants(program, stats);
+            compact(program);
+        }
+        if (passes & IR_PASS_DEAD_CODE) {
+            changed |= remove_dead_code(program);
+            compact(program);
+        }
+        if (!changed) {
+            break;
+        }
+    }
+    stats->remaining = (uint32_t)program->count;
+}
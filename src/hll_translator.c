@@ -0,0 +1,1274 @@
+#include "hll_translator.h"
+#include "linker.h" // LABEL_NAME_MAX
+#include "symtab.h"
+#include "hll_ir.h"
+#include "hll_opt.h"
+#include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
+
+#define NO_NODE (-1)
+
+typedef enum {
+    TOK_END,
+    TOK_NUMBER,
+    TOK_NAME,
+    // Keywords
+    TOK_IF,
+    TOK_ELSE,
+    TOK_ENDIF,
+    TOK_WHILE,
+    TOK_ENDWHILE,
+    TOK_PRINT,
+    TOK_HALT,
+    TOK_FUNCTION,
+    TOK_ENDFUNCTION,
+    TOK_RETURN,
+    // Punctuation
+    TOK_LPAREN,
+    TOK_RPAREN,
+    TOK_LBRACE,
+    TOK_RBRACE,
+    TOK_SEMICOLON,
+    TOK_COMMA,
+    TOK_ASSIGN,
+    // Operators
+    TOK_PLUS,
+    TOK_MINUS,
+    TOK_STAR,
+    TOK_SLASH,
+    TOK_AMP,
+    TOK_PIPE,
+    TOK_CARET,
+    TOK_TILDE,
+    TOK_BANG,
+    TOK_SHL,
+    TOK_SHR,
+    TOK_EQ,
+    TOK_NE,
+    TOK_LT,
+    TOK_GT,
+    TOK_LE,
+    TOK_GE,
+    TOK_LOGICAL_AND,
+    TOK_LOGICAL_OR,
+    NUM_TOKEN_KINDS
+} TokenKind;
+
+static const struct {
+    const char *word;
+    TokenKind kind;
+} keywords[] = {
+    {"if", TOK_IF}, {"else", TOK_ELSE}, {"endif", TOK_ENDIF}, {"while", TOK_WHILE},
+    {"endwhile", TOK_ENDWHILE}, {"print", TOK_PRINT}, {"halt", TOK_HALT}, {"function", TOK_FUNCTION},
+    {"endfunction", TOK_ENDFUNCTION}, {"return", TOK_RETURN},
+};
+
+// Punctuation and operators, two-character spellings first so "<=" is not read as "<"
+static const struct {
+    const char *text;
+    TokenKind kind;
+} symbols[] = {
+    {"<<", TOK_SHL}, {">>", TOK_SHR}, {"==", TOK_EQ}, {"!=", TOK_NE}, {"<=", TOK_LE},
+    {">=", TOK_GE}, {"&&", TOK_LOGICAL_AND}, {"||", TOK_LOGICAL_OR},
+    {"(", TOK_LPAREN}, {")", TOK_RPAREN}, {"{", TOK_LBRACE}, {"}", TOK_RBRACE},
+    {";", TOK_SEMICOLON}, {",", TOK_COMMA}, {"=", TOK_ASSIGN}, {"+", TOK_PLUS}, {"-", TOK_MINUS},
+    {"*", TOK_STAR}, {"/", TOK_SLASH}, {"&", TOK_AMP}, {"|", TOK_PIPE}, {"^", TOK_CARET},
+    {"~", TOK_TILDE}, {"!", TOK_BANG}, {"<", TOK_LT}, {">", TOK_GT},
+};
+
+// Binary operators by token: precedence (0 for tokens that are not binary
+// operators, higher binds tighter, as in C), the instruction computing the
+// value, and for comparisons the compare-and-branch taken when the
+// comparison holds and when it fails
+static const struct {
+    uint8_t precedence;
+    uint8_t comparison;
+    Opcode opcode;
+    Opcode branch_if_true;
+    Opcode branch_if_false;
+} operators[NUM_TOKEN_KINDS] = {
+    [TOK_LOGICAL_OR]  = {1, 0, HALT, HALT, HALT},
+    [TOK_LOGICAL_AND] = {2, 0, HALT, HALT, HALT},
+    [TOK_PIPE]        = {3, 0, OR, HALT, HALT},
+    [TOK_CARET]       = {4, 0, XOR, HALT, HALT},
+    [TOK_AMP]         = {5, 0, AND, HALT, HALT},
+    [TOK_EQ]          = {6, 1, EQ, BEQ, BNE},
+    [TOK_NE]          = {6, 1, NEQ, BNE, BEQ},
+    [TOK_LT]          = {7, 1, LT, BLT, BGE},
+    [TOK_GT]          = {7, 1, GT, BGT, BLE},
+    [TOK_LE]          = {7, 1, LE, BLE, BGT},
+    [TOK_GE]          = {7, 1, GE, BGE, BLT},
+    [TOK_SHL]         = {8, 0, SHL, HALT, HALT},
+    [TOK_SHR]         = {8, 0, SHR, HALT, HALT},
+    [TOK_PLUS]        = {9, 0, ADD, HALT, HALT},
+    [TOK_MINUS]       = {9, 0, SUB, HALT, HALT},
+    [TOK_STAR]        = {10, 0, MUL, HALT, HALT},
+    [TOK_SLASH]       = {10, 0, DIV, HALT, HALT},
+};
+
+typedef struct {
+    uint8_t kind;     // TokenKind
+    uint32_t line;
+    uint32_t offset;  // Spelling in the source
+    uint32_t length;
+    uint32_t value;   // TOK_NUMBER
+} Token;
+
+typedef enum {
+    NODE_NUMBER,   // value
+    NODE_VARIABLE, // value: variable index
+    NODE_UNARY,    // op, left
+    NODE_BINARY,   // op, left, right
+    NODE_ASSIGN,   // value: variable index, left: expression
+    NODE_PRINT,    // left: expression
+    NODE_HALT,
+    NODE_IF,       // left: condition, right: then block, other: else block
+    NODE_WHILE,    // left: condition, right: body, other: the decrement DJNZ replaces
+    NODE_CALL,     // value: function, left: first argument (chained through next), other: argument count
+    NODE_RETURN    // left: expression, or NO_NODE
+} NodeKind;
+
+// AST nodes live in one array and refer to each other by index; the
+// statements of a block are chained through next
+typedef struct {
+    uint8_t kind;     // NodeKind
+    uint8_t op;       // Operator token of NODE_UNARY and NODE_BINARY
+    uint16_t height;  // Longest path to a leaf (expressions)
+    uint32_t line;
+    uint32_t value;
+    int32_t left;
+    int32_t right;
+    int32_t other;
+    int32_t next;
+} Node;
+
+// Variable i is virtual register i of the IR
+typedef struct {
+    uint32_t last_assignment;     // Order of the latest assignment parsed (0: none)
+    uint32_t previous_assignment; // Order of the one before it
+} Variable;
+
+// Function i is function i of the IR
+typedef struct {
+    uint32_t line;        // Definition, or the first call while there is none
+    int defined;
+    int32_t body;         // First statement
+    int32_t last;         // Last statement
+    uint32_t params;      // Parameters declared
+    uint8_t accumulate;   // Operator token of the tail calls folded into an accumulator, or 0
+    uint32_t accumulator; // The extra parameter holding it
+    uint8_t loops;        // Has tail calls to itself
+} Function;
+
+typedef struct {
+    const char *source;
+    Token *tokens;
+    size_t token_count;
+    size_t token_capacity;
+    size_t position;         // Next token to parse
+    Node *nodes;
+    size_t node_count;
+    size_t node_capacity;
+    Variable *variables;
+    uint32_t variable_count;
+    uint32_t variable_capacity;
+    SymbolTable names;       // Variable name -> index; a local's name is "function.name"
+    Function *functions;
+    size_t function_count;
+    size_t function_capacity;
+    SymbolTable function_names; // Function name -> index
+    uint32_t function;       // Function being parsed or lowered, or IR_NONE
+    uint32_t assignments;    // Assignments parsed so far
+    unsigned depth;          // Blocks and parentheses open while parsing
+    int failed;
+
+    IrProgram ir;
+    unsigned labels;         // Next number for the labels of an if, while or && / ||
+    uint8_t loop_depth;      // Loops around the code being lowered
+} Translator;
+
+static void *grow(void *array, size_t *capacity, size_t count, size_t size) {
+    if (count < *capacity) {
+        return array;
+    }
+    *capacity = *capacity ? *capacity * 2 : 256;
+    array = realloc(array, *capacity * size);
+    if (!array) {
+        fprintf(stderr, "Error: Out of memory in the HLL translator.\n");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+// Report the first error; parsing then runs into the end token and stops
+static void error(Translator *t, uint32_t line, const char *format, ...) {
+    if (t->failed) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "Error: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, " (line %u).\n", line);
+    va_end(args);
+    t->failed = 1;
+    if (t->token_count > 0) {
+        t->position = t->token_count - 1;
+    }
+}
+
+// ---------------------------------------------------------------- Lexer
+
+static void add_token(Translator *t, TokenKind kind, uint32_t line, size_t offset, size_t length) {
+    t->tokens = grow(t->tokens, &t->token_capacity, t->token_count, sizeof(Token));
+    Token *token = &t->tokens[t->token_count++];
+    token->kind = kind;
+    token->line = line;
+    token->offset = (uint32_t)offset;
+    token->length = (uint32_t)length;
+    token->value = 0;
+}
+
+static int is_name_char(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+static void tokenize(Translator *t) {
+    const char *source = t->source;
+    uint32_t line = 1;
+    size_t i = 0;
+    while (source[i] && !t->failed) {
+        char c = source[i];
+        if (c == '\n') {
+            line++;
+            i++;
+        } else if (isspace((unsigned char)c)) {
+            i++;
+        } else if (c == '#' || (c == '/' && source[i + 1] == '/')) {
+            while (source[i] && source[i] != '\n') {
+                i++; // Comment to the end of the line
+            }
+        } else if (isdigit((unsigned char)c)) {
+            size_t start = i;
+            int base = (c == '0' && (source[i + 1] == 'x' || source[i + 1] == 'X')) ? 16 : 10;
+            uint64_t value = 0;
+            int valid = 1;
+            for (i += base == 16 ? 2 : 0; is_name_char(source[i]); i++) {
+                int digit = isdigit((unsigned char)source[i]) ? source[i] - '0'
+                          : isxdigit((unsigned char)source[i]) ? tolower((unsigned char)source[i]) - 'a' + 10 : base;
+                value = value * base + digit;
+                valid = valid && digit < base && value <= UINT32_MAX;
+            }
+            if (!valid || (base == 16 && i == start + 2)) {
+                error(t, line, "Invalid number '%.*s'", (int)(i - start), source + start);
+                return;
+            }
+            add_token(t, TOK_NUMBER, line, start, i - start);
+            t->tokens[t->token_count - 1].value = (uint32_t)value;
+        } else if (is_name_char(c)) {
+            size_t start = i;
+            while (is_name_char(source[i])) {
+                i++;
+            }
+            TokenKind kind = TOK_NAME;
+            for (size_t k = 0; k < sizeof(keywords) / sizeof(keywords[0]); k++) {
+                if (strlen(keywords[k].word) == i - start && strncmp(keywords[k].word, source + start, i - start) == 0) {
+                    kind = keywords[k].kind;
+                }
+            }
+            add_token(t, kind, line, start, i - start);
+        } else {
+            size_t k = 0, count = sizeof(symbols) / sizeof(symbols[0]);
+            while (k < count && strncmp(symbols[k].text, source + i, strlen(symbols[k].text)) != 0) {
+                k++;
+            }
+            if (k == count) {
+                error(t, line, "Unexpected character '%c'", c);
+                return;
+            }
+            add_token(t, symbols[k].kind, line, i, strlen(symbols[k].text));
+            i += strlen(symbols[k].text);
+        }
+    }
+    // Errors at the end of the program point at its last line with code
+    add_token(t, TOK_END, t->token_count > 0 ? t->tokens[t->token_count - 1].line : line, i, 0);
+}
+
+// ---------------------------------------------------------------- Parser
+
+static const Token *peek(const Translator *t) {
+    return &t->tokens[t->position];
+}
+
+static const Token *advance(Translator *t) {
+    const Token *token = &t->tokens[t->position];
+    if (token->kind != TOK_END) {
+        t->position++;
+    }
+    return token;
+}
+
+static int accept(Translator *t, TokenKind kind) {
+    if (peek(t)->kind != kind) {
+        return 0;
+    }
+    advance(t);
+    return 1;
+}
+
+static void expected(Translator *t, const char *what) {
+    const Token *token = peek(t);
+    if (token->kind == TOK_END) {
+        error(t, token->line, "Expected %s but found the end of the program", what);
+    } else {
+        error(t, token->line, "Expected %s but found '%.*s'", what, (int)token->length, t->source + token->offset);
+    }
+}
+
+static void expect(Translator *t, TokenKind kind, const char *what) {
+    if (!accept(t, kind)) {
+        expected(t, what);
+    }
+}
+
+// Count one more level of nesting; the parser and code generator recurse once per level
+static int enter(Translator *t, uint32_t line) {
+    if (++t->depth > HLL_MAX_NESTING) {
+        error(t, line, "Program is nested more than %d levels deep", HLL_MAX_NESTING);
+        return 0;
+    }
+    return 1;
+}
+
+static int32_t add_node(Translator *t, NodeKind kind, uint32_t line) {
+    t->nodes = grow(t->nodes, &t->node_capacity, t->node_count, sizeof(Node));
+    Node *node = &t->nodes[t->node_count];
+    memset(node, 0, sizeof(*node));
+    node->kind = kind;
+    node->line = line;
+    node->height = 1;
+    node->left = node->right = node->other = node->next = NO_NODE;
+    return (int32_t)t->node_count++;
+}
+
+static int32_t add_operator(Translator *t, NodeKind kind, const Token *op, int32_t left, int32_t right) {
+    int32_t index = add_node(t, kind, op->line);
+    Node *node = &t->nodes[index];
+    node->op = op->kind;
+    node->left = left;
+    node->right = right;
+    uint16_t height = left == NO_NODE ? 0 : t->nodes[left].height;
+    if (right != NO_NODE && t->nodes[right].height > height) {
+        height = t->nodes[right].height;
+    }
+    if (height >= HLL_MAX_NESTING) {
+        error(t, op->line, "Expression is nested more than %d levels deep", HLL_MAX_NESTING);
+    }
+    node->height = height + 1;
+    return index;
+}
+
+// Register names would be read as registers by the assembler
+static int names_register(const char *name) {
+    return strchr("RrVv", name[0]) && name[1] && strspn(name + 1, "0123456789") == strlen(name + 1);
+}
+
+// Index of a variable, created on first use. Inside a function the name is
+// qualified by the function's, so each function has variables of its own.
+static uint32_t variable_index(Translator *t, const Token *token) {
+    char name[LABEL_NAME_MAX];
+    size_t prefix = t->function == IR_NONE ? 0 : strlen(t->ir.functions[t->function].name) + 1;
+    if (prefix + token->length >= LABEL_NAME_MAX) {
+        error(t, token->line, "Variable name '%.*s' is longer than %d characters",
+              (int)token->length, t->source + token->offset, (int)(LABEL_NAME_MAX - 1 - prefix));
+        return 0;
+    }
+    if (prefix > 0) {
+        memcpy(name, t->ir.functions[t->function].name, prefix - 1);
+        name[prefix - 1] = '.';
+    }
+    memcpy(name + prefix, t->source + token->offset, token->length);
+    name[prefix + token->length] = '\0';
+
+    uint32_t index;
+    if (symtab_lookup(&t->names, name, &index)) {
+        return index;
+    }
+    if (names_register(name + prefix)) {
+        error(t, token->line, "'%s' names a register and cannot be a variable", name + prefix);
+        return 0;
+    }
+    if (prefix == 0 && symtab_lookup(&t->function_names, name, &index)) {
+        error(t, token->line, "'%s' is a function and cannot be a variable", name);
+        return 0;
+    }
+    size_t capacity = t->variable_capacity;
+    t->variables = grow(t->variables, &capacity, t->variable_count, sizeof(Variable));
+    t->variable_capacity = (uint32_t)capacity;
+    index = t->variable_count++;
+    memset(&t->variables[index], 0, sizeof(Variable));
+    ir_value(&t->ir, name);
+    symtab_define(&t->names, name, index);
+    return index;
+}
+
+// Index of a function, created when it is first called or defined; IR_NONE
+// if the name cannot be one. Its name is the label of its entry.
+static uint32_t function_index(Translator *t, const Token *token) {
+    char name[LABEL_NAME_MAX];
+    if (token->length >= LABEL_NAME_MAX) {
+        error(t, token->line, "Function name '%.*s' is longer than %d characters",
+              (int)token->length, t->source + token->offset, LABEL_NAME_MAX - 1);
+        return IR_NONE;
+    }
+    memcpy(name, t->source + token->offset, token->length);
+    name[token->length] = '\0';
+
+    uint32_t index;
+    if (symtab_lookup(&t->function_names, name, &index)) {
+        return index;
+    }
+    if (names_register(name)) {
+        error(t, token->line, "'%s' names a register and cannot be a function", name);
+        return IR_NONE;
+    }
+    if (symtab_lookup(&t->names, name, &index)) {
+        error(t, token->line, "'%s' is a variable and cannot be a function", name);
+        return IR_NONE;
+    }
+    t->functions = grow(t->functions, &t->function_capacity, t->function_count, sizeof(Function));
+    index = ir_function(&t->ir, name);
+    t->function_count++;
+    Function *function = &t->functions[index];
+    memset(function, 0, sizeof(*function));
+    function->line = token->line;
+    function->body = function->last = NO_NODE;
+    symtab_define(&t->function_names, name, index);
+    return index;
+}
+
+static int32_t parse_expression(Translator *t, int min_precedence);
+
+// name(argument, ...); the name has been read
+static int32_t parse_call(Translator *t, const Token *name) {
+    int32_t node = add_node(t, NODE_CALL, name->line);
+    uint32_t function = function_index(t, name);
+    int32_t last = NO_NODE;
+    uint32_t count = 0;
+    uint16_t height = 0;
+    expect(t, TOK_LPAREN, "'('");
+    if (!accept(t, TOK_RPAREN)) {
+        do {
+            int32_t argument = parse_expression(t, 1);
+            if (argument == NO_NODE) {
+                break;
+            }
+            if (last == NO_NODE) {
+                t->nodes[node].left = argument;
+            } else {
+                t->nodes[last].next = argument;
+            }
+            last = argument;
+            count++;
+            if (t->nodes[argument].height > height) {
+                height = t->nodes[argument].height;
+            }
+        } while (accept(t, TOK_COMMA));
+        expect(t, TOK_RPAREN, "')' after the arguments");
+    }
+    if (height >= HLL_MAX_NESTING) {
+        error(t, name->line, "Expression is nested more than %d levels deep", HLL_MAX_NESTING);
+    }
+    t->nodes[node].value = function;
+    t->nodes[node].other = (int32_t)count;
+    t->nodes[node].height = height + 1;
+    return node;
+}
+
+// unary := ('-' | '~' | '!') unary | number | name | name '(' arguments ')' | '(' expression ')'
+static int32_t parse_unary(Translator *t) {
+    const Token *token = peek(t);
+    int32_t node = NO_NODE;
+    if (!enter(t, token->line)) {
+        return NO_NODE;
+    }
+    switch (token->kind) {
+        case TOK_NUMBER:
+            advance(t);
+            node = add_node(t, NODE_NUMBER, token->line);
+            t->nodes[node].value = token->value;
+            break;
+        case TOK_NAME:
+            advance(t);
+            if (peek(t)->kind == TOK_LPAREN) {
+                node = parse_call(t, token);
+                break;
+            }
+            node = add_node(t, NODE_VARIABLE, token->line);
+            t->nodes[node].value = variable_index(t, token);
+            break;
+        case TOK_LPAREN:
+            advance(t);
+            node = parse_expression(t, 1);
+            expect(t, TOK_RPAREN, "')'");
+            break;
+        case TOK_MINUS:
+        case TOK_TILDE:
+        case TOK_BANG: {
+            advance(t);
+            int32_t operand = parse_unary(t);
+            if (token->kind == TOK_MINUS && operand != NO_NODE && t->nodes[operand].kind == NODE_NUMBER) {
+                t->nodes[operand].value = -t->nodes[operand].value; // A negative literal
+                node = operand;
+            } else {
+                node = add_operator(t, NODE_UNARY, token, operand, NO_NODE);
+            }
+            break;
+        }
+        default:
+            expected(t, "an expression");
+            break;
+    }
+    t->depth--;
+    return node;
+}
+
+// Precedence climbing: operators binding at least as tightly as min_precedence
+// are taken here; each level is left-associative
+static int32_t parse_expression(Translator *t, int min_precedence) {
+    int32_t left = parse_unary(t);
+    for (;;) {
+        const Token *op = peek(t);
+        int precedence = operators[op->kind].precedence;
+        if (precedence == 0 || precedence < min_precedence) {
+            return left;
+        }
+        advance(t);
+        int32_t right = parse_expression(t, precedence + 1);
+        left = add_operator(t, NODE_BINARY, op, left, right);
+    }
+}
+
+static int32_t parse_condition(Translator *t) {
+    expect(t, TOK_LPAREN, "'(' before the condition");
+    int32_t condition = parse_expression(t, 1);
+    expect(t, TOK_RPAREN, "')' after the condition");
+    accept(t, TOK_LBRACE);
+    return condition;
+}
+
+static int ends_block(TokenKind kind) {
+    return kind == TOK_END || kind == TOK_RBRACE || kind == TOK_ENDIF || kind == TOK_ENDWHILE || kind == TOK_ELSE ||
+           kind == TOK_ENDFUNCTION;
+}
+
+static int32_t parse_statement(Translator *t);
+
+// Statements up to the token that closes the block; last receives the final one
+static int32_t parse_block(Translator *t, int32_t *last) {
+    int32_t first = NO_NODE;
+    *last = NO_NODE;
+    if (!enter(t, peek(t)->line)) {
+        return NO_NODE;
+    }
+    while (!ends_block(peek(t)->kind)) {
+        int32_t statement = parse_statement(t);
+        if (statement == NO_NODE) {
+            continue;
+        }
+        if (*last == NO_NODE) {
+            first = statement;
+        } else {
+            t->nodes[*last].next = statement;
+        }
+        *last = statement;
+    }
+    t->depth--;
+    return first;
+}
+
+static int accept_close(Translator *t) {
+    return accept(t, TOK_RBRACE) || accept(t, TOK_ENDIF);
+}
+
+// if (c) ... }  |  if (c) { ... } else { ... }  |  if (c) ... else ... endif
+static int32_t parse_if(Translator *t, const Token *keyword) {
+    int32_t node = add_node(t, NODE_IF, keyword->line), last;
+    int32_t condition = parse_condition(t);
+    int32_t then_block = parse_block(t, &last);
+    int32_t else_block = NO_NODE;
+    int closed = accept_close(t);
+    if (accept(t, TOK_ELSE)) {
+        accept(t, TOK_LBRACE);
+        else_block = parse_block(t, &last);
+        closed = accept_close(t);
+    }
+    if (!closed) {
+        expected(t, "'}' closing the if");
+    }
+    t->nodes[node].left = condition;
+    t->nodes[node].right = then_block;
+    t->nodes[node].other = else_block;
+    return node;
+}
+
+// A while loop is counted when its condition is "v > 0" or "v != 0", its last
+// statement is "v = v - 1" and nothing else in the body assigns v. Since the
+// body has just been parsed, the decrement is v's latest assignment, and any
+// other assignment in the body would be the one before it.
+static int32_t counted_decrement(const Translator *t, int32_t condition, int32_t last, uint32_t body_start) {
+    if (condition == NO_NODE || last == NO_NODE) {
+        return NO_NODE;
+    }
+    const Node *test = &t->nodes[condition];
+    const Node *step = &t->nodes[last];
+    if (test->kind != NODE_BINARY || (test->op != TOK_GT && test->op != TOK_NE) ||
+        t->nodes[test->left].kind != NODE_VARIABLE ||
+        t->nodes[test->right].kind != NODE_NUMBER || t->nodes[test->right].value != 0) {
+        return NO_NODE;
+    }
+    uint32_t var = t->nodes[test->left].value;
+    if (step->kind != NODE_ASSIGN || step->value != var) {
+        return NO_NODE;
+    }
+    const Node *value = &t->nodes[step->left];
+    if (value->kind != NODE_BINARY || value->op != TOK_MINUS ||
+        t->nodes[value->left].kind != NODE_VARIABLE || t->nodes[value->left].value != var ||
+        t->nodes[value->right].kind != NODE_NUMBER || t->nodes[value->right].value != 1) {
+        return NO_NODE;
+    }
+    return t->variables[var].previous_assignment < body_start ? last : NO_NODE;
+}
+
+// while (c) { ... endwhile  |  while (c) { ... }
+static int32_t parse_while(Translator *t, const Token *keyword) {
+    int32_t node = add_node(t, NODE_WHILE, keyword->line), last;
+    int32_t condition = parse_condition(t);
+    uint32_t body_start = t->assignments + 1;
+    int32_t body = parse_block(t, &last);
+    if (!accept(t, TOK_ENDWHILE) && !accept(t, TOK_RBRACE)) {
+        expected(t, "'endwhile' closing the while");
+    }
+    t->nodes[node].left = condition;
+    t->nodes[node].right = body;
+    if (!t->failed) {
+        t->nodes[node].other = counted_decrement(t, condition, last, body_start);
+    }
+    return node;
+}
+
+// function name(a, b) { ... }  |  function name(a, b) ... endfunction
+// The body is kept for lowering after the main program; the definition
+// leaves no statement behind.
+static void parse_function(Translator *t, const Token *keyword) {
+    const Token *name = peek(t);
+    if (t->function != IR_NONE || t->depth != 1) {
+        error(t, keyword->line, "Functions can only be defined at the top level");
+        return;
+    }
+    if (name->kind != TOK_NAME) {
+        expected(t, "a function name");
+        return;
+    }
+    advance(t);
+    uint32_t index = function_index(t, name);
+    if (index == IR_NONE) {
+        return;
+    }
+    if (t->functions[index].defined) {
+        error(t, name->line, "Function '%s' is defined more than once", t->ir.functions[index].name);
+        return;
+    }
+    t->functions[index].defined = 1;
+    t->functions[index].line = name->line;
+    t->function = index;
+
+    IrFunction *function = &t->ir.functions[index];
+    expect(t, TOK_LPAREN, "'(' after the function name");
+    if (!t->failed && !accept(t, TOK_RPAREN)) {
+        do {
+            const Token *param = peek(t);
+            if (param->kind != TOK_NAME) {
+                expected(t, "a parameter name");
+                break;
+            }
+            advance(t);
+            uint32_t var = variable_index(t, param);
+            for (uint32_t p = 0; p < function->param_count; p++) {
+                if (function->params[p] == var) {
+                    error(t, param->line, "Parameter '%.*s' appears twice", (int)param->length, t->source + param->offset);
+                }
+            }
+            if (function->param_count == HLL_MAX_PARAMS) {
+                error(t, param->line, "Function '%s' has more than %d parameters", function->name, HLL_MAX_PARAMS);
+                break;
+            }
+            function->params[function->param_count++] = var;
+        } while (accept(t, TOK_COMMA));
+        expect(t, TOK_RPAREN, "')' after the parameters");
+    }
+    t->functions[index].params = function->param_count;
+    accept(t, TOK_LBRACE);
+    int32_t last;
+    int32_t body = parse_block(t, &last);
+    if (!accept(t, TOK_RBRACE) && !accept(t, TOK_ENDFUNCTION)) {
+        expected(t, "'}' closing the function");
+    }
+    t->functions[index].body = body;
+    t->functions[index].last = last;
+    t->function = IR_NONE;
+}
+
+// An expression follows "return" unless the next statement starts there
+static int returns_value(const Translator *t) {
+    const Token *token = peek(t);
+    switch (token->kind) {
+        case TOK_NUMBER:
+        case TOK_LPAREN:
+        case TOK_MINUS:
+        case TOK_TILDE:
+        case TOK_BANG:
+            return 1;
+        case TOK_NAME:
+            return t->tokens[t->position + 1].kind != TOK_ASSIGN;
+        default:
+            return 0;
+    }
+}
+
+static int32_t parse_statement(Translator *t) {
+    const Token *token = advance(t);
+    int32_t node = NO_NODE;
+    switch (token->kind) {
+        case TOK_NAME: {
+            if (peek(t)->kind == TOK_LPAREN) {
+                node = parse_call(t, token);
+                break;
+            }
+            uint32_t var = variable_index(t, token);
+            expect(t, TOK_ASSIGN, "'=' after the variable name");
+            int32_t value = parse_expression(t, 1);
+            node = add_node(t, NODE_ASSIGN, token->line);
+            t->nodes[node].value = var;
+            t->nodes[node].left = value;
+            if (!t->failed) {
+                t->variables[var].previous_assignment = t->variables[var].last_assignment;
+                t->variables[var].last_assignment = ++t->assignments;
+            }
+            break;
+        }
+        case TOK_PRINT: {
+            node = add_node(t, NODE_PRINT, token->line);
+            int32_t value = parse_expression(t, 1);
+            t->nodes[node].left = value;
+            break;
+        }
+        case TOK_HALT:
+            node = add_node(t, NODE_HALT, token->line);
+            break;
+        case TOK_IF:
+            node = parse_if(t, token);
+            break;
+        case TOK_WHILE:
+            node = parse_while(t, token);
+            break;
+        case TOK_FUNCTION:
+            parse_function(t, token);
+            break;
+        case TOK_RETURN:
+            if (t->function == IR_NONE) {
+                error(t, token->line, "'return' outside a function");
+                break;
+            }
+            node = add_node(t, NODE_RETURN, token->line);
+            if (returns_value(t)) {
+                int32_t value = parse_expression(t, 1);
+                t->nodes[node].left = value;
+            }
+            break;
+        case TOK_SEMICOLON:
+            break;
+        default:
+            t->position--;
+            expected(t, "a statement");
+            break;
+    }
+    return node;
+}
+
+// ---------------------------------------------------------------- Lowering to the IR
+
+static void lower(Translator *t, IrKind kind, Opcode op, uint32_t dst, IrOperand a, IrOperand b, uint32_t label) {
+    IrInstruction instruction = {
+        .kind = kind, .loop_depth = t->loop_depth, .op = op, .dst = dst, .a = a, .b = b, .label = label,
+    };
+    ir_emit(&t->ir, &instruction);
+}
+
+static const IrOperand no_operand = {0, 1};
+
+static IrOperand constant(uint32_t value) {
+    IrOperand operand = {value, 1};
+    return operand;
+}
+
+static IrOperand value_of(uint32_t value) {
+    IrOperand operand = {value, 0};
+    return operand;
+}
+
+static void place_label(Translator *t, uint32_t label) {
+    lower(t, IR_LABEL, HALT, IR_NONE, no_operand, no_operand, label);
+}
+
+static void lower_into(Translator *t, int32_t index, uint32_t dst);
+static void lower_branch(Translator *t, int32_t index, uint32_t label, int when);
+static IrOperand lower_value(Translator *t, int32_t index);
+
+// Value the accumulator of a function starts with: the identity of its operator
+static uint32_t identity(uint8_t op) {
+    return op == TOK_STAR ? 1 : op == TOK_AMP ? UINT32_MAX : 0;
+}
+
+// Arguments are evaluated left to right, then passed with IR_ARGs right
+// before the call. A function with an accumulator gets its identity as an
+// extra argument.
+static void lower_call(Translator *t, int32_t index, uint32_t dst) {
+    const Node *node = &t->nodes[index];
+    const Function *function = &t->functions[node->value];
+    IrOperand arguments[IR_MAX_PARAMS];
+    int count = 0;
+    for (int32_t argument = node->left; argument != NO_NODE; argument = t->nodes[argument].next) {
+        arguments[count++] = lower_value(t, argument);
+    }
+    if (function->accumulate) {
+        arguments[count++] = constant(identity(function->accumulate));
+    }
+    for (int i = 0; i < count; i++) {
+        lower(t, IR_ARG, PUSH, IR_NONE, arguments[i], no_operand, IR_NONE);
+    }
+    lower(t, IR_CALL, CALL, dst, no_operand, no_operand, t->ir.functions[node->value].label);
+}
+
+// A call to the function being lowered, in tail position, becomes a jump back
+// to its entry after the arguments are assigned to the parameters. The
+// assignments happen at once: an argument reading a parameter assigned
+// before it is copied first.
+static void lower_tail_call(Translator *t, int32_t index) {
+    const IrFunction *function = &t->ir.functions[t->function];
+    IrOperand arguments[IR_MAX_PARAMS];
+    int count = 0;
+    for (int32_t argument = t->nodes[index].left; argument != NO_NODE; argument = t->nodes[argument].next) {
+        arguments[count++] = lower_value(t, argument);
+    }
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < i; j++) {
+            int reassigned = arguments[j].constant || arguments[j].value != function->params[j];
+            if (!arguments[i].constant && arguments[i].value == function->params[j] && reassigned) {
+                uint32_t copy = ir_value(&t->ir, "");
+                lower(t, IR_SET, LOAD, copy, arguments[i], no_operand, IR_NONE);
+                arguments[i] = value_of(copy);
+                break;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (arguments[i].constant || arguments[i].value != function->params[i]) {
+            lower(t, IR_SET, LOAD, function->params[i], arguments[i], no_operand, IR_NONE);
+        }
+    }
+    lower(t, IR_JUMP, JUMP, IR_NONE, no_operand, no_operand, function->label);
+}
+
+// Numbers and variables are used in place; anything else gets a new value
+static IrOperand lower_value(Translator *t, int32_t index) {
+    const Node *node = &t->nodes[index];
+    if (node->kind == NODE_NUMBER) {
+        return constant(node->value);
+    }
+    if (node->kind == NODE_VARIABLE) {
+        return value_of(node->value);
+    }
+    uint32_t temporary = ir_value(&t->ir, "");
+    lower_into(t, index, temporary);
+    return value_of(temporary);
+}
+
+// Compute an expression into dst. dst is written only after every operand
+// has been read, so "x = x + 1" can compute straight into x.
+static void lower_into(Translator *t, int32_t index, uint32_t dst) {
+    const Node *node = &t->nodes[index];
+    switch (node->kind) {
+        case NODE_NUMBER:
+        case NODE_VARIABLE:
+            lower(t, IR_SET, LOAD, dst, lower_value(t, index), no_operand, IR_NONE);
+            break;
+        case NODE_CALL:
+            lower_call(t, index, dst);
+            break;
+        case NODE_UNARY: {
+            IrOperand a = lower_value(t, node->left);
+            if (node->op == TOK_MINUS) {
+                lower(t, IR_BINARY, SUB, dst, constant(0), a, IR_NONE);
+            } else if (node->op == TOK_TILDE) {
+                lower(t, IR_UNARY, NOT, dst, a, no_operand, IR_NONE);
+            } else {
+                lower(t, IR_BINARY, EQ, dst, a, constant(0), IR_NONE);
+            }
+            break;
+        }
+        case NODE_BINARY:
+            if (node->op == TOK_LOGICAL_AND || node->op == TOK_LOGICAL_OR) {
+                unsigned id = t->labels++;
+                uint32_t is_false = ir_label(&t->ir, "False", id), done = ir_label(&t->ir, "Done", id);
+                lower_branch(t, index, is_false, 0);
+                lower(t, IR_SET, LOAD, dst, constant(1), no_operand, IR_NONE);
+                lower(t, IR_JUMP, JUMP, IR_NONE, no_operand, no_operand, done);
+                place_label(t, is_false);
+                lower(t, IR_SET, LOAD, dst, constant(0), no_operand, IR_NONE);
+                place_label(t, done);
+            } else if (node->op == TOK_SHL || node->op == TOK_SHR) {
+                const Node *count = &t->nodes[node->right];
+                if (count->kind != NODE_NUMBER || count->value > 31) {
+                    error(t, node->line, "Shift amount must be a constant from 0 to 31");
+                    return;
+                }
+                IrOperand a = lower_value(t, node->left);
+                lower(t, IR_BINARY, operators[node->op].opcode, dst, a, constant(count->value), IR_NONE);
+            } else {
+                IrOperand a = lower_value(t, node->left);
+                IrOperand b = lower_value(t, node->right);
+                lower(t, IR_BINARY, operators[node->op].opcode, dst, a, b, IR_NONE);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Branch to label when the condition's truth equals when; otherwise fall through
+static void lower_branch(Translator *t, int32_t index, uint32_t label, int when) {
+    const Node *node = &t->nodes[index];
+    if (node->kind == NODE_NUMBER) {
+        if ((node->value != 0) == when) {
+            lower(t, IR_JUMP, JUMP, IR_NONE, no_operand, no_operand, label);
+        }
+    } else if (node->kind == NODE_UNARY && node->op == TOK_BANG) {
+        lower_branch(t, node->left, label, !when);
+    } else if (node->kind == NODE_BINARY && (node->op == TOK_LOGICAL_AND || node->op == TOK_LOGICAL_OR)) {
+        // a || b branches when either side is true, a && b when either is false;
+        // otherwise the left side decides whether the right one is tested
+        if (when == (node->op == TOK_LOGICAL_OR)) {
+            lower_branch(t, node->left, label, when);
+            lower_branch(t, node->right, label, when);
+        } else {
+            uint32_t skip = ir_label(&t->ir, "Skip", t->labels++);
+            lower_branch(t, node->left, skip, !when);
+            lower_branch(t, node->right, label, when);
+            place_label(t, skip);
+        }
+    } else if (node->kind == NODE_BINARY && operators[node->op].comparison) {
+        IrOperand a = lower_value(t, node->left);
+        IrOperand b = lower_value(t, node->right);
+        lower(t, IR_BRANCH, when ? operators[node->op].branch_if_true : operators[node->op].branch_if_false,
+              IR_NONE, a, b, label);
+    } else {
+        lower(t, IR_BRANCH, when ? BNE : BEQ, IR_NONE, lower_value(t, index), constant(0), label);
+    }
+}
+
+static void lower_block(Translator *t, int32_t statement, int32_t stop);
+
+static int is_self_call(const Translator *t, int32_t index) {
+    return index != NO_NODE && t->nodes[index].kind == NODE_CALL && t->nodes[index].value == t->function;
+}
+
+// Evaluating the expression has no effect that could be seen: no calls, and
+// no division that might be by zero
+static int is_quiet(const Translator *t, int32_t index) {
+    const Node *node = &t->nodes[index];
+    switch (node->kind) {
+        case NODE_NUMBER:
+        case NODE_VARIABLE:
+            return 1;
+        case NODE_UNARY:
+            return is_quiet(t, node->left);
+        case NODE_BINARY:
+            if (node->op == TOK_SLASH &&
+                (t->nodes[node->right].kind != NODE_NUMBER || t->nodes[node->right].value == 0)) {
+                return 0;
+            }
+            return is_quiet(t, node->left) && is_quiet(t, node->right);
+        default:
+            return 0;
+    }
+}
+
+// The call of "return e op f(...)" or "return f(...) op e" that an
+// accumulator can take over: op is associative and commutative, so each
+// such return adds e to the accumulator and jumps, and a plain return
+// combines its value with the accumulator. Moving e before the call is
+// invisible when e comes first anyway or is quiet.
+static int32_t accumulated_call(const Translator *t, int32_t index, uint8_t op) {
+    const Node *node = &t->nodes[index];
+    if (node->kind != NODE_BINARY || node->op != op) {
+        return NO_NODE;
+    }
+    if (is_self_call(t, node->right)) {
+        return node->right;
+    }
+    return is_self_call(t, node->left) && is_quiet(t, node->right) ? node->left : NO_NODE;
+}
+
+static int accumulates(uint8_t op) {
+    return op == TOK_PLUS || op == TOK_STAR || op == TOK_AMP || op == TOK_PIPE || op == TOK_CARET;
+}
+
+// Looks through the returns of a block for tail calls of the function being
+// planned; the first accumulating one chooses the operator
+static int find_tail_calls(Translator *t, int32_t statement) {
+    int found = 0;
+    Function *function = &t->functions[t->function];
+    for (; statement != NO_NODE; statement = t->nodes[statement].next) {
+        const Node *node = &t->nodes[statement];
+        if (node->kind == NODE_IF) {
+            found |= find_tail_calls(t, node->right);
+            found |= find_tail_calls(t, node->other);
+        } else if (node->kind == NODE_WHILE) {
+            found |= find_tail_calls(t, node->right);
+        } else if (node->kind == NODE_RETURN && node->left != NO_NODE) {
+            const Node *value = &t->nodes[node->left];
+            if (is_self_call(t, node->left)) {
+                found = 1;
+            } else if (value->kind == NODE_BINARY && accumulates(value->op) &&
+                       (!function->accumulate || function->accumulate == value->op) &&
+                       accumulated_call(t, node->left, value->op) != NO_NODE) {
+                function->accumulate = value->op;
+                found = 1;
+            }
+        }
+    }
+    return found;
+}
+
+// return e: a self call in tail position jumps instead, as does one the
+// accumulator takes over
+static void lower_return(Translator *t, int32_t index) {
+    const Function *function = &t->functions[t->function];
+    if (is_self_call(t, index)) {
+        lower_tail_call(t, index);
+        return;
+    }
+    int32_t call = index == NO_NODE || !function->accumulate ? NO_NODE
+                 : accumulated_call(t, index, function->accumulate);
+    Opcode op = operators[function->accumulate].opcode;
+    if (call != NO_NODE) {
+        const Node *node = &t->nodes[index];
+        IrOperand e = lower_value(t, call == node->right ? node->left : node->right);
+        lower(t, IR_BINARY, op, function->accumulator, value_of(function->accumulator), e, IR_NONE);
+        lower_tail_call(t, call);
+        return;
+    }
+    IrOperand value = index == NO_NODE ? constant(0) : lower_value(t, index);
+    if (function->accumulate) {
+        uint32_t result = ir_value(&t->ir, "");
+        lower(t, IR_BINARY, op, result, value_of(function->accumulator), value, IR_NONE);
+        value = value_of(result);
+    }
+    lower(t, IR_RET, RET, IR_NONE, value, no_operand, IR_NONE);
+}
+
+// Rotated loop: the condition is tested once on entry and again at the
+// bottom, with one fused branch back to the body. A counted loop ends in
+// DJNZ on its variable instead of the decrement and the test.
+static void lower_while(Translator *t, const Node *node) {
+    unsigned id = t->labels++;
+    uint32_t body = ir_label(&t->ir, "WhileBody", id), end = ir_label(&t->ir, "EndWhile", id);
+    lower_branch(t, node->left, end, 0);
+    place_label(t, body);
+    t->loop_depth++;
+    lower_block(t, node->right, node->other);
+    if (node->other != NO_NODE) {
+        lower(t, IR_DJNZ, DJNZ, t->nodes[node->other].value, no_operand, no_operand, body);
+    } else {
+        lower_branch(t, node->left, body, 1);
+    }
+    t->loop_depth--;
+    place_label(t, end);
+}
+
+static void lower_statement(Translator *t, int32_t index) {
+    const Node *node = &t->nodes[index];
+    switch (node->kind) {
+        case NODE_ASSIGN:
+            lower_into(t, node->left, node->value);
+            break;
+        case NODE_PRINT:
+            lower(t, IR_OUT, OUT, IR_NONE, lower_value(t, node->left), no_operand, IR_NONE);
+            break;
+        case NODE_HALT:
+            lower(t, IR_HALT, HALT, IR_NONE, no_operand, no_operand, IR_NONE);
+            break;
+        case NODE_IF: {
+            unsigned id = t->labels++;
+            uint32_t end = ir_label(&t->ir, "EndIf", id);
+            uint32_t otherwise = node->other == NO_NODE ? end : ir_label(&t->ir, "Else", id);
+            lower_branch(t, node->left, otherwise, 0);
+            lower_block(t, node->right, NO_NODE);
+            if (node->other != NO_NODE) {
+                lower(t, IR_JUMP, JUMP, IR_NONE, no_operand, no_operand, end);
+                place_label(t, otherwise);
+                lower_block(t, node->other, NO_NODE);
+            }
+            place_label(t, end);
+            break;
+        }
+        case NODE_WHILE:
+            lower_while(t, node);
+            break;
+        case NODE_CALL:
+            lower_call(t, index, ir_value(&t->ir, ""));
+            break;
+        case NODE_RETURN:
+            lower_return(t, node->left);
+            break;
+        default:
+            break;
+    }
+}
+
+// Statements of a block up to (not including) stop
+static void lower_block(Translator *t, int32_t statement, int32_t stop) {
+    while (statement != NO_NODE && statement != stop) {
+        lower_statement(t, statement);
+        statement = t->nodes[statement].next;
+    }
+}
+
+// Finds the tail calls of a function and gives it its accumulator, before
+// any call to it is lowered
+static void plan_function(Translator *t, uint32_t index) {
+    Function *function = &t->functions[index];
+    t->function = index;
+    function->loops = (uint8_t)find_tail_calls(t, function->body);
+    if (function->accumulate) {
+        IrFunction *entry = &t->ir.functions[index];
+        function->accumulator = ir_value(&t->ir, "");
+        entry->params[entry->param_count++] = function->accumulator;
+    }
+    t->function = IR_NONE;
+}
+
+// Functions follow the main program. One with tail calls to itself loops,
+// so its code counts as one loop deeper for spill costs.
+static void lower_function(Translator *t, uint32_t index) {
+    Function *function = &t->functions[index];
+    t->function = index;
+    t->loop_depth = function->loops;
+    place_label(t, t->ir.functions[index].label);
+    lower_block(t, function->body, NO_NODE);
+    if (function->last == NO_NODE || t->nodes[function->last].kind != NODE_RETURN) {
+        lower_return(t, NO_NODE);
+    }
+    t->loop_depth = 0;
+    t->function = IR_NONE;
+}
+
+// Every call names a defined function and passes one argument per parameter
+static void check_calls(Translator *t) {
+    for (size_t f = 0; f < t->function_count && !t->failed; f++) {
+        if (!t->functions[f].defined) {
+            error(t, t->functions[f].line, "Function '%s' is not defined", t->ir.functions[f].name);
+        }
+    }
+    for (size_t i = 0; i < t->node_count && !t->failed; i++) {
+        const Node *node = &t->nodes[i];
+        if (node->kind == NODE_CALL && (uint32_t)node->other != t->functions[node->value].params) {
+            error(t, node->line, "Function '%s' takes %u argument(s) but is given %d",
+                  t->ir.functions[node->value].name, t->functions[node->value].params, node->other);
+        }
+    }
+}
+
+static void free_translator(Translator *t) {
+    free(t->tokens);
+    free(t->nodes);
+    free(t->variables);
+    free(t->functions);
+    ir_free(&t->ir);
+    symtab_free(&t->names);
+    symtab_free(&t->function_names);
+}
+
+char *translate_hll_to_buffer(const char *hll_code, unsigned passes, size_t *size, IrStats *stats) {
+    Translator t;
+    memset(&t, 0, sizeof(t));
+    t.source = hll_code;
+    t.function = IR_NONE;
+    symtab_init(&t.names);
+    symtab_init(&t.function_names);
+    ir_init(&t.ir);
+
+    tokenize(&t);
+    int32_t last = NO_NODE;
+    int32_t program = t.failed ? NO_NODE : parse_block(&t, &last);
+    if (!t.failed && peek(&t)->kind != TOK_END) {
+        expected(&t, "a statement");
+    }
+    if (!t.failed) {
+        check_calls(&t);
+    }
+    if (!t.failed) {
+        for (uint32_t f = 0; f < t.function_count; f++) {
+            plan_function(&t, f);
+        }
+        lower_block(&t, program, NO_NODE);
+        if (last == NO_NODE || t.nodes[last].kind != NODE_HALT) {
+            lower(&t, IR_HALT, HALT, IR_NONE, no_operand, no_operand, IR_NONE);
+        }
+        for (uint32_t f = 0; f < t.function_count; f++) {
+            lower_function(&t, f);
+        }
+    }
+    if (t.failed) {
+        free_translator(&t);
+        return NULL;
+    }
+
+    if (passes != 0) {
+        IrOptStats optimization;
+        ir_optimize(&t.ir, passes, &optimization);
+        printf("Optimizer: %u of %u IR instructions left, folded %u, reduced %u, reused %u, hoisted %u\n",
+               optimization.remaining, optimization.instructions, optimization.folded,
+               optimization.reduced, optimization.reused, optimization.hoisted);
+    }
+    char *assembly = ir_generate(&t.ir, size, stats);
+    free_translator(&t);
+    return assembly;
+}
+
+int translate_hll_to_assembly(const char *hll_code, const char *output_file, unsigned passes) {
+    size_t size;
+    IrStats stats;
+    char *assembly = translate_hll_to_buffer(hll_code, passes, &size, &stats);
+    if (!assembly) {
+        return -1;
+    }
+    FILE *out = fopen(output_file, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Cannot open output file %s for writing.\n", output_file);
+        free(assembly);
+        return -1;
+    }
+    int status = fwrite(assembly, 1, size, out) == size ? 0 : -1;
+    if (fclose(out) != 0 || status != 0) {
+        fprintf(stderr, "Error: Failed to write '%s'.\n", output_file);
+        status = -1;
+    } else {
+        printf("Assembly file created: %s (%u instructions, %u of %u values in registers)\n",
+               output_file, stats.instructions, stats.values - stats.spilled, stats.values);
+    }
+    free(assembly);
+    return status;
+}
@@ -5,190 +5,129 @@
 #include "cpu.h"
 
 
-int translate_hll_to_assembly(const char *hll_code, const char *output_file) {
-    // Open the output file for writing
-    FILE *out = fopen(output_file, "w");
-    if (!out) {
-        fprintf(stderr, "Error: Cannot open output file %s for writing.\n", output_file);
-        return -1;
+// Decode a 32-bit binary instruction into an Instruction struct
+Instruction decode_instruction(uint32_t raw) {
+    Instruction instr;
+    instr.opcode = (Opcode)((raw >> 24) & INSTR_OPCODE_MASK); // Extract opcode (bits 29-24)
+    instr.size = 4 + ((raw & INSTR_MODES) ? 4 : 0)     // M flag: mode word follows
+                   + ((raw & INSTR_EXTENDED) ? 4 : 0);  // X flag: literal word follows
+    instr.displacement = 0;
+    instr.operands[0] = (raw >> 16) & 0xFF;             // Extract first operand (bits 23-16, 8 bits)
+    instr.operands[1] = (raw >> 8) & 0xFF;              // Extract second operand (bits 15-8, 8 bits)
+    instr.operands[2] = raw & 0xFF;                     // Extract third operand (bits 7-0, 8 bits)
+    // Implicit addressing modes come from the descriptor table (a mode word overrides them)
+    for (int i = 0; i < 3; i++) {
+        instr.modes[i] = instr.opcode < NUM_OPCODES ? implicit_mode(opcode_table[instr.opcode].kinds[i]) : REGISTER;
     }
+    return instr;
+}
 
-    printf("Creating assembly file: %s\n", output_file);
-
-    // Tokenize the HLL code line by line
-    char *code_copy = strdup(hll_code);
-    char *line = strtok(code_copy, "\n");
-    int label_counter = 0;
+// Decode a complete instruction, applying the mode and literal words if present
+Instruction decode_instruction_at(const uint8_t *memory, uint32_t address) {
+    uint32_t raw = read_memory(memory, address);
+    Instruction instr = decode_instruction(raw);
+    uint32_t next = address + 4;
+    int slot = literal_slot(instr.opcode);
+
+    if (raw & INSTR_MODES) {
+        uint32_t mode_word = read_memory(memory, next);
+        next += 4;
+        for (int i = 0; i < 3; i++) {
+            instr.modes[i] = (AddressingMode)((mode_word >> (i * MODE_FIELD_BITS)) & MODE_FIELD_MASK);
+        }
+        slot = (int)((mode_word >> MODE_SLOT_SHIFT) & 0x3);
+        if (slot == MODE_NO_SLOT) {
+            slot = -1;
+        }
+        instr.displacement = (int16_t)(mode_word >> MODE_DISP_SHIFT);
+    }
+    if ((raw & INSTR_EXTENDED) && slot >= 0) {
+        instr.operands[slot] = read_memory(memory, next);
+    }
+    return instr;
+}
 
-    while (line) {
-        // Skip empty lines or comments
-        if (line[0] == '\0' || line[0] == '#') {
-            line = strtok(NULL, "\n");
-            continue;
+// The literal replaces the first operand that is implicitly an immediate
+int literal_slot(Opcode opcode) {
+    if (opcode >= NUM_OPCODES) {
+        return -1;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (opcode_table[opcode].kinds[i] == OPK_IMM) {
+            return i;
         }
+    }
+    return -1;
+}
 
-        // Debug output
-        printf("Processing HLL line: %s\n", line);
-
-        // Parse and generate assembly instructions
-        if (strstr(line, "=")) {
-            // Handle expressions and assignments
-            char var[16], expr[32];
-            sscanf(line, "%s = %[^\n]", var, expr);
-
-            char op1[16], op2[16];
-            if (sscanf(expr, "%s + %s", op1, op2) == 2) {
-                // Handle addition
-                fprintf(out, "LOAD R0, %s\n", op1);
-                fprintf(out, "LOAD R1, %s\n", op2);
-                fprintf(out, "ADD R2, R0, R1\n");
-                fprintf(out, "STORE R2, %s\n", var);
-            } else if (sscanf(expr, "%s - %s", op1, op2) == 2) {
-                // Handle subtraction
-                fprintf(out, "LOAD R0, %s\n", op1);
-                fprintf(out, "LOAD R1, %s\n", op2);
-                fprintf(out, "SUB R2, R0, R1\n");
-                fprintf(out, "STORE R2, %s\n", var);
-            } else if (sscanf(expr, "%s * %s", op1, op2) == 2) {
-                // Handle multiplication
-                fprintf(out, "LOAD R0, %s\n", op1);
-                fprintf(out, "LOAD R1, %s\n", op2);
-                fprintf(out, "MUL R2, R0, R1\n");
-                fprintf(out, "STORE R2, %s\n", var);
-            } else if (sscanf(expr, "%s / %s", op1, op2) == 2) {
-                // Handle division
-                fprintf(out, "LOAD R0, %s\n", op1);
-                fprintf(out, "LOAD R1, %s\n", op2);
-                fprintf(out, "DIV R2, R0, R1\n");
-                fprintf(out, "STORE R2, %s\n", var);
-            } else {
-                // Handle simple assignments
-                fprintf(out, "LOAD R0, %s\n", expr);
-                fprintf(out, "STORE R0, %s\n", var);
-            }
-        } else if (strstr(line, "if")) {
-            // Handle if conditions
-            char condition[32];
-            sscanf(line, "if (%[^)])", condition);
-
-            char op1[16], op2[16];
-            if (strstr(condition, ">")) {
-                sscanf(condition, "%s > %s", op1, op2);
-                fprintf(out, "LOAD R0, %s\n", op1);
-                fprintf(out, "LOAD R1, %s\n", op2);
-                fprintf(out, "GT R2, R0, R1\n");
-                fprintf(out, "JZ Else_%d\n", label_counter);
-            } else if (strstr(condition, "<")) {
-                sscanf(condition, "%s < %s", op1, op2);
-                fprintf(out, "LOAD R0, %s\n", op1);
-                fprintf(out, "LOAD R1, %s\n", op2);
-                fprintf(out, "LT R2, R0, R1\n");
-                fprintf(out, "JZ Else_%d\n", label_counter);
-            } else if (strstr(condition, "==")) {
-                sscanf(condition, "%s == %s", op1, op2);
-                fprintf(out, "LOAD R0, %s\n", op1);
-                fprintf(out, "LOAD R1, %s\n", op2);
-                fprintf(out, "EQ R2, R0, R1\n");
-                fprintf(out, "JZ Else_%d\n", label_counter);
-            } else if (strstr(condition, "!=")) {
-                sscanf(condition, "%s != %s", op1, op2);
-                fprintf(out, "LOAD R0, %s\n", op1);
-                fprintf(out, "LOAD R1, %s\n", op2);
-                fprintf(out, "NEQ R2, R0, R1\n");
-                fprintf(out, "JZ Else_%d\n", label_counter);
+// Format one operand in assembler syntax
+static int format_operand(char *buf, size_t size, const Instruction *instruction, int index) {
+    uint32_t value = instruction->operands[index];
+    OperandKind kind = opcode_table[instruction->opcode].kinds[index];
+    switch (instruction->modes[index]) {
+        case REGISTER:
+            if (kind == OPK_COUNT) {
+                return snprintf(buf, size, "%u", value);
             }
-        } else if (strstr(line, "else")) {
-            // Handle else statement
-            fprintf(out, "JUMP EndIf_%d\n", label_counter);
-            fprintf(out, "Else_%d:\n", label_counter);
-        } else if (strstr(line, "print")) {
-            // Handle print statements
-            char var[16];
-            sscanf(line, "print(%[^)]", var);
-            fprintf(out, "LOAD R0, %s\n", var);
-            fprintf(out, "OUT R0\n");
-        } else if (strstr(line, "halt")) {
-            // Handle halt
-            fprintf(out, "HALT\n");
-        } else if (strstr(line, "}")) {
-            // Handle end of if blocks
-            fprintf(out, "EndIf_%d:\n", label_counter++);
-        } else if (strstr(line, "while")) {
-            // Handle while loops
-            fprintf(out, "WhileStart_%d:\n", label_counter);
-            char condition[32];
-            sscanf(line, "while (%[^)])", condition);
-
-            char op1[16], op2[16];
-            if (strstr(condition, ">")) {
-                sscanf(condition, "%s > %s", op1, op2);
-                fprintf(out, "LOAD R0, %s\n", op1);
-                fprintf(out, "LOAD R1, %s\n", op2);
-                fprintf(out, "GT R2, R0, R1\n");
-                fprintf(out, "JZ EndWhile_%d\n", label_counter);
+            return snprintf(buf, size, "%c%u", kind == OPK_VREG ? 'V' : 'R', value);
+        case IMMEDIATE:
+            return snprintf(buf, size, kind == OPK_IMM ? "0x%X" : "#0x%X", value);
+        case MEMORY:
+            return snprintf(buf, size, "[0x%X]", value);
+        case INDIRECT:
+            return snprintf(buf, size, "[[0x%X]]", value);
+        case INDEXED:
+            if (instruction->displacement == 0) {
+                return snprintf(buf, size, "[R%u]", value);
             }
-        } else if (strstr(line, "endwhile")) {
-            // Handle end of while loops
-            fprintf(out, "JUMP WhileStart_%d\n", label_counter);
-            fprintf(out, "EndWhile_%d:\n", label_counter++);
-        }
-
-        // Move to the next line
-        line = strtok(NULL, "\n");
+            return snprintf(buf, size, "[R%u%+d]", value, instruction->displacement);
+        default:
+            return snprintf(buf, size, "?");
     }
-
-    // Cleanup
-    free(code_copy);
-    fclose(out);
-
-    printf("Assembly file created: %s\n", output_file);
-    return 0;
 }
 
-
-
-
-
-// Decode a 32-bit binary instruction into an Instruction struct
-Instruction decode_instruction(uint32_t raw) {
-    Instruction instr;
-    instr.opcode = (Opcode)((raw >> 24) & 0xFF);        // Extract opcode (bits 31-24)
-    instr.operands[0] = (raw >> 16) & 0xFF;             // Extract first operand (bits 23-16, 8 bits)
-    instr.operands[1] = (raw >> 8) & 0xFF;              // Extract second operand (bits 15-8, 8 bits)
-    instr.operands[2] = raw & 0xFF;                     // Extract third operand (bits 7-0, 8 bits)
-    // Set addressing modes based on instruction semantics (not encoded in binary)
-    // LOAD: dest=REGISTER, src=IMMEDIATE
-    // Arithmetic: all=REGISTER
-    // Jump: target=IMMEDIATE
-    if (instr.opcode == LOAD) {
-        instr.modes[0] = REGISTER;
-        instr.modes[1] = IMMEDIATE;
-        instr.modes[2] = IMMEDIATE;
-    } else if (instr.opcode == JUMP || instr.opcode == JZ || instr.opcode == JNZ || instr.opcode == CALL) {
-        instr.modes[0] = IMMEDIATE;
-        instr.modes[1] = IMMEDIATE;
-        instr.modes[2] = IMMEDIATE;
-    } else {
-        // Default: all operands are registers
-        instr.modes[0] = REGISTER;
-        instr.modes[1] = REGISTER;
-        instr.modes[2] = REGISTER;
+int disassemble_instruction(const Instruction *instruction, char *buf, size_t size) {
+    if (instruction->opcode >= NUM_OPCODES) {
+        return snprintf(buf, size, "??? (opcode %02X)", instruction->opcode);
     }
-    return instr;
+    const OpcodeInfo *info = &opcode_table[instruction->opcode];
+    int length = snprintf(buf, size, "%s", info->mnemonic);
+    for (int i = 0; i < info->operand_count && (size_t)length < size; i++) {
+        length += snprintf(buf + length, size - length, i == 0 ? " " : ", ");
+        if ((size_t)length < size) {
+            length += format_operand(buf + length, size - length, instruction, i);
+        }
+    }
+    return length;
 }
 
 // Display the decoded instruction for debugging
 void display_instruction(Instruction instruction) {
-    printf("Opcode: %02X\n", instruction.opcode);
-    printf("Operands: %u, %u, %u\n",
-           instruction.operands[0],
-           instruction.operands[1],
-           instruction.operands[2]);
+    char text[64];
+    disassemble_instruction(&instruction, text, sizeof(text));
+    printf("%s\n", text);
+}
+
+// Address an operand refers to: the location a memory-mode operand reads, or
+// for IMMEDIATE/REGISTER operands the address they hold (STORE Rv, Raddr)
+static uint32_t effective_address(CPU *cpu, const Instruction *instruction, int index) {
+    uint32_t operand = instruction->operands[index];
+    switch (instruction->modes[index]) {
+        case REGISTER:
+            return operand < NUM_REGISTERS ? cpu->registers[operand] : 0;
+        case INDIRECT:
+            return read_data(cpu, operand);
+        case INDEXED:
+            return (operand < NUM_REGISTERS ? cpu->registers[operand] : 0) + (uint32_t)instruction->displacement;
+        default:
+            return operand; // IMMEDIATE and MEMORY
+    }
 }
 
 // Resolve operand based on addressing mode (moved out of execute_instruction)
-uint32_t resolve_operand(const CPU *cpu, uint32_t operand, AddressingMode mode) {
-    switch (mode) {
+uint32_t resolve_operand(CPU *cpu, const Instruction *instruction, int index) {
+    uint32_t operand = instruction->operands[index];
+    switch (instruction->modes[index]) {
         case IMMEDIATE:
             return operand;
         case REGISTER:
@@ -198,194 +137,374 @@ uint32_t resolve_operand(const CPU *cpu, uint32_t operand, AddressingMode mode)
             }
             return cpu->registers[operand];
         case MEMORY:
-            return read_memory(cpu->memory, operand);
-        case INDIRECT: {
-            uint32_t address = read_memory(cpu->memory, operand);
-            return read_memory(cpu->memory, address);
-        }
-        case INDEXED: {
-            uint32_t base = cpu->registers[operand >> 4]; // Upper nibble for base register
-            uint32_t offset = operand & 0xF;             // Lower nibble for offset
-            return read_memory(cpu->memory, base + offset);
-        }
+        case INDIRECT:
+        case INDEXED:
+            return read_data(cpu, effective_address(cpu, instruction, index));
         default:
             fprintf(stderr, "Error: Unknown addressing mode.\n");
             return 0;
     }
 }
 
-void execute_instruction(CPU *cpu, Instruction instruction) {
-    printf("Executing instruction: Opcode=%02X Operands=%u, %u, %u\n",
-           instruction.opcode,
-           instruction.operands[0],
-           instruction.operands[1],
-           instruction.operands[2]);
-
-    // uint32_t *reg = cpu->registers; // Shortcut to registers
-
-    // Instruction Execution
-    switch (instruction.opcode) {
-        // Arithmetic Operations
-        case ADD: {
-            uint32_t src1 = resolve_operand(cpu, instruction.operands[1], instruction.modes[1]);
-            uint32_t src2 = resolve_operand(cpu, instruction.operands[2], instruction.modes[2]);
-            cpu->registers[instruction.operands[0]] = alu_add(cpu, src1, src2);
-            printf("Added %08X and %08X, result in R%d (%08X)\n", src1, src2, instruction.operands[0],
-                   cpu->registers[instruction.operands[0]]);
+// Instruction handlers, one per descriptor-table entry (shared by related opcodes)
+
+// Arithmetic Operations
+static void exec_arithmetic(CPU *cpu, const Instruction *instruction, bool verbose) {
+    uint32_t src1 = resolve_operand(cpu, instruction, 1);
+    uint32_t src2 = resolve_operand(cpu, instruction, 2);
+    uint32_t rd = instruction->operands[0];
+    switch (instruction->opcode) {
+        case ADD:
+            write_register(cpu, rd, alu_add(cpu, src1, src2));
+            if (verbose) {
+                printf("Added %08X and %08X, result in R%d (%08X)\n", src1, src2, rd, cpu->registers[rd]);
+            }
             break;
-        }
-        case SUB: {
-            uint32_t src1 = resolve_operand(cpu, instruction.operands[1], instruction.modes[1]);
-            uint32_t src2 = resolve_operand(cpu, instruction.operands[2], instruction.modes[2]);
-            cpu->registers[instruction.operands[0]] = alu_sub(cpu, src1, src2);
+        case SUB:
+            write_register(cpu, rd, alu_sub(cpu, src1, src2));
             break;
-        }
-        case MUL: {
-            uint32_t src1 = resolve_operand(cpu, instruction.operands[1], instruction.modes[1]);
-            uint32_t src2 = resolve_operand(cpu, instruction.operands[2], instruction.modes[2]);
-            cpu->registers[instruction.operands[0]] = src1 * src2;
+        case MUL:
+            write_register(cpu, rd, src1 * src2);
             break;
-        }
-        case DIV: {
-            uint32_t src1 = resolve_operand(cpu, instruction.operands[1], instruction.modes[1]);
-            uint32_t src2 = resolve_operand(cpu, instruction.operands[2], instruction.modes[2]);
+        default: // DIV
             if (src2 == 0) {
                 fprintf(stderr, "Error: Division by zero.\n");
                 cpu->halted = true;
             } else {
-                cpu->registers[instruction.operands[0]] = src1 / src2;
+                write_register(cpu, rd, src1 / src2);
             }
             break;
-        }
+    }
+}
 
-        // Logical Operations
-        case AND: {
-            uint32_t src1 = resolve_operand(cpu, instruction.operands[1], instruction.modes[1]);
-            uint32_t src2 = resolve_operand(cpu, instruction.operands[2], instruction.modes[2]);
-            cpu->registers[instruction.operands[0]] = src1 & src2;
-            break;
-        }
-        case OR: {
-            uint32_t src1 = resolve_operand(cpu, instruction.operands[1], instruction.modes[1]);
-            uint32_t src2 = resolve_operand(cpu, instruction.operands[2], instruction.modes[2]);
-            cpu->registers[instruction.operands[0]] = src1 | src2;
-            break;
-        }
-        case XOR: {
-            uint32_t src1 = resolve_operand(cpu, instruction.operands[1], instruction.modes[1]);
-            uint32_t src2 = resolve_operand(cpu, instruction.operands[2], instruction.modes[2]);
-            cpu->registers[instruction.operands[0]] = src1 ^ src2;
-            break;
-        }
-        case NOT: {
-            uint32_t src = resolve_operand(cpu, instruction.operands[1], instruction.modes[1]);
-            cpu->registers[instruction.operands[0]] = ~src;
-            break;
-        }
+// Logical Operations
+static void exec_logical(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    uint32_t src1 = resolve_operand(cpu, instruction, 1);
+    if (instruction->opcode == NOT) {
+        write_register(cpu, instruction->operands[0], ~src1);
+        return;
+    }
+    uint32_t src2 = resolve_operand(cpu, instruction, 2);
+    switch (instruction->opcode) {
+        case AND: write_register(cpu, instruction->operands[0], src1 & src2); break;
+        case OR:  write_register(cpu, instruction->operands[0], src1 | src2); break;
+        default:  write_register(cpu, instruction->operands[0], src1 ^ src2); break;
+    }
+}
 
-        // Shift Operations
-        case SHL: {
-            uint32_t value = resolve_operand(cpu, instruction.operands[1], instruction.modes[1]);
-            uint32_t shift = instruction.operands[2];
-            cpu->registers[instruction.operands[0]] = value << shift;
-            break;
-        }
-        case SHR: {
-            uint32_t value = resolve_operand(cpu, instruction.operands[1], instruction.modes[1]);
-            uint32_t shift = instruction.operands[2];
-            cpu->registers[instruction.operands[0]] = value >> shift;
-            break;
-        }
+// Shift Operations
+static void exec_shift(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    uint32_t value = resolve_operand(cpu, instruction, 1);
+    uint32_t shift = instruction->operands[2];
+    write_register(cpu, instruction->operands[0], instruction->opcode == SHL ? value << shift : value >> shift);
+}
 
-        // Memory / Value Load
-        case LOAD: {
-            // For this ISA and assembler, operands for LOAD are encoded as values
-            // (immediates, register contents, or addresses) via resolve_operand.
-            // Use the resolved value directly instead of treating it as a memory address.
-            uint32_t value = resolve_operand(cpu, instruction.operands[1], instruction.modes[1]);
-            cpu->registers[instruction.operands[0]] = value;
-            break;
-        }
-        case STORE: {
-            uint32_t value = resolve_operand(cpu, instruction.operands[0], instruction.modes[0]);
-            uint32_t address = resolve_operand(cpu, instruction.operands[1], instruction.modes[1]);
-            write_memory(cpu->memory, address, value);
-            break;
-        }
+// Comparison Operations (result register = 1 if true, 0 otherwise)
+static void exec_compare(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    int32_t src1 = (int32_t)resolve_operand(cpu, instruction, 1);
+    int32_t src2 = (int32_t)resolve_operand(cpu, instruction, 2);
+    int32_t result;
+    switch (instruction->opcode) {
+        case EQ:  result = alu_eq(cpu, src1, src2); break;
+        case NEQ: result = alu_neq(cpu, src1, src2); break;
+        case GT:  result = alu_gt(cpu, src1, src2); break;
+        case LT:  result = alu_lt(cpu, src1, src2); break;
+        case GE:  result = alu_ge(cpu, src1, src2); break;
+        default:  result = alu_le(cpu, src1, src2); break;
+    }
+    write_register(cpu, instruction->operands[0], result);
+}
 
-        // Control Flow
-        case JUMP:{
-            cpu->pc = resolve_operand(cpu, instruction.operands[0], instruction.modes[0]);
-            break;}
+// Memory / Value Load
+static void exec_load(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    // The source is resolved by its addressing mode: an immediate by default,
+    // or a memory operand such as [addr] or [Rn+off]
+    write_register(cpu, instruction->operands[0], resolve_operand(cpu, instruction, 1));
+}
 
-        case JZ:{
-            if (cpu->flags.z) // Zero flag is set
-                cpu->pc = resolve_operand(cpu, instruction.operands[0], instruction.modes[0]);
-            break;}
+static void exec_store(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    uint32_t value = resolve_operand(cpu, instruction, 0);
+    uint32_t address = effective_address(cpu, instruction, 1);
+    write_memory(cpu, address, value);
+}
 
-        case JNZ:{
-            if (!cpu->flags.z) // Zero flag is not set
-                cpu->pc = resolve_operand(cpu, instruction.operands[0], instruction.modes[0]);
-            break;}
+// Control Flow
+static void exec_jump(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    if (instruction->opcode == JUMP ||
+        (instruction->opcode == JZ && cpu->flags.z) ||   // Zero flag is set
+        (instruction->opcode == JNZ && !cpu->flags.z)) { // Zero flag is not set
+        cpu->pc = resolve_operand(cpu, instruction, 0);
+    }
+}
 
+// Fused compare-and-branch (signed, flags unchanged)
+static void exec_branch(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    int32_t a = (int32_t)resolve_operand(cpu, instruction, 0);
+    int32_t b = (int32_t)resolve_operand(cpu, instruction, 1);
+    bool taken;
+    switch (instruction->opcode) {
+        case BEQ: taken = a == b; break;
+        case BNE: taken = a != b; break;
+        case BLT: taken = a < b; break;
+        case BGE: taken = a >= b; break;
+        case BGT: taken = a > b; break;
+        default:  taken = a <= b; break;
+    }
+    if (taken) {
+        cpu->pc = resolve_operand(cpu, instruction, 2);
+    }
+}
 
-        case CALL: {
-            printf("Function Call at PC: %08X\n", cpu->pc);
+static void exec_call(CPU *cpu, const Instruction *instruction, bool verbose) {
+    uint32_t target = resolve_operand(cpu, instruction, 0);
+    if (verbose) {
+        printf("Function Call at PC: %08X\n", cpu->pc);
 
-            // Log function call
-            log_function_call("recursive_function", call_depth++, params, param_count);
+        // Log function call
+        log_function_call(cpu, target, call_depth);
+    }
+    call_depth++;
 
-            // Push return address (next instruction) onto the stack
-            cpu->sp -= 4;
-            write_memory(cpu->memory, cpu->sp, cpu->pc + 4);
+    // Push return address (next instruction) onto the stack
+    cpu->sp -= 4;
+    write_memory(cpu, cpu->sp, cpu->pc + instruction->size);
 
-            // Display the updated stack
-            display_stack(cpu);
+    // Display the updated stack
+    if (verbose) {
+        display_stack(cpu);
+    }
 
-            // Jump to the function address
-            cpu->pc = resolve_operand(cpu, instruction.operands[0], instruction.modes[0]);
-            break;
-        }
+    // Jump to the function address
+    cpu->pc = target;
+}
 
-        case RET: {
-            printf("Returning from Function at PC: %08X\n", cpu->pc);
-            cpu->pc = read_memory(cpu->memory, cpu->sp); // Pop return address from the stack
-            cpu->sp += 4;
-            display_stack(cpu);
-            break;
-        }
+static void exec_ret(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)instruction;
+    if (verbose) {
+        printf("Returning from Function at PC: %08X\n", cpu->pc);
+    }
+    cpu->pc = read_data(cpu, cpu->sp); // Pop return address from the stack
+    cpu->sp += 4;
+    if (call_depth > 0) {
+        call_depth--;
+    }
+    if (verbose) {
+        display_stack(cpu);
+    }
+}
 
+// Stack Operations
+static void exec_push(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    cpu->sp -= 4;
+    write_memory(cpu, cpu->sp, resolve_operand(cpu, instruction, 0));
+}
 
-        // Stack Operations
-        case PUSH:{
-            cpu->sp -= 4;
-            write_memory(cpu->memory, cpu->sp, resolve_operand(cpu, instruction.operands[0], instruction.modes[0]));
-            break;}
-        case POP:{
-            cpu->registers[instruction.operands[0]] = read_memory(cpu->memory, cpu->sp);
-            cpu->sp += 4;
-            break;}
-
-        // System Operations
-        case HALT:{
-            printf("HALT instruction executed. Stopping CPU.\n");
-            cpu->halted = true;
-            break;}
-
-        case OUT: {
-            uint32_t reg_index = instruction.operands[0];
-            if (reg_index >= NUM_REGISTERS) {
-                fprintf(stderr, "Error: Invalid register index %u for OUT.\n", reg_index);
-                cpu->halted = true;
-            } else {
-                printf("OUT: R%d = %08X\n", reg_index, cpu->registers[reg_index]);
-            }
-            break;
+static void exec_pop(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    write_register(cpu, instruction->operands[0], read_data(cpu, cpu->sp));
+    cpu->sp += 4;
+}
+
+// System Operations
+static void exec_halt(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)instruction;
+    if (verbose) {
+        printf("HALT instruction executed. Stopping CPU.\n");
+    }
+    cpu->halted = true;
+}
+
+static void exec_out(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    uint32_t reg_index = instruction->operands[0];
+    if (reg_index >= NUM_REGISTERS) {
+        fprintf(stderr, "Error: Invalid register index %u for OUT.\n", reg_index);
+        cpu->halted = true;
+    } else {
+        printf("OUT: R%d = %08X\n", reg_index, cpu->registers[reg_index]);
+    }
+}
+
+static void exec_brk(CPU *cpu, const Instruction *instruction, bool verbose) {
+    // Breakpoints are intercepted by execute_cpu before dispatch
+    (void)cpu;
+    (void)instruction;
+    (void)verbose;
+}
+
+// Heap Operations
+static void exec_alloc(CPU *cpu, const Instruction *instruction, bool verbose) {
+    // ALLOC Rd, Rsize: Rd = address of a new heap block, or 0 (Z set) on failure
+    uint32_t size = resolve_operand(cpu, instruction, 1);
+    uint32_t address = heap_alloc(&cpu->heap, &cpu->heap_pointer, size);
+    write_register(cpu, instruction->operands[0], address);
+    cpu->flags.z = (address == 0);
+    if (verbose) {
+        printf("Allocated %u bytes at %08X\n", size, address);
+    }
+}
+
+static void exec_free(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    uint32_t address = resolve_operand(cpu, instruction, 0);
+    if (heap_free(&cpu->heap, address) != 0) {
+        fprintf(stderr, "Error: FREE of invalid heap address %08X.\n", address);
+        cpu->halted = true;
+    }
+}
+
+// Loop Control
+static void exec_djnz(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    uint32_t count = resolve_operand(cpu, instruction, 0) - 1;
+    write_register(cpu, instruction->operands[0], count);
+    if (count != 0) {
+        cpu->pc = resolve_operand(cpu, instruction, 1);
+    }
+}
+
+static void exec_loop(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    uint32_t count = resolve_operand(cpu, instruction, 0);
+    uint32_t start = cpu->pc + instruction->size;
+    uint32_t end = resolve_operand(cpu, instruction, 1);
+    if (end <= start) {
+        fprintf(stderr, "Error: LOOP end %08X does not follow its body at %08X.\n", end, start);
+        cpu->halted = true;
+        return;
+    }
+    if (count == 0) {
+        cpu->pc = end; // Zero iterations: skip the body
+        return;
+    }
+    if (cpu->loop_depth == LOOP_STACK_DEPTH) {
+        fprintf(stderr, "Error: Hardware loops nested deeper than %d at PC %08X.\n",
+                LOOP_STACK_DEPTH, cpu->pc);
+        cpu->halted = true;
+        return;
+    }
+    HardwareLoop *loop = &cpu->loop_stack[cpu->loop_depth++];
+    loop->start = start;
+    loop->end = end;
+    loop->count = count;
+}
+
+// Bulk Memory Operations
+static void exec_block(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    // MEMSET's second operand is the fill byte, not an address
+    uint32_t first = resolve_operand(cpu, instruction, 0);
+    uint32_t second = resolve_operand(cpu, instruction, 1);
+    uint32_t length = resolve_operand(cpu, instruction, 2);
+    bool second_is_address = instruction->opcode != MEMSET;
+
+    // Validate both ranges once, before touching memory
+    if (!block_in_segment(first, length) ||
+        (second_is_address && !block_in_segment(second, length))) {
+        bool first_bad = !block_in_segment(first, length);
+        uint32_t start = first_bad ? first : second;
+        const char *role = instruction->opcode == MEMCMP ? (first_bad ? "first" : "second")
+                         : (first_bad ? "destination" : "source");
+        fprintf(stderr, "Error: %s %s range %08X-%08X (%u bytes) leaves its segment at PC %08X.\n",
+                opcode_table[instruction->opcode].mnemonic, role, start, start + length - 1, length, cpu->pc);
+        cpu->halted = true;
+        return;
+    }
+    if (length == 0) {
+        if (instruction->opcode == MEMCMP) {
+            cpu->flags.z = 1;
+            cpu->flags.n = 0;
         }
+        return;
+    }
 
-        default:{
-            fprintf(stderr, "Error: Invalid opcode %02X\n", instruction.opcode);
-            cpu->halted = true;
-            break;}
+    if (instruction->opcode == MEMCPY) {
+        note_block_read(cpu, second, length);
+        memmove(&cpu->memory[first], &cpu->memory[second], length);
+        note_block_write(cpu, first, length);
+    } else if (instruction->opcode == MEMSET) {
+        memset(&cpu->memory[first], (int)(second & 0xFF), length);
+        note_block_write(cpu, first, length);
+    } else {
+        int result = memcmp(&cpu->memory[first], &cpu->memory[second], length);
+        note_block_read(cpu, first, length);
+        note_block_read(cpu, second, length);
+        cpu->flags.z = (result == 0);
+        cpu->flags.n = (result < 0);
     }
-}
\ No newline at end of file
+}
+
+// Vector Operations
+static void exec_vector_memory(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    uint32_t vreg = instruction->operands[0];
+    uint32_t address = effective_address(cpu, instruction, 1);
+    if (vreg >= NUM_VREGISTERS || !block_in_bounds(address, VECTOR_BYTES)) {
+        fprintf(stderr, "Error: Invalid vector access V%u at address %08X.\n", vreg, address);
+        cpu->halted = true;
+        return;
+    }
+    if (instruction->opcode == VLOAD) {
+        memcpy(cpu->vregisters[vreg].lanes, &cpu->memory[address], VECTOR_BYTES);
+        cpu->dirty_vregisters |= 1u << vreg;
+        note_block_read(cpu, address, VECTOR_BYTES);
+    } else {
+        memcpy(&cpu->memory[address], cpu->vregisters[vreg].lanes, VECTOR_BYTES);
+        note_block_write(cpu, address, VECTOR_BYTES);
+    }
+    cpu->vector_instructions++;
+}
+
+static void exec_vector(CPU *cpu, const Instruction *instruction, bool verbose) {
+    (void)verbose;
+    uint32_t d = instruction->operands[0], a = instruction->operands[1], b = instruction->operands[2];
+    if (d >= NUM_VREGISTERS || a >= NUM_VREGISTERS || b >= NUM_VREGISTERS) {
+        fprintf(stderr, "Error: Vector register index out of bounds.\n");
+        cpu->halted = true;
+        return;
+    }
+    VectorRegister *v = cpu->vregisters;
+    switch (instruction->opcode) {
+        case VADD: vector_add(&v[d], &v[a], &v[b]); break;
+        case VSUB: vector_sub(&v[d], &v[a], &v[b]); break;
+        case VMUL: vector_mul(&v[d], &v[a], &v[b]); break;
+        case VAND: vector_and(&v[d], &v[a], &v[b]); break;
+        case VOR:  vector_or(&v[d], &v[a], &v[b]); break;
+        case VXOR: vector_xor(&v[d], &v[a], &v[b]); break;
+        default:   cpu->flags.z = vector_cmpeq(&v[d], &v[a], &v[b]); break;
+    }
+    cpu->dirty_vregisters |= 1u << d;
+    cpu->vector_instructions++;
+}
+
+typedef void (*InstructionHandler)(CPU *cpu, const Instruction *instruction, bool verbose);
+
+#define ISA_HANDLER_ENTRY(opcode, count, kind0, kind1, kind2, handler) [opcode] = handler,
+
+static const InstructionHandler handlers[NUM_OPCODES] = {
+    ISA_OPCODES(ISA_HANDLER_ENTRY)
+};
+
+void execute_instruction(CPU *cpu, Instruction instruction) {
+    bool verbose = cpu->trace_mode != TRACE_NONE;
+    if (verbose) {
+        char text[64];
+        disassemble_instruction(&instruction, text, sizeof(text));
+        printf("Executing instruction: %s\n", text);
+    }
+
+    if (instruction.opcode >= NUM_OPCODES) {
+        fprintf(stderr, "Error: Invalid opcode %02X\n", instruction.opcode);
+        cpu->halted = true;
+        return;
+    }
+    handlers[instruction.opcode](cpu, &instruction, verbose);
+}
@@ -0,0 +1,54 @@
+#include "isa.h"
+#include <pthread.h>
+#include <string.h>
+
+#define ISA_TABLE_ENTRY(opcode, count, kind0, kind1, kind2, handler) \
+    [opcode] = { #opcode, count, { kind0, kind1, kind2 } },
+
+const OpcodeInfo opcode_table[NUM_OPCODES] = {
+    ISA_OPCODES(ISA_TABLE_ENTRY)
+};
+
+// Perfect hash over the mnemonics. OPCODE_SEED was found offline as the
+// first seed from the FNV offset basis for which every mnemonic lands in its
+// own slot; pick a new one when opcodes are added. The slots are filled once,
+// on first lookup (from any thread), with linear probing, so lookups stay
+// correct even if the seed no longer separates every mnemonic.
+#define OPCODE_HASH_SIZE 128
+#define OPCODE_SEED 0x811CEC39u
+
+_Static_assert(OPCODE_HASH_SIZE >= 2 * NUM_OPCODES, "Opcode hash table too small");
+
+static int8_t opcode_slots[OPCODE_HASH_SIZE];
+static pthread_once_t opcode_hash_once = PTHREAD_ONCE_INIT;
+
+static uint32_t mnemonic_hash(const char *mnemonic) {
+    uint32_t hash = OPCODE_SEED;
+    for (; *mnemonic; mnemonic++) {
+        hash = (hash ^ (uint8_t)*mnemonic) * 16777619u;
+    }
+    return (hash ^ (hash >> 15)) & (OPCODE_HASH_SIZE - 1);
+}
+
+static void build_opcode_hash(void) {
+    memset(opcode_slots, -1, sizeof(opcode_slots));
+    for (int op = 0; op < NUM_OPCODES; op++) {
+        uint32_t slot = mnemonic_hash(opcode_table[op].mnemonic);
+        while (opcode_slots[slot] >= 0) {
+            slot = (slot + 1) & (OPCODE_HASH_SIZE - 1);
+        }
+        opcode_slots[slot] = (int8_t)op;
+    }
+}
+
+int find_opcode(const char *mnemonic) {
+    pthread_once(&opcode_hash_once, build_opcode_hash);
+    for (uint32_t slot = mnemonic_hash(mnemonic); opcode_slots[slot] >= 0;
+         slot = (slot + 1) & (OPCODE_HASH_SIZE - 1)) {
+        int op = opcode_slots[slot];
+        if (strcmp(opcode_table[op].mnemonic, mnemonic) == 0) {
+            return op;
+        }
+    }
+    return -1;
+}
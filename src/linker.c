@@ -1,68 +1,41 @@
 #include "linker.h"
+#include "instructions.h" // literal_slot for the extended encoding
+#include "object.h"
+#include "asm_cache.h"
+#include "peephole.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
-// Opcode to binary mapping
+// Opcode to binary mapping (perfect-hash lookup in the descriptor table)
 uint8_t get_opcode_binary(const char *opcode) {
-    if (strcmp(opcode, "ADD") == 0) return 0x00;
-    if (strcmp(opcode, "SUB") == 0) return 0x01;
-    if (strcmp(opcode, "MUL") == 0) return 0x02;
-    if (strcmp(opcode, "DIV") == 0) return 0x03;
-    if (strcmp(opcode, "AND") == 0) return 0x04;
-    if (strcmp(opcode, "OR") == 0) return 0x05;
-    if (strcmp(opcode, "XOR") == 0) return 0x06;
-    if (strcmp(opcode, "NOT") == 0) return 0x07;
-    if (strcmp(opcode, "SHL") == 0) return 0x08;
-    if (strcmp(opcode, "SHR") == 0) return 0x09;
-    if (strcmp(opcode, "EQ") == 0) return 0x0A;
-    if (strcmp(opcode, "NEQ") == 0) return 0x0B;
-    if (strcmp(opcode, "GT") == 0) return 0x0C;
-    if (strcmp(opcode, "LT") == 0) return 0x0D;
-    if (strcmp(opcode, "GE") == 0) return 0x0E;
-    if (strcmp(opcode, "LE") == 0) return 0x0F;
-    if (strcmp(opcode, "LOAD") == 0) return 0x10;
-    if (strcmp(opcode, "STORE") == 0) return 0x11;
-    if (strcmp(opcode, "JUMP") == 0) return 0x12;
-    if (strcmp(opcode, "JZ") == 0) return 0x13;
-    if (strcmp(opcode, "JNZ") == 0) return 0x14;
-    if (strcmp(opcode, "CALL") == 0) return 0x15;
-    if (strcmp(opcode, "RET") == 0) return 0x16;
-    if (strcmp(opcode, "PUSH") == 0) return 0x17;
-    if (strcmp(opcode, "POP") == 0) return 0x18;
-    if (strcmp(opcode, "HALT") == 0) return 0x19;
-    if (strcmp(opcode, "OUT") == 0) return 0x1A;
-
+    int op = find_opcode(opcode);
+    if (op >= 0) {
+        return (uint8_t)op;
+    }
     fprintf(stderr, "Error: Unknown opcode '%s'.\n", opcode);
     exit(EXIT_FAILURE);
 }
 
-// Label handling
-typedef struct {
-    char label[32];
-    uint32_t address;
-} LabelEntry;
+// Label handling: each assembly owns a SymbolTable
 
-#define MAX_LABELS 100
-LabelEntry label_table[MAX_LABELS];
-int label_count = 0;
-
-void add_label(const char *label, uint32_t address) {
-    if (label_count >= MAX_LABELS) {
-        fprintf(stderr, "Error: Too many labels.\n");
-        exit(EXIT_FAILURE);
-    }
-    strcpy(label_table[label_count].label, label);
-    label_table[label_count].address = address;
-    label_count++;
+// Look up a label without failing; returns 0 if it is not (yet) defined
+static int find_label(const SymbolTable *symbols, const char *label, uint32_t *address) {
+    return symtab_lookup(symbols, label, address);
 }
 
-uint32_t resolve_label(const char *label) {
-    for (int i = 0; i < label_count; i++) {
-        if (strcmp(label_table[i].label, label) == 0) {
-            return label_table[i].address;
-        }
+static uint32_t resolve_label(const SymbolTable *symbols, const char *label) {
+    uint32_t address;
+    if (find_label(symbols, label, &address)) {
+        return address;
     }
     fprintf(stderr, "Error: Undefined label '%s'.\n", label);
     exit(EXIT_FAILURE);
@@ -81,21 +54,156 @@ static void trim_whitespace(char *s) {
     }
 }
 
-// Translate a single assembly line to binary
+// Parse "Rn"/"rn" (or "Vn"/"vn" vector) register syntax; returns the index,
+// or -1 if text is not a register name
+static int parse_register(const char *text) {
+    char prefix = (char)toupper((unsigned char)text[0]);
+    if ((prefix != 'R' && prefix != 'V') || !isdigit((unsigned char)text[1])) {
+        return -1;
+    }
+    char *end;
+    long index = strtol(text + 1, &end, 10);
+    if (*end != '\0') {
+        return -1; // e.g. a label such as "R2D2"
+    }
+    int limit = (prefix == 'R') ? NUM_REGISTERS : NUM_VREGISTERS;
+    if (index >= limit) {
+        fprintf(stderr, "Error: Register '%s' out of range (%c0-%c%d).\n", text, prefix, prefix, limit - 1);
+        exit(EXIT_FAILURE);
+    }
+    return (int)index;
+}
+
+// A parsed operand: its value, and the addressing mode the syntax asked for
+typedef struct {
+    uint32_t value;         // Register index, immediate, or address
+    AddressingMode mode;
+    int32_t displacement;   // INDEXED only
+    int explicit_mode;      // 0 for a bare number: keep the opcode's implicit mode
+    char forward[LABEL_NAME_MAX]; // Label not yet defined (value or displacement), or ""
+    int forward_sign;       // -1 when the forward label is a subtracted offset
+} ParsedOperand;
+
+// Value of a number or label. An undefined label is fatal unless forward is
+// given, in which case its name is copied there and the value is 0 until the
+// reference is patched.
+static uint32_t parse_value(const SymbolTable *symbols, const char *text, char *forward) {
+    // Without a symbol table (relocatable units) every label is left to the linker
+    uint32_t value = 0;
+    if (isalpha((unsigned char)text[0]) || text[0] == '_') {
+        if (!forward) {
+            return resolve_label(symbols, text);
+        }
+        if (!symbols || !find_label(symbols, text, &value)) {
+            snprintf(forward, LABEL_NAME_MAX, "%s", text);
+        }
+    } else {
+        sscanf(text, "%i", (int *)&value);
+    }
+    return value;
+}
+
+// Parse one operand:
+//   Rn / Vn     register            #value     immediate
+//   [addr]      memory              [[addr]]   memory indirect
+//   [Rn], [Rn+off], [Rn-off]        indexed
+//   value       the opcode's implicit mode (a label where a register is
+//               expected is taken as an immediate address)
+static ParsedOperand parse_operand(const SymbolTable *symbols, const char *source,
+                                   AddressingMode implicit_mode, int defer) {
+    ParsedOperand operand = { 0, implicit_mode, 0, 0, "", 1 };
+    char *forward = defer ? operand.forward : NULL;
+    char text[32];
+    snprintf(text, sizeof(text), "%s", source);
+    size_t len = strlen(text);
+    int reg = parse_register(text);
+
+    if (reg >= 0) {
+        operand.value = (uint32_t)reg;
+        operand.mode = REGISTER;
+        operand.explicit_mode = 1;
+    } else if (text[0] == '#') {
+        operand.value = parse_value(symbols, text + 1, forward);
+        operand.mode = IMMEDIATE;
+        operand.explicit_mode = 1;
+    } else if (text[0] == '[' && len >= 2 && text[len - 1] == ']') {
+        text[len - 1] = '\0';
+        char *inner = text + 1;
+        operand.explicit_mode = 1;
+        if (inner[0] == '[' && len >= 4 && inner[strlen(inner) - 1] == ']') {
+            inner[strlen(inner) - 1] = '\0';
+            operand.value = parse_value(symbols, inner + 1, forward);
+            operand.mode = INDIRECT;
+            return operand;
+        }
+
+        char *sign = strpbrk(inner, "+-");
+        char base[32];
+        snprintf(base, sizeof(base), "%.*s", (int)(sign ? (size_t)(sign - inner) : strlen(inner)), inner);
+        trim_whitespace(base);
+        reg = parse_register(base);
+        if (reg >= 0) {
+            operand.value = (uint32_t)reg;
+            operand.mode = INDEXED;
+            if (sign) {
+                char offset[32];
+                snprintf(offset, sizeof(offset), "%s", sign + 1);
+                trim_whitespace(offset);
+                int32_t displacement = (int32_t)parse_value(symbols, offset, forward);
+                operand.displacement = (*sign == '-') ? -displacement : displacement;
+                operand.forward_sign = (*sign == '-') ? -1 : 1;
+            }
+        } else {
+            trim_whitespace(inner);
+            operand.value = parse_value(symbols, inner, forward);
+            operand.mode = MEMORY;
+        }
+    } else if (isalpha((unsigned char)text[0]) || text[0] == '_') {
+        operand.value = parse_value(symbols, text, forward);
+        if (implicit_mode == REGISTER) {
+            operand.mode = IMMEDIATE;
+            operand.explicit_mode = 1;
+        }
+    } else {
+        operand.value = parse_value(symbols, text, forward);
+    }
+    return operand;
+}
+
+static Fixup *add_fixup(FixupList *fixups, const ParsedOperand *operand, size_t word,
+                        FixupKind kind, int shift) {
+    if (fixups->count == fixups->capacity) {
+        fixups->capacity = fixups->capacity ? fixups->capacity * 2 : 256;
+        fixups->items = realloc(fixups->items, fixups->capacity * sizeof(Fixup));
+        if (!fixups->items) {
+            fprintf(stderr, "Error: Out of memory for fixups.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    Fixup *fixup = &fixups->items[fixups->count++];
+    memcpy(fixup->label, operand->forward, sizeof(fixup->label));
+    fixup->word = fixups->base + word;
+    fixup->kind = (uint8_t)kind;
+    fixup->shift = (uint8_t)shift;
+    fixup->sign = (int8_t)operand->forward_sign;
+    fixup->section = SECTION_CODE;
+    fixup->line = fixups->line;
+    return fixup;
+}
 
-uint32_t translate_assembly_line_to_binary(const char *line) {
+// Encode a single assembly line. With a fixup list, labels that are not yet
+// defined (all labels, if symbols is NULL) are recorded for patching; without
+// one they are fatal.
+static int encode_line(const SymbolTable *symbols, const char *line, uint32_t *words, FixupList *fixups) {
     char opcode[16] = "";
     char operand1[32] = "", operand2[32] = "", operand3[32] = "";
-    int operands[3] = {0}; // Holds numeric values of operands
     int operand_count = 0; // Number of operands for the instruction
     uint32_t binary_instruction = 0;
 
-    // Debug print
-    printf("Processing line: %s\n", line);
-
     // Remove inline comments (everything after ';')
     char clean_line[256];
-    strncpy(clean_line, line, sizeof(clean_line));
+    strncpy(clean_line, line, sizeof(clean_line) - 1);
+    clean_line[sizeof(clean_line) - 1] = '\0';
     char *semicolon_pos = strchr(clean_line, ';');
     if (semicolon_pos) {
         *semicolon_pos = '\0'; // Truncate the line before the comment
@@ -105,161 +213,1642 @@ uint32_t translate_assembly_line_to_binary(const char *line) {
     // NOTE: Do NOT use strtok with space as a delimiter here, because that would
     // split off the opcode and discard the rest of the operands before sscanf runs.
     // Instead, let sscanf handle splitting on spaces and commas.
-    if (sscanf(clean_line, "%15s %31[^,], %31[^,], %31s", opcode, operand1, operand2, operand3) < 1) {
+    if (sscanf(clean_line, "%15s %31[^,], %31[^,], %31[^\n]", opcode, operand1, operand2, operand3) < 1) {
         fprintf(stderr, "Error: Failed to parse instruction line: '%s'\n", line);
         exit(EXIT_FAILURE);
     }
+    // Look up the opcode descriptor: encoding, operand count and operand kinds
+    Opcode op = (Opcode)get_opcode_binary(opcode);
+    const OpcodeInfo *info = &opcode_table[op];
+    operand_count = info->operand_count;
+    binary_instruction |= (uint32_t)op << 24;
+    char *operand_text[3] = {operand1, operand2, operand3};
+    if (operand_count < 3 && operand_text[operand_count][0] != '\0') {
+        fprintf(stderr, "Error: %s takes %d operand(s) in '%s'.\n", opcode, operand_count, line);
+        exit(EXIT_FAILURE);
+    }
 
-    // Match opcode to its binary value and determine expected operand count
-    if (strcmp(opcode, "ADD") == 0) {
-        binary_instruction |= 0x00 << 24;
-        operand_count = 3;
-    } else if (strcmp(opcode, "SUB") == 0) {
-        binary_instruction |= 0x01 << 24;
-        operand_count = 3;
-    } else if (strcmp(opcode, "MUL") == 0) {
-        binary_instruction |= 0x02 << 24;
-        operand_count = 3;
-    } else if (strcmp(opcode, "DIV") == 0) {
-        binary_instruction |= 0x03 << 24;
-        operand_count = 3;
-    } else if (strcmp(opcode, "AND") == 0) {
-        binary_instruction |= 0x04 << 24;
-        operand_count = 3;
-    } else if (strcmp(opcode, "OR") == 0) {
-        binary_instruction |= 0x05 << 24;
-        operand_count = 3;
-    } else if (strcmp(opcode, "XOR") == 0) {
-        binary_instruction |= 0x06 << 24;
-        operand_count = 3;
-    } else if (strcmp(opcode, "NOT") == 0) {
-        binary_instruction |= 0x07 << 24;
-        operand_count = 2;
-    } else if (strcmp(opcode, "SHL") == 0) {
-        binary_instruction |= 0x08 << 24;
-        operand_count = 3;
-    } else if (strcmp(opcode, "SHR") == 0) {
-        binary_instruction |= 0x09 << 24;
-        operand_count = 3;
-    } else if (strcmp(opcode, "LOAD") == 0) {
-        binary_instruction |= 0x10 << 24;
-        operand_count = 2;
-    } else if (strcmp(opcode, "STORE") == 0) {
-        binary_instruction |= 0x11 << 24;
-        operand_count = 2;
-    } else if (strcmp(opcode, "JUMP") == 0 || strcmp(opcode, "JZ") == 0 || strcmp(opcode, "JNZ") == 0) {
-        binary_instruction |= get_opcode_binary(opcode) << 24;
-        operand_count = 1;
-    } else if (strcmp(opcode, "CALL") == 0) {
-        binary_instruction |= 0x15 << 24;
-        operand_count = 1;
-    } else if (strcmp(opcode, "RET") == 0) {
-        binary_instruction |= 0x16 << 24;
-        operand_count = 0;
-    } else if (strcmp(opcode, "PUSH") == 0 || strcmp(opcode, "POP") == 0) {
-        binary_instruction |= get_opcode_binary(opcode) << 24;
-        operand_count = 1;
-    } else if (strcmp(opcode, "HALT") == 0) {
-        binary_instruction |= 0x19 << 24;
-        operand_count = 0;
-    } else if (strcmp(opcode, "OUT") == 0) {
-        binary_instruction |= 0x1A << 24;
-        operand_count = 1;
-    } else {
-        fprintf(stderr, "Error: Unknown opcode '%s'.\n", opcode);
+    // Parse operands against the opcode's implicit modes
+    Instruction implicit = decode_instruction(binary_instruction);
+    ParsedOperand operands[3] = {{0, REGISTER, 0, 0, "", 1}, {0, REGISTER, 0, 0, "", 1}, {0, REGISTER, 0, 0, "", 1}};
+    int needs_mode_word = 0;
+    int indexed_seen = 0;
+    int32_t displacement = 0;
+    for (int i = 0; i < operand_count; i++) {
+        trim_whitespace(operand_text[i]);
+        operands[i] = parse_operand(symbols, operand_text[i], implicit.modes[i], fixups != NULL);
+        if (operands[i].forward[0] && fixups->wide && operands[i].mode != INDEXED) {
+            operands[i].value = OPERAND_MAX + 1; // Placeholder: claims the literal word
+        }
+        if (operands[i].mode == implicit.modes[i]) {
+            continue;
+        }
+        // Destinations, vector registers and shift counts are raw register
+        // numbers and cannot take another addressing mode
+        if (!kind_takes_modes(info->kinds[i])) {
+            fprintf(stderr, "Error: Operand '%s' of %s must be a register in '%s'.\n", operand_text[i], opcode, line);
+            exit(EXIT_FAILURE);
+        }
+        if (operands[i].mode == INDEXED) {
+            if (indexed_seen && operands[i].displacement != displacement) {
+                fprintf(stderr, "Error: Indexed operands need the same offset in '%s'.\n", line);
+                exit(EXIT_FAILURE);
+            }
+            if (operands[i].displacement < INT16_MIN || operands[i].displacement > INT16_MAX) {
+                fprintf(stderr, "Error: Offset in '%s' does not fit in 16 bits.\n", operand_text[i]);
+                exit(EXIT_FAILURE);
+            }
+            indexed_seen = 1;
+            displacement = operands[i].displacement;
+        }
+        needs_mode_word = 1;
+    }
+
+    // Encode: each operand gets 8 bits; one wider value (the literal slot)
+    // moves into a trailing literal word and sets the X flag
+    int slot = -1;
+    for (int i = 0; i < operand_count; i++) {
+        if (operands[i].value > OPERAND_MAX) {
+            if (slot >= 0 || operands[i].mode == REGISTER || operands[i].mode == INDEXED) {
+                fprintf(stderr, "Error: Operand '%s' does not fit in 8 bits in '%s'.\n", operand_text[i], line);
+                exit(EXIT_FAILURE);
+            }
+            slot = i;
+        } else {
+            binary_instruction |= operands[i].value << (16 - 8 * i); // Operand i (8 bits)
+        }
+    }
+    if (slot >= 0 && slot != literal_slot(op)) {
+        needs_mode_word = 1; // Only the mode word can name another literal slot
+    }
+
+    int word_count = 1;
+    if (needs_mode_word) {
+        uint32_t mode_word = (uint32_t)(slot >= 0 ? slot : MODE_NO_SLOT) << MODE_SLOT_SHIFT;
+        for (int i = 0; i < 3; i++) {
+            AddressingMode mode = i < operand_count ? operands[i].mode : implicit.modes[i];
+            mode_word |= (uint32_t)mode << (i * MODE_FIELD_BITS);
+        }
+        mode_word |= (uint32_t)(uint16_t)displacement << MODE_DISP_SHIFT;
+        binary_instruction |= INSTR_MODES;
+        words[word_count++] = mode_word;
+    }
+    if (slot >= 0) {
+        binary_instruction |= INSTR_EXTENDED;
+        words[word_count++] = operands[slot].value;
+    }
+    words[0] = binary_instruction;
+
+    for (int i = 0; i < operand_count; i++) {
+        if (!operands[i].forward[0]) {
+            continue;
+        }
+        if (operands[i].mode == INDEXED) {
+            add_fixup(fixups, &operands[i], 1, FIXUP_DISPLACEMENT, MODE_DISP_SHIFT);
+        } else if (i == slot) {
+            add_fixup(fixups, &operands[i], word_count - 1, FIXUP_LITERAL, 0);
+        } else {
+            add_fixup(fixups, &operands[i], 0, FIXUP_FIELD, 16 - 8 * i);
+        }
+    }
+    return word_count;
+}
+
+static void free_assembly(Assembly *assembly) {
+    symtab_free(&assembly->symbols);
+    symtab_free(&assembly->data_symbols);
+    free(assembly->code);
+    free(assembly->data);
+    free(assembly->fixups.items);
+    memset(assembly, 0, sizeof(*assembly));
+}
+
+static void reserve_code(Assembly *assembly, size_t words) {
+    if (assembly->word_count + words <= assembly->capacity) {
+        return;
+    }
+    while (assembly->word_count + words > assembly->capacity) {
+        assembly->capacity = assembly->capacity ? assembly->capacity * 2 : 16384;
+    }
+    assembly->code = realloc(assembly->code, assembly->capacity * sizeof(uint32_t));
+    if (!assembly->code) {
+        fprintf(stderr, "Error: Out of memory for assembled code.\n");
         exit(EXIT_FAILURE);
     }
+}
 
-    // Parse and encode operands (simple encoding without explicit mode bits)
-    // Addressing modes are implicit based on instruction semantics
-    if (operand_count > 0) {
-        trim_whitespace(operand1);
-        if (isalpha((unsigned char)operand1[0])) {
-            operands[0] = resolve_label(operand1);
+static void reserve_data(Assembly *assembly, size_t bytes) {
+    if (assembly->data_size + bytes <= assembly->data_capacity) {
+        return;
+    }
+    while (assembly->data_size + bytes > assembly->data_capacity) {
+        assembly->data_capacity = assembly->data_capacity ? assembly->data_capacity * 2 : 256;
+    }
+    assembly->data = realloc(assembly->data, assembly->data_capacity);
+    if (!assembly->data) {
+        fprintf(stderr, "Error: Out of memory for assembled data.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void emit_data(Assembly *assembly, const void *bytes, size_t size) {
+    reserve_data(assembly, size);
+    memcpy(assembly->data + assembly->data_size, bytes, size);
+    assembly->data_size += size;
+}
+
+static void pad_data(Assembly *assembly, size_t size, uint8_t fill) {
+    reserve_data(assembly, size);
+    memset(assembly->data + assembly->data_size, fill, size);
+    assembly->data_size += size;
+}
+
+// Character after a backslash in a string or character literal
+static int unescape(char c) {
+    switch (c) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case '0': return '\0';
+        case '\\': case '\'': case '"': return c;
+        default: return -1;
+    }
+}
+
+// A number, or a character literal such as 'A' or '\n'
+static int parse_data_value(const char *text, int64_t *value) {
+    size_t length = strlen(text);
+    if (length >= 3 && text[0] == '\'' && text[length - 1] == '\'') {
+        int c = length == 3 ? (unsigned char)text[1] : (length == 4 && text[1] == '\\') ? unescape(text[2]) : -1;
+        *value = c;
+        return c < 0 ? -1 : 0;
+    }
+    char *end;
+    *value = strtoll(text, &end, 0);
+    return (end == text || *end != '\0') ? -1 : 0;
+}
+
+// Split a directive's operands at commas, trimming each one
+static int split_operands(char *text, char **operands, int max) {
+    int count = 0;
+    for (char *item = text; item && count < max; ) {
+        char *comma = strchr(item, ',');
+        if (comma) {
+            *comma = '\0';
+        }
+        trim_whitespace(item);
+        operands[count++] = item;
+        item = comma ? comma + 1 : NULL;
+    }
+    return count;
+}
+
+// Assemble a directive: .text and .data select the section; .word, .byte,
+// .string, .space and .align emit initialized data into .data
+static int assemble_directive(Assembly *assembly, const char *filename, char *text) {
+    // Drop a trailing comment, but not a ';' inside a string or character
+    char quote = 0;
+    for (char *p = text; *p; p++) {
+        if (quote && *p == '\\' && p[1]) {
+            p++;
+        } else if (*p == '"' || *p == '\'') {
+            quote = quote == *p ? 0 : quote ? quote : *p;
+        } else if (*p == ';' && !quote) {
+            *p = '\0';
+            break;
+        }
+    }
+    size_t length = strcspn(text, " \t\r");
+    char name[16];
+    snprintf(name, sizeof(name), "%.*s", (int)(length < sizeof(name) ? length : sizeof(name) - 1), text);
+    char *arguments = text + length;
+    trim_whitespace(arguments);
+
+    int text_section = strcmp(name, ".text") == 0;
+    if (text_section || strcmp(name, ".data") == 0) {
+        if (*arguments) {
+            fprintf(stderr, "Error: %s takes no operands (%s line %u).\n", name, filename, assembly->lines);
+            return -1;
+        }
+        assembly->in_data = !text_section;
+        return 0;
+    }
+    if (strcmp(name, ".word") != 0 && strcmp(name, ".byte") != 0 && strcmp(name, ".string") != 0 &&
+        strcmp(name, ".space") != 0 && strcmp(name, ".align") != 0) {
+        fprintf(stderr, "Error: Unknown directive '%s' (%s line %u).\n", name, filename, assembly->lines);
+        return -1;
+    }
+    if (!assembly->in_data) {
+        fprintf(stderr, "Error: %s outside a .data section (%s line %u).\n", name, filename, assembly->lines);
+        return -1;
+    }
+
+    if (strcmp(name, ".string") == 0) {
+        size_t size = strlen(arguments);
+        if (size < 2 || arguments[0] != '"' || arguments[size - 1] != '"') {
+            fprintf(stderr, "Error: .string needs a quoted string (%s line %u).\n", filename, assembly->lines);
+            return -1;
+        }
+        for (size_t i = 1; i < size - 1; i++) {
+            int c = (unsigned char)arguments[i];
+            if (c == '\\') {
+                c = i + 1 < size - 1 ? unescape(arguments[++i]) : -1;
+            }
+            if (c < 0) {
+                fprintf(stderr, "Error: Bad escape in .string (%s line %u).\n", filename, assembly->lines);
+                return -1;
+            }
+            uint8_t byte = (uint8_t)c;
+            emit_data(assembly, &byte, 1);
+        }
+        pad_data(assembly, 1, 0); // NUL terminator
+        return 0;
+    }
+
+    char *operands[128]; // A line holds at most 128 comma-separated values
+    int count = *arguments ? split_operands(arguments, operands, (int)(sizeof(operands) / sizeof(operands[0]))) : 0;
+    int64_t values[2] = { 0, 0 };
+    if (strcmp(name, ".space") == 0 || strcmp(name, ".align") == 0) {
+        int max = name[1] == 's' ? 2 : 1;
+        for (int i = 0; i < count && i < max; i++) {
+            if (parse_data_value(operands[i], &values[i]) != 0) {
+                count = 0;
+            }
+        }
+        if (count < 1 || count > max || values[0] < 0 || values[0] > UINT16_MAX ||
+            (name[1] == 'a' && (values[0] == 0 || (values[0] & (values[0] - 1)) != 0))) {
+            fprintf(stderr, "Error: %s needs %s (%s line %u).\n", name,
+                    name[1] == 's' ? "a size and an optional fill byte" : "a power-of-two alignment",
+                    filename, assembly->lines);
+            return -1;
+        }
+        size_t size = name[1] == 's' ? (size_t)values[0]
+                                     : (size_t)((values[0] - (int64_t)(assembly->data_size % (size_t)values[0])) % values[0]);
+        pad_data(assembly, size, (uint8_t)values[1]);
+        return 0;
+    }
+
+    // .word and .byte: one value per operand; .word also takes labels
+    if (count == 0) {
+        fprintf(stderr, "Error: %s needs at least one value (%s line %u).\n", name, filename, assembly->lines);
+        return -1;
+    }
+    int word = name[1] == 'w';
+    for (int i = 0; i < count; i++) {
+        int64_t value;
+        if (word && (isalpha((unsigned char)operands[i][0]) || operands[i][0] == '_')) {
+            if (strlen(operands[i]) >= LABEL_NAME_MAX) {
+                fprintf(stderr, "Error: Label name too long: '%s' (%s line %u).\n", operands[i], filename, assembly->lines);
+                return -1;
+            }
+            if (assembly->data_size % sizeof(uint32_t) != 0) {
+                fprintf(stderr, "Error: .word '%s' is not 4-byte aligned; add .align 4 (%s line %u).\n",
+                        operands[i], filename, assembly->lines);
+                return -1;
+            }
+            ParsedOperand operand = { 0, IMMEDIATE, 0, 0, "", 1 };
+            snprintf(operand.forward, sizeof(operand.forward), "%s", operands[i]);
+            assembly->fixups.base = 0;
+            assembly->fixups.line = assembly->lines;
+            Fixup *fixup = add_fixup(&assembly->fixups, &operand, assembly->data_size / sizeof(uint32_t),
+                                     FIXUP_LITERAL, 0);
+            fixup->section = SECTION_DATA;
+            value = 0;
+        } else if (parse_data_value(operands[i], &value) != 0 ||
+                   value < (word ? INT32_MIN : INT8_MIN) || value > (word ? (int64_t)UINT32_MAX : UINT8_MAX)) {
+            fprintf(stderr, "Error: Bad %s value '%s' (%s line %u).\n", name, operands[i], filename, assembly->lines);
+            return -1;
+        }
+        if (word) {
+            uint32_t bits = (uint32_t)value;
+            emit_data(assembly, &bits, sizeof(bits));
         } else {
-            sscanf(operand1, "%d", &operands[0]);
+            uint8_t bits = (uint8_t)value;
+            emit_data(assembly, &bits, 1);
+        }
+    }
+    return 0;
+}
+
+// Define a label at the current position of the current section. An
+// executable also enters data labels in its code table, at their load
+// addresses, so instructions can refer to them directly.
+static int define_label(Assembly *assembly, const char *filename, const char *name) {
+    uint32_t existing;
+    int duplicate;
+    if (assembly->in_data) {
+        uint32_t offset = (uint32_t)assembly->data_size;
+        duplicate = symtab_define(&assembly->data_symbols, name, offset) != 0 ||
+                    (assembly->relocatable ? find_label(&assembly->symbols, name, &existing)
+                                           : symtab_define(&assembly->symbols, name, DATA_START + offset) != 0);
+    } else {
+        duplicate = symtab_define(&assembly->symbols, name, (uint32_t)(assembly->word_count * sizeof(uint32_t))) != 0 ||
+                    find_label(&assembly->data_symbols, name, &existing);
+    }
+    if (duplicate) {
+        fprintf(stderr, "Error: Label '%s' is defined more than once (%s line %u).\n", name, filename, assembly->lines);
+        return -1;
+    }
+    return 0;
+}
+
+// Assemble one line: an optional "label:" followed by an optional instruction
+// or directive
+static int assemble_line(Assembly *assembly, const char *filename, char *line) {
+    char *text = line;
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    if (*text == '\0' || *text == ';') {
+        return 0; // Blank line or comment
+    }
+
+    size_t token = strcspn(text, " \t\r;");
+    char *colon = memchr(text, ':', token);
+    if (colon) {
+        *colon = '\0';
+        if (define_label(assembly, filename, text) != 0) {
+            return -1;
+        }
+        text = colon + 1;
+        while (isspace((unsigned char)*text)) {
+            text++;
+        }
+        if (*text == '\0' || *text == ';') {
+            return 0;
+        }
+    }
+    if (*text == '.') {
+        return assemble_directive(assembly, filename, text);
+    }
+    if (assembly->in_data) {
+        fprintf(stderr, "Error: Instruction in the .data section (%s line %u).\n", filename, assembly->lines);
+        return -1;
+    }
+
+    reserve_code(assembly, MAX_INSTRUCTION_WORDS);
+    assembly->fixups.base = assembly->word_count;
+    assembly->fixups.line = assembly->lines;
+    assembly->word_count += encode_line(assembly->relocatable ? NULL : &assembly->symbols, text,
+                                        &assembly->code[assembly->word_count], &assembly->fixups);
+    return 0;
+}
+
+// Patch one reference with the value of its label
+static int patch_fixup(uint32_t *code, const Fixup *fixup, uint32_t value, const char *filename) {
+    uint32_t *word = &code[fixup->word];
+    if (fixup->kind == FIXUP_LITERAL) {
+        *word = value;
+    } else if (fixup->kind == FIXUP_FIELD) {
+        *word |= value << fixup->shift; // Fits: see narrow_fixups_pending and apply_fixups
+    } else {
+        int32_t displacement = fixup->sign * (int32_t)value;
+        if (displacement < INT16_MIN || displacement > INT16_MAX) {
+            fprintf(stderr, "Error: Offset '%s' does not fit in 16 bits (%s line %u).\n",
+                    fixup->label, filename, fixup->line);
+            return -1;
+        }
+        *word = (*word & 0xFFFFu) | (uint32_t)(uint16_t)displacement << MODE_DISP_SHIFT;
+    }
+    return 0;
+}
+
+// Patch forward references once every label is known. Returns 1 if an 8-bit
+// operand field was given to a label that turned out not to fit (data defined
+// after the code that uses it), so the caller can start again with wide set.
+static int apply_fixups(Assembly *assembly, const char *filename) {
+    for (size_t i = 0; i < assembly->fixups.count; i++) {
+        const Fixup *fixup = &assembly->fixups.items[i];
+        uint32_t value;
+        if (!find_label(&assembly->symbols, fixup->label, &value)) {
+            fprintf(stderr, "Error: Undefined label '%s' (%s line %u).\n", fixup->label, filename, fixup->line);
+            return -1;
+        }
+        if (fixup->kind == FIXUP_FIELD && value > OPERAND_MAX) {
+            return 1;
+        }
+        uint32_t *words = fixup->section == SECTION_DATA ? (uint32_t *)assembly->data : assembly->code;
+        if (patch_fixup(words, fixup, value, filename) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Whether an 8-bit operand field still waits for a label. Once the code has
+// grown past OPERAND_MAX, such a label can only land above it.
+static int narrow_fixups_pending(const Assembly *assembly) {
+    uint32_t address;
+    for (size_t i = 0; i < assembly->fixups.count; i++) {
+        const Fixup *fixup = &assembly->fixups.items[i];
+        if (fixup->kind == FIXUP_FIELD && !find_label(&assembly->symbols, fixup->label, &address)) {
+            return 1;
         }
-        binary_instruction |= (operands[0] & 0xFF) << 16;  // Operand 0 (8 bits)
     }
+    return 0;
+}
+
+static void init_assembly(Assembly *assembly, int wide, int relocatable) {
+    memset(assembly, 0, sizeof(*assembly));
+    symtab_init(&assembly->symbols);
+    symtab_init(&assembly->data_symbols);
+    assembly->relocatable = relocatable;
+    assembly->fixups.wide = wide || relocatable;
+}
+
+// Assemble source lines in order, numbering them from assembly->lines + 1
+static int assemble_lines(Assembly *assembly, const char *source, size_t size, const char *filename) {
+    char line[256];
+    const char *end = source + size;
+    for (const char *p = source; p < end; ) {
+        const char *newline = memchr(p, '\n', (size_t)(end - p));
+        size_t length = (size_t)((newline ? newline : end) - p);
+        assembly->lines++;
+        if (length >= sizeof(line)) {
+            fprintf(stderr, "Error: Line %u of %s is longer than %zu characters.\n",
+                    assembly->lines, filename, sizeof(line) - 1);
+            return -1;
+        }
+        memcpy(line, p, length);
+        line[length] = '\0';
+        if (assemble_line(assembly, filename, line) != 0) {
+            return -1;
+        }
+        p += length + 1;
+
+        if (!assembly->fixups.wide && assembly->word_count * sizeof(uint32_t) > OPERAND_MAX) {
+            if (narrow_fixups_pending(assembly)) {
+                return 1;
+            }
+            assembly->fixups.wide = 1;
+        }
+    }
+    return 0;
+}
 
-    if (operand_count > 1) {
-        trim_whitespace(operand2);
-        if (isalpha((unsigned char)operand2[0])) {
-            operands[1] = resolve_label(operand2);
+// Assemble a whole source buffer in a single pass. Code is emitted as each
+// line is read; references to labels defined later become fixups.
+//
+// Forward references get an 8-bit operand field while the code still fits
+// below OPERAND_MAX (as all code in the CPU's code segment does) and a literal
+// word after that. If the code outgrows 8 bits while an 8-bit reference is
+// still unresolved, returns 1 so the caller can start again with wide set,
+// giving every forward reference a literal word. Relocatable units are always
+// wide and keep their fixups as relocations.
+static int assemble_source(const char *source, size_t size, const char *filename,
+                           int wide, int relocatable, Assembly *assembly) {
+    init_assembly(assembly, wide, relocatable);
+    int status = assemble_lines(assembly, source, size, filename);
+    if (status != 0) {
+        return status;
+    }
+    return relocatable ? 0 : apply_fixups(assembly, filename);
+}
+
+// Run a worker on up to one thread per CPU (and at most tasks threads). The
+// workers share the job and take tasks from it until none are left.
+static void run_workers(void *(*worker)(void *), void *job, int tasks) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = tasks < cpus ? tasks : (int)(cpus > 0 ? cpus : 1);
+    pthread_t *threads = malloc(workers * sizeof(pthread_t));
+    int started = 0;
+    while (threads && started < workers && pthread_create(&threads[started], NULL, worker, job) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        worker(job); // No threads available: run on this one
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+}
+
+// Parallel assembly of one large source: the text is split at line
+// boundaries, each chunk is assembled on a worker as a relocatable unit (every
+// label reference a fixup), the chunks' labels are merged in order, and the
+// references are patched by the workers in a final pass
+
+typedef struct {
+    const char *source;
+    size_t size;
+    uint32_t lines;      // Lines in the chunk
+    uint32_t base;       // Byte offset of its code in the merged assembly
+    Assembly unit;
+} SourceChunk;
+
+typedef enum {
+    CHUNK_COUNT_LINES,   // Number lines, so errors name the right one
+    CHUNK_ASSEMBLE,
+    CHUNK_PATCH          // Resolve references against the merged labels
+} ChunkPhase;
+
+typedef struct {
+    SourceChunk *chunks;
+    int count;
+    ChunkPhase phase;
+    const char *filename;
+    const Assembly *merged;
+    uint32_t *code;      // Merged code, for CHUNK_PATCH
+    atomic_int next;
+    atomic_int failed;
+} ChunkJob;
+
+static void *chunk_worker(void *arg) {
+    ChunkJob *job = arg;
+    int index;
+    while ((index = atomic_fetch_add(&job->next, 1)) < job->count) {
+        SourceChunk *chunk = &job->chunks[index];
+        int status = 0;
+        if (job->phase == CHUNK_COUNT_LINES) {
+            const char *end = chunk->source + chunk->size;
+            for (const char *p = chunk->source; p < end; p++) {
+                p = memchr(p, '\n', (size_t)(end - p));
+                if (!p) {
+                    break;
+                }
+                chunk->lines++;
+            }
+        } else if (job->phase == CHUNK_ASSEMBLE) {
+            status = assemble_lines(&chunk->unit, chunk->source, chunk->size, job->filename);
         } else {
-            sscanf(operand2, "%d", &operands[1]);
+            uint32_t *code = job->code + chunk->base / sizeof(uint32_t);
+            for (size_t f = 0; f < chunk->unit.fixups.count && status == 0; f++) {
+                const Fixup *fixup = &chunk->unit.fixups.items[f];
+                uint32_t value;
+                if (!find_label(&job->merged->symbols, fixup->label, &value)) {
+                    fprintf(stderr, "Error: Undefined label '%s' (%s line %u).\n",
+                            fixup->label, job->filename, fixup->line);
+                    status = -1;
+                } else {
+                    status = patch_fixup(code, fixup, value, job->filename);
+                }
+            }
+        }
+        if (status != 0) {
+            atomic_store(&job->failed, 1);
         }
-        binary_instruction |= (operands[1] & 0xFF) << 8;    // Operand 1 (8 bits)
     }
+    return NULL;
+}
+
+static int run_chunk_phase(ChunkJob *job, ChunkPhase phase) {
+    job->phase = phase;
+    atomic_store(&job->next, 0);
+    run_workers(chunk_worker, job, job->count);
+    return atomic_load(&job->failed) ? -1 : 0;
+}
 
-    if (operand_count > 2) {
-        trim_whitespace(operand3);
-        if (isalpha((unsigned char)operand3[0])) {
-            operands[2] = resolve_label(operand3);
+// Concatenate the chunks' code and labels; a relocatable result also takes
+// their fixups, moved to the merged positions
+static int merge_chunks(ChunkJob *job, int relocatable, Assembly *merged) {
+    size_t total = 0;
+    for (int i = 0; i < job->count; i++) {
+        job->chunks[i].base = (uint32_t)(total * sizeof(uint32_t));
+        total += job->chunks[i].unit.word_count;
+    }
+    init_assembly(merged, 1, relocatable);
+    reserve_code(merged, total);
+    for (int i = 0; i < job->count; i++) {
+        const SourceChunk *chunk = &job->chunks[i];
+        const Assembly *unit = &chunk->unit;
+        if (unit->word_count > 0) {
+            memcpy(merged->code + merged->word_count, unit->code, unit->word_count * sizeof(uint32_t));
+        }
+        merged->word_count += unit->word_count;
+        merged->lines += chunk->lines;
+        for (uint32_t slot = 0; slot < unit->symbols.capacity; slot++) {
+            const SymbolEntry *entry = &unit->symbols.entries[slot];
+            const char *name = symtab_entry_name(&unit->symbols, entry);
+            if (entry->hash != 0 && symtab_define(&merged->symbols, name, chunk->base + entry->address) != 0) {
+                fprintf(stderr, "Error: Label '%s' is defined more than once in %s.\n", name, job->filename);
+                return -1;
+            }
+        }
+        for (size_t f = 0; relocatable && f < unit->fixups.count; f++) {
+            const Fixup *fixup = &unit->fixups.items[f];
+            ParsedOperand operand = { 0, REGISTER, 0, 0, "", fixup->sign };
+            memcpy(operand.forward, fixup->label, sizeof(operand.forward));
+            merged->fixups.base = chunk->base / sizeof(uint32_t);
+            merged->fixups.line = fixup->line;
+            add_fixup(&merged->fixups, &operand, fixup->word, (FixupKind)fixup->kind, fixup->shift);
+        }
+    }
+    return 0;
+}
+
+// Whether ".data" appears anywhere in the source (comments included)
+static int mentions_data(const char *source, size_t size) {
+    const char *end = source + size;
+    for (const char *p = source; (p = memchr(p, '.', (size_t)(end - p))) != NULL; p++) {
+        if ((size_t)(end - p) >= 5 && memcmp(p, ".data", 5) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int assemble_parallel(const char *source, size_t size, const char *filename,
+                             int relocatable, Assembly *assembly) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t count = (size_t)(cpus > 0 ? cpus : 1) * PARALLEL_ASSEMBLY_CHUNKS_PER_CPU;
+    if (count > size / PARALLEL_ASSEMBLY_CHUNK_MIN) {
+        count = size / PARALLEL_ASSEMBLY_CHUNK_MIN;
+    }
+    ChunkJob job = { .chunks = calloc(count, sizeof(SourceChunk)), .filename = filename };
+    if (!job.chunks) {
+        fprintf(stderr, "Error: Out of memory assembling '%s'.\n", filename);
+        return -1;
+    }
+    atomic_init(&job.failed, 0);
+
+    // Cut at the first line break after each even share of the text
+    const char *end = source + size;
+    const char *start = source;
+    for (size_t i = 0; i < count && start < end; i++) {
+        const char *cut = i + 1 == count ? end : source + size / count * (i + 1);
+        if (cut < start) {
+            cut = start;
+        }
+        const char *newline = cut < end ? memchr(cut, '\n', (size_t)(end - cut)) : NULL;
+        cut = (i + 1 == count || !newline) ? end : newline + 1;
+        job.chunks[job.count].source = start;
+        job.chunks[job.count].size = (size_t)(cut - start);
+        init_assembly(&job.chunks[job.count].unit, 1, 1);
+        job.count++;
+        start = cut;
+    }
+
+    int status = run_chunk_phase(&job, CHUNK_COUNT_LINES);
+    uint32_t line = 0;
+    for (int i = 0; i < job.count; i++) {
+        job.chunks[i].unit.lines = line; // assemble_lines numbers from here
+        line += job.chunks[i].lines;
+    }
+    if (status == 0) {
+        status = run_chunk_phase(&job, CHUNK_ASSEMBLE);
+    }
+    if (status == 0) {
+        status = merge_chunks(&job, relocatable, assembly);
+    }
+    if (status == 0 && !relocatable) {
+        job.merged = assembly;
+        job.code = assembly->code;
+        status = run_chunk_phase(&job, CHUNK_PATCH);
+    }
+    for (int i = 0; i < job.count; i++) {
+        free_assembly(&job.chunks[i].unit);
+    }
+    free(job.chunks);
+    if (status == 0) {
+        assembly->lines = line + (size > 0 && source[size - 1] != '\n'); // A last line without a newline counts
+    }
+    return status;
+}
+
+// Assemble source text, optionally through the peephole optimizer
+static int assemble_text(const char *source, size_t size, const char *filename, int relocatable, int optimize,
+                         Assembly *assembly) {
+    const char *input = source;
+    size_t input_size = size;
+    char *optimized = NULL;
+    if (optimize) {
+        PeepholeStats stats;
+        optimized = peephole_optimize(source, size, &input_size, &stats);
+        if (optimized) {
+            input = optimized;
+            printf("Peephole: removed %u of %u instructions, rewrote %u\n",
+                   stats.removed, stats.instructions, stats.rewritten);
         } else {
-            sscanf(operand3, "%d", &operands[2]);
+            input_size = size; // Unoptimizable (overlong line): the assembler reports it
         }
-        binary_instruction |= (operands[2] & 0xFF);          // Operand 2 (8 bits)
     }
 
-    // Debug print the parsed result
-    printf("Opcode: %s, Operand1: %s, Operand2: %s, Operand3: %s\n",
-           opcode, operand1, operand2, operand3);
-    printf("Binary Instruction: %08X\n", binary_instruction);
+    // Large sources are assembled in chunks on every core. Data layout depends
+    // on everything before it (.align), so sources with data stay serial.
+    int status;
+    if (input_size >= PARALLEL_ASSEMBLY_MIN && !mentions_data(input, input_size)) {
+        status = assemble_parallel(input, input_size, filename, relocatable, assembly);
+    } else {
+        status = assemble_source(input, input_size, filename, 0, relocatable, assembly);
+    }
+    if (status == 1) {
+        free_assembly(assembly);
+        status = assemble_source(input, input_size, filename, 1, relocatable, assembly);
+    }
+    free(optimized);
+    if (status != 0) {
+        free_assembly(assembly);
+        return -1;
+    }
+    return 0;
+}
 
-    return binary_instruction;
+// Map a source file and assemble it, optionally through the peephole optimizer
+static int assemble_file(const char *asm_file, int relocatable, int optimize, Assembly *assembly) {
+    memset(assembly, 0, sizeof(*assembly));
+    int fd = open(asm_file, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Error: Cannot open file '%s'.\n", asm_file);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    size_t size = (size_t)info.st_size;
+    const char *source = "";
+    if (size > 0) {
+        source = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (source == MAP_FAILED) {
+            fprintf(stderr, "Error: Cannot map file '%s'.\n", asm_file);
+            close(fd);
+            return -1;
+        }
+        madvise((void *)source, size, MADV_SEQUENTIAL);
+    }
+
+    int status = assemble_text(source, size, asm_file, relocatable, optimize, assembly);
+    if (size > 0) {
+        munmap((void *)source, size);
+    }
+    close(fd);
+    return status;
+}
+
+// A symbol at its final address. Symbol tables are listed by address, then
+// name, so the output does not depend on hash-table layout.
+typedef struct {
+    uint32_t address;
+    const char *name;
+    int file;
+} MapSymbol;
+
+static int compare_map_symbols(const void *a, const void *b) {
+    const MapSymbol *x = a, *y = b;
+    if (x->address != y->address) {
+        return x->address < y->address ? -1 : 1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+// Symbols, names and relocations collected for an object file
+typedef struct {
+    ObjectSymbol *symbols;
+    uint32_t symbol_count;
+    uint32_t symbol_capacity;
+    char *strings;
+    uint32_t string_size;
+    uint32_t string_capacity;
+    ObjectReloc *relocs;
+    uint32_t reloc_count;
+    uint32_t reloc_capacity;
+    SymbolTable index;   // Name -> symbol index, for relocations
+} ObjectBuilder;
+
+static void *grow_array(void *items, uint32_t *capacity, uint32_t needed, size_t item_size) {
+    if (needed <= *capacity) {
+        return items;
+    }
+    while (*capacity < needed) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+    }
+    items = realloc(items, (size_t)*capacity * item_size);
+    if (!items) {
+        fprintf(stderr, "Error: Out of memory building an object file.\n");
+        exit(EXIT_FAILURE);
+    }
+    return items;
+}
+
+static uint32_t add_object_symbol(ObjectBuilder *builder, const char *name, uint32_t value, uint8_t section) {
+    uint32_t length = (uint32_t)strlen(name) + 1;
+    builder->strings = grow_array(builder->strings, &builder->string_capacity,
+                                  builder->string_size + length, 1);
+    memcpy(builder->strings + builder->string_size, name, length);
+
+    builder->symbols = grow_array(builder->symbols, &builder->symbol_capacity,
+                                  builder->symbol_count + 1, sizeof(ObjectSymbol));
+    ObjectSymbol *symbol = &builder->symbols[builder->symbol_count];
+    memset(symbol, 0, sizeof(*symbol));
+    symbol->name = builder->string_size;
+    symbol->value = value;
+    symbol->section = section;
+    builder->string_size += length;
+    symtab_define(&builder->index, name, builder->symbol_count); // First definition wins
+    return builder->symbol_count++;
+}
+
+// Add every label of a symbol table, offset by base, in address order.
+// Names listed in skip (an executable's data labels, which its code table
+// also holds) are left out.
+static void add_object_symbols(ObjectBuilder *builder, const SymbolTable *symbols, uint32_t base,
+                               uint8_t section, const SymbolTable *skip) {
+    MapSymbol *sorted = malloc((symbols->count + 1) * sizeof(MapSymbol));
+    if (!sorted) {
+        fprintf(stderr, "Error: Out of memory building an object file.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t count = 0;
+    uint32_t address;
+    for (uint32_t slot = 0; slot < symbols->capacity; slot++) {
+        const SymbolEntry *entry = &symbols->entries[slot];
+        const char *name = symtab_entry_name(symbols, entry);
+        if (entry->hash != 0 && !(skip && find_label(skip, name, &address))) {
+            sorted[count++] = (MapSymbol){ base + entry->address, name, 0 };
+        }
+    }
+    qsort(sorted, count, sizeof(MapSymbol), compare_map_symbols);
+    for (size_t i = 0; i < count; i++) {
+        add_object_symbol(builder, sorted[i].name, sorted[i].address, section);
+    }
+    free(sorted);
+}
+
+static void free_object_builder(ObjectBuilder *builder) {
+    free(builder->symbols);
+    free(builder->strings);
+    free(builder->relocs);
+    symtab_free(&builder->index);
 }
 
+// Describe code, data and the collected tables as an object; the object
+// points at them rather than copying them
+static void fill_object(ObjectFile *object, ObjectType type, const uint32_t *code, size_t word_count,
+                        const uint8_t *data, size_t data_size, uint32_t entry, const ObjectBuilder *builder) {
+    uint32_t code_base = type == OBJ_EXECUTABLE ? CODE_START : 0;
+    uint32_t data_base = type == OBJ_EXECUTABLE ? DATA_START : 0;
+    memset(object, 0, sizeof(*object));
+    object->header.type = (uint16_t)type;
+    object->header.entry = entry;
+    object->header.sections[SECTION_CODE].address = code_base;
+    object->header.sections[SECTION_CODE].size = (uint32_t)(word_count * sizeof(uint32_t));
+    object->header.sections[SECTION_DATA].address = data_base;
+    object->header.sections[SECTION_DATA].size = (uint32_t)data_size;
+    object->header.sections[SECTION_BSS].address = data_base + (uint32_t)data_size;
+    object->contents[SECTION_CODE] = (const uint8_t *)code;
+    object->contents[SECTION_DATA] = data;
+    object->header.symbol_count = builder->symbol_count;
+    object->header.string_size = builder->string_size;
+    object->header.reloc_count = builder->reloc_count;
+    object->symbols = builder->symbols;
+    object->strings = builder->strings;
+    object->relocs = builder->relocs;
+}
+
+// Write code, data and the collected tables as an object file
+static int write_object(const char *path, ObjectType type, const uint32_t *code, size_t word_count,
+                        const uint8_t *data, size_t data_size, uint32_t entry, const ObjectBuilder *builder) {
+    ObjectFile object;
+    fill_object(&object, type, code, word_count, data, data_size, entry, builder);
+    return object_write(path, &object);
+}
 
+// Write an assembled program as an executable, or as a relocatable unit whose
+// label references become relocations
+static int write_assembly(const char *path, const Assembly *assembly) {
+    ObjectBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    symtab_init(&builder.index);
+    uint32_t code_base = assembly->relocatable ? 0 : CODE_START;
+    uint32_t data_base = assembly->relocatable ? 0 : DATA_START;
+    add_object_symbols(&builder, &assembly->symbols, code_base, SECTION_CODE, &assembly->data_symbols);
+    add_object_symbols(&builder, &assembly->data_symbols, data_base, SECTION_DATA, NULL);
+
+    for (size_t i = 0; assembly->relocatable && i < assembly->fixups.count; i++) {
+        const Fixup *fixup = &assembly->fixups.items[i];
+        uint32_t symbol;
+        if (!find_label(&builder.index, fixup->label, &symbol)) {
+            symbol = add_object_symbol(&builder, fixup->label, 0, SECTION_UNDEFINED);
+        }
+        builder.relocs = grow_array(builder.relocs, &builder.reloc_capacity,
+                                    builder.reloc_count + 1, sizeof(ObjectReloc));
+        ObjectReloc *reloc = &builder.relocs[builder.reloc_count++];
+        reloc->offset = (uint32_t)(fixup->word * sizeof(uint32_t));
+        reloc->symbol = symbol;
+        reloc->line = fixup->line;
+        reloc->section = fixup->section;
+        reloc->kind = fixup->kind;
+        reloc->shift = fixup->shift;
+        reloc->sign = fixup->sign;
+    }
+
+    // Execution starts at _start when the program defines it
+    uint32_t entry = 0;
+    find_label(&assembly->symbols, "_start", &entry);
+    int status = write_object(path, assembly->relocatable ? OBJ_RELOCATABLE : OBJ_EXECUTABLE,
+                              assembly->code, assembly->word_count, assembly->data, assembly->data_size,
+                              code_base + entry, &builder);
+    free_object_builder(&builder);
+    return status;
+}
+
+// Rebuild a relocatable unit from an object file written by write_assembly
+static int load_relocatable_object(const char *path, Assembly *assembly) {
+    ObjectFile object;
+    if (object_open(path, &object) != 0) {
+        return -1;
+    }
+    memset(assembly, 0, sizeof(*assembly));
+    symtab_init(&assembly->symbols);
+    symtab_init(&assembly->data_symbols);
+    assembly->relocatable = 1;
+
+    int status = 0;
+    const ObjectHeader *header = &object.header;
+    if (header->type != OBJ_RELOCATABLE || header->sections[SECTION_CODE].size % sizeof(uint32_t) != 0) {
+        fprintf(stderr, "Error: '%s' is not a relocatable object.\n", path);
+        status = -1;
+    }
+    if (status == 0) {
+        size_t words = header->sections[SECTION_CODE].size / sizeof(uint32_t);
+        reserve_code(assembly, words);
+        if (words > 0) {
+            memcpy(assembly->code, object.contents[SECTION_CODE], words * sizeof(uint32_t));
+        }
+        assembly->word_count = words;
+        if (header->sections[SECTION_DATA].size > 0) {
+            emit_data(assembly, object.contents[SECTION_DATA], header->sections[SECTION_DATA].size);
+        }
+    }
+    uint32_t existing;
+    for (uint32_t i = 0; status == 0 && i < header->symbol_count; i++) {
+        const ObjectSymbol *symbol = &object.symbols[i];
+        const char *name = object_symbol_name(&object, symbol);
+        int duplicate = 0;
+        if (symbol->section == SECTION_CODE) {
+            duplicate = symtab_define(&assembly->symbols, name, symbol->value) != 0 ||
+                        find_label(&assembly->data_symbols, name, &existing);
+        } else if (symbol->section == SECTION_DATA) {
+            duplicate = symtab_define(&assembly->data_symbols, name, symbol->value) != 0 ||
+                        find_label(&assembly->symbols, name, &existing);
+        }
+        if (duplicate) {
+            fprintf(stderr, "Error: Label '%s' is defined more than once in '%s'.\n", name, path);
+            status = -1;
+        }
+    }
+    for (uint32_t i = 0; status == 0 && i < header->reloc_count; i++) {
+        const ObjectReloc *reloc = &object.relocs[i];
+        const char *name = object_symbol_name(&object, &object.symbols[reloc->symbol]);
+        if ((reloc->section != SECTION_CODE && reloc->section != SECTION_DATA) ||
+            (reloc->section == SECTION_DATA && reloc->kind != FIXUP_LITERAL) ||
+            reloc->kind > FIXUP_DISPLACEMENT || strlen(name) >= LABEL_NAME_MAX) {
+            fprintf(stderr, "Error: Unsupported relocation against '%s' in '%s'.\n", name, path);
+            status = -1;
+            break;
+        }
+        ParsedOperand operand = { 0, REGISTER, 0, 0, "", reloc->sign };
+        snprintf(operand.forward, sizeof(operand.forward), "%s", name);
+        assembly->fixups.base = 0;
+        assembly->fixups.line = reloc->line;
+        Fixup *fixup = add_fixup(&assembly->fixups, &operand, reloc->offset / sizeof(uint32_t),
+                                 (FixupKind)reloc->kind, reloc->shift);
+        fixup->section = reloc->section;
+    }
+    object_close(&object);
+    if (status != 0) {
+        free_assembly(assembly);
+    }
+    return status;
+}
+
+// Everything besides the source that changes the output. The build stamp
+// retires entries written by other builds of the assembler.
+static void cache_options(const AssemblerOptions *options, char *text, size_t size) {
+    snprintf(text, size, "assembler %d built %s %s; object v%d; registers %d; relocatable %d; optimize %d",
+             ASSEMBLER_VERSION, __DATE__, __TIME__, OBJ_VERSION, NUM_REGISTERS, options->relocatable,
+             options->optimize);
+}
+
+int assemble_with_options(const char *asm_file, const char *output_file, const AssemblerOptions *options) {
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Content-addressed cache: an unchanged source is copied, not parsed
+    AsmCacheKey key;
+    char key_options[256];
+    cache_options(options, key_options, sizeof(key_options));
+    int cached = options->use_cache && asm_cache_enabled() && asm_cache_key(asm_file, key_options, &key) == 0;
+    if (cached && asm_cache_fetch(&key, output_file)) {
+        printf("Assembly cached: %s (key %s)\n", output_file, key.hex);
+        return 0;
+    }
+
+    Assembly assembly;
+    if (assemble_file(asm_file, options->relocatable, options->optimize, &assembly) != 0) {
+        return -1;
+    }
+    if (write_assembly(output_file, &assembly) != 0) {
+        free_assembly(&assembly);
+        return -1;
+    }
+    if (cached) {
+        asm_cache_store(&key, output_file);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    double seconds = (double)(stop.tv_sec - start.tv_sec) + (double)(stop.tv_nsec - start.tv_nsec) / 1e9;
+    printf("Assembly complete: %s (%u lines, %zu bytes, %.0f lines/sec)\n", output_file, assembly.lines,
+           assembly.word_count * sizeof(uint32_t), seconds > 0 ? assembly.lines / seconds : 0.0);
+    free_assembly(&assembly);
+    return 0;
+}
+
+int assemble_buffer(const char *source, size_t size, const char *name, int optimize, ObjectFile *executable) {
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    Assembly assembly;
+    if (assemble_text(source, size, name, 0, optimize, &assembly) != 0) {
+        return -1;
+    }
+    ObjectBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    symtab_init(&builder.index);
+    add_object_symbols(&builder, &assembly.symbols, CODE_START, SECTION_CODE, &assembly.data_symbols);
+    add_object_symbols(&builder, &assembly.data_symbols, DATA_START, SECTION_DATA, NULL);
+    uint32_t entry = 0;
+    find_label(&assembly.symbols, "_start", &entry);
+
+    // The object takes over the code, data and tables
+    fill_object(executable, OBJ_EXECUTABLE, assembly.code, assembly.word_count, assembly.data,
+                assembly.data_size, CODE_START + entry, &builder);
+    size_t bytes = assembly.word_count * sizeof(uint32_t);
+    uint32_t lines = assembly.lines;
+    assembly.code = NULL;
+    assembly.data = NULL;
+    free_assembly(&assembly);
+    symtab_free(&builder.index);
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    double seconds = (double)(stop.tv_sec - start.tv_sec) + (double)(stop.tv_nsec - start.tv_nsec) / 1e9;
+    printf("Assembly complete: %s (%u lines, %zu bytes, %.0f lines/sec)\n", name, lines, bytes,
+           seconds > 0 ? lines / seconds : 0.0);
+    return 0;
+}
 
 // Main assembler function
 int assemble(const char *asm_file, const char *bin_file) {
-    FILE *input = fopen(asm_file, "r");
-    FILE *output = fopen(bin_file, "wb");
+    AssemblerOptions options = { .relocatable = 0, .use_cache = 1, .optimize = 0 };
+    return assemble_with_options(asm_file, bin_file, &options);
+}
+
+// Linker: each file becomes a relocatable unit on a worker thread; the units
+// are then laid out in order and their relocations applied
 
-    if (!input || !output) {
-        fprintf(stderr, "Error: Cannot open file(s).\n");
+void init_linker(Linker *linker) {
+    memset(linker, 0, sizeof(*linker));
+    symtab_init(&linker->globals);
+    symtab_init(&linker->data_globals);
+}
+
+void add_file_to_linker(Linker *linker, const char *filename) {
+    if (linker->file_count == linker->file_capacity) {
+        linker->file_capacity = linker->file_capacity ? linker->file_capacity * 2 : 8;
+        linker->files = realloc(linker->files, linker->file_capacity * sizeof(char *));
+        if (!linker->files) {
+            fprintf(stderr, "Error: Out of memory adding '%s' to the link.\n", filename);
+            exit(EXIT_FAILURE);
+        }
+    }
+    linker->files[linker->file_count] = strdup(filename);
+    linker->file_count++;
+}
+
+typedef struct {
+    Linker *linker;
+    atomic_int next;     // Next file to assemble
+    atomic_int failed;
+} LinkJob;
+
+static void *assemble_worker(void *arg) {
+    LinkJob *job = arg;
+    int index;
+    while ((index = atomic_fetch_add(&job->next, 1)) < job->linker->file_count) {
+        const char *file = job->linker->files[index];
+        int status = object_is_object_file(file) ? load_relocatable_object(file, &job->linker->units[index])
+                                                 : assemble_file(file, 1, 0, &job->linker->units[index]);
+        if (status != 0) {
+            atomic_store(&job->failed, 1);
+        }
+    }
+    return NULL;
+}
+
+// Assemble every file, one worker per file up to the number of CPUs
+static int assemble_units(Linker *linker) {
+    linker->units = calloc(linker->file_count, sizeof(Assembly));
+    if (!linker->units) {
+        fprintf(stderr, "Error: Out of memory for the link.\n");
         return -1;
     }
+    LinkJob job = { .linker = linker };
+    atomic_init(&job.next, 0);
+    atomic_init(&job.failed, 0);
+    run_workers(assemble_worker, &job, linker->file_count);
+    return atomic_load(&job.failed) ? -1 : 0;
+}
 
-    char line[256];
-    uint32_t address = 0; // Current memory address (instruction index)
+// A label is published once; defined again in another file, it becomes ambiguous
+static void publish_global(Linker *linker, const char *name, uint32_t address, int data) {
+    if (symtab_define(&linker->globals, name, address) != 0) {
+        symtab_update(&linker->globals, name, LINK_AMBIGUOUS);
+    }
+    if (data) {
+        symtab_define(&linker->data_globals, name, address);
+    }
+}
 
-    // First Pass: Build the label table
-    while (fgets(line, sizeof(line), input)) {
-        char *trimmed_line = strtok(line, "\n\r\t "); // Trim whitespace and newlines
+// Lay the units' code and data out in link order and publish their labels
+static void layout_units(Linker *linker) {
+    symtab_free(&linker->globals);
+    symtab_init(&linker->globals);
+    symtab_free(&linker->data_globals);
+    symtab_init(&linker->data_globals);
+    size_t total = 0, data = 0;
+    for (int i = 0; i < linker->file_count; i++) {
+        Assembly *unit = &linker->units[i];
+        unit->base = (uint32_t)(total * sizeof(uint32_t));
+        unit->data_base = (uint32_t)data;
+        total += unit->word_count;
+        data += (unit->data_size + 3) & ~(size_t)3; // Keep every unit's words aligned
+        for (uint32_t slot = 0; slot < unit->symbols.capacity; slot++) {
+            const SymbolEntry *entry = &unit->symbols.entries[slot];
+            if (entry->hash != 0) {
+                publish_global(linker, symtab_entry_name(&unit->symbols, entry), unit->base + entry->address, 0);
+            }
+        }
+        for (uint32_t slot = 0; slot < unit->data_symbols.capacity; slot++) {
+            const SymbolEntry *entry = &unit->data_symbols.entries[slot];
+            if (entry->hash != 0) {
+                publish_global(linker, symtab_entry_name(&unit->data_symbols, entry),
+                               DATA_START + unit->data_base + entry->address, 1);
+            }
+        }
+    }
+    linker->word_count = total;
+    linker->data_size = data;
+}
 
-        if (!trimmed_line || trimmed_line[0] == ';') {
-            continue; // Skip empty lines and comments
+// Value of a unit's reference: the file's own label first, then the global
+// one. Sets is_code when the label is in code rather than data.
+static int reference_value(const Linker *linker, int file, const Fixup *fixup, uint32_t *value, int *is_code) {
+    const Assembly *unit = &linker->units[file];
+    uint32_t address;
+    if (find_label(&unit->symbols, fixup->label, value)) {
+        *value += unit->base;
+        *is_code = 1;
+        return 0;
+    }
+    if (find_label(&unit->data_symbols, fixup->label, value)) {
+        *value += DATA_START + unit->data_base;
+        *is_code = 0;
+        return 0;
+    }
+    if (!find_label(&linker->globals, fixup->label, value)) {
+        fprintf(stderr, "Error: Undefined label '%s' (%s line %u).\n",
+                fixup->label, linker->files[file], fixup->line);
+        return -1;
+    }
+    if (*value == LINK_AMBIGUOUS) {
+        fprintf(stderr, "Error: Label '%s' used in %s (line %u) is defined in more than one file.\n",
+                fixup->label, linker->files[file], fixup->line);
+        return -1;
+    }
+    *is_code = !find_label(&linker->data_globals, fixup->label, &address);
+    return 0;
+}
+
+// Copy the units into the code and data images and apply their relocations
+static int relocate_units(Linker *linker) {
+    free(linker->image);
+    free(linker->data);
+    linker->image = malloc(linker->word_count ? linker->word_count * sizeof(uint32_t) : 1);
+    linker->data = calloc(linker->data_size ? linker->data_size : 1, 1);
+    if (!linker->image || !linker->data) {
+        fprintf(stderr, "Error: Out of memory for the linked image.\n");
+        return -1;
+    }
+    for (int i = 0; i < linker->file_count; i++) {
+        const Assembly *unit = &linker->units[i];
+        uint32_t *code = linker->image + unit->base / sizeof(uint32_t);
+        uint32_t *data = (uint32_t *)(linker->data + unit->data_base);
+        if (unit->word_count > 0) {
+            memcpy(code, unit->code, unit->word_count * sizeof(uint32_t));
         }
+        if (unit->data_size > 0) {
+            memcpy(data, unit->data, unit->data_size);
+        }
+        for (size_t f = 0; f < unit->fixups.count; f++) {
+            const Fixup *fixup = &unit->fixups.items[f];
+            uint32_t value;
+            int is_code;
+            if (reference_value(linker, i, fixup, &value, &is_code) != 0 ||
+                patch_fixup(fixup->section == SECTION_DATA ? data : code, fixup, value, linker->files[i]) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
 
-        // Check if the line ends with ':' (it's a label)
-        if (strchr(trimmed_line, ':')) {
-            trimmed_line[strlen(trimmed_line) - 1] = '\0'; // Remove trailing ':'
-            add_label(trimmed_line, address);
-        } else {
-            address += sizeof(uint32_t); // Increment address for each instruction
+int resolve_symbols(Linker *linker) {
+    if (linker->file_count == 0) {
+        fprintf(stderr, "Error: No files to link.\n");
+        return -1;
+    }
+    if (assemble_units(linker) != 0) {
+        return -1;
+    }
+    layout_units(linker);
+    return relocate_units(linker);
+}
+
+// Dead code elimination: instructions not reachable from the entry point are
+// dropped after linking, the units are compacted, and their labels and
+// relocations are resolved again against the new layout
+
+// Operand holding the branch target, or -1 for other instructions
+static int branch_operand(Opcode opcode) {
+    switch (opcode) {
+        case JUMP: case JZ: case JNZ: case CALL:
+            return 0;
+        case DJNZ: case LOOP:
+            return 1;
+        case BEQ: case BNE: case BLT: case BGE: case BGT: case BLE:
+            return 2;
+        default:
+            return -1;
+    }
+}
+
+static int falls_through(Opcode opcode) {
+    return opcode != JUMP && opcode != RET && opcode != HALT;
+}
+
+static size_t instruction_words(uint32_t raw) {
+    return 1 + ((raw & INSTR_MODES) ? 1 : 0) + ((raw & INSTR_EXTENDED) ? 1 : 0);
+}
+
+// Target of a branch with an immediate operand. Targets held in registers or
+// memory are not followed; every label whose address is taken is a root instead.
+static int branch_target(const uint32_t *code, size_t index, uint32_t *target) {
+    uint32_t raw = code[index];
+    Opcode opcode = (Opcode)((raw >> 24) & INSTR_OPCODE_MASK);
+    int operand = branch_operand(opcode);
+    if (operand < 0) {
+        return 0;
+    }
+    size_t next = index + 1;
+    AddressingMode mode = implicit_mode(opcode_table[opcode].kinds[operand]);
+    int slot = literal_slot(opcode);
+    if (raw & INSTR_MODES) {
+        uint32_t mode_word = code[next++];
+        mode = (AddressingMode)((mode_word >> (operand * MODE_FIELD_BITS)) & MODE_FIELD_MASK);
+        slot = (int)((mode_word >> MODE_SLOT_SHIFT) & 0x3);
+    }
+    if (mode != IMMEDIATE) {
+        return 0;
+    }
+    *target = ((raw & INSTR_EXTENDED) && slot == operand) ? code[next] : (raw >> (16 - 8 * operand)) & 0xFF;
+    return 1;
+}
+
+// A label reference in the linked image
+typedef struct {
+    size_t word;
+    uint32_t value;
+} LinkReference;
+
+typedef struct {
+    const uint32_t *image;
+    size_t word_count;
+    uint8_t *live;             // Per word: belongs to a reachable instruction
+    size_t *stack;             // Instructions waiting to be scanned
+    size_t depth;
+    const LinkReference *references;
+    size_t reference_count;
+} Reachability;
+
+// Queue the instruction at a byte address, if it is one not yet reached
+static void reach(Reachability *graph, uint32_t address) {
+    size_t index = address / sizeof(uint32_t);
+    if (address % sizeof(uint32_t) != 0 || index >= graph->word_count || graph->live[index]) {
+        return;
+    }
+    size_t size = instruction_words(graph->image[index]);
+    if (index + size > graph->word_count) {
+        size = graph->word_count - index;
+    }
+    memset(graph->live + index, 1, size);
+    graph->stack[graph->depth++] = index;
+}
+
+// Mark everything reachable from the queued roots. An instruction reaches its
+// fall-through successor, its branch target, and every code label it
+// references (an address loaded into a register may be called or jumped through).
+static void mark_reachable(Reachability *graph) {
+    while (graph->depth > 0) {
+        size_t index = graph->stack[--graph->depth];
+        uint32_t raw = graph->image[index];
+        Opcode opcode = (Opcode)((raw >> 24) & INSTR_OPCODE_MASK);
+        size_t size = instruction_words(raw);
+        uint32_t target;
+        if (index + size <= graph->word_count && branch_target(graph->image, index, &target)) {
+            reach(graph, target);
+        }
+        if (falls_through(opcode)) {
+            reach(graph, (uint32_t)((index + size) * sizeof(uint32_t)));
+        }
+
+        // References are sorted by word: find the first inside this instruction
+        size_t low = 0, high = graph->reference_count;
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            if (graph->references[middle].word < index) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        for (; low < graph->reference_count && graph->references[low].word < index + size; low++) {
+            reach(graph, graph->references[low].value);
+        }
+    }
+}
+
+static void add_removal(Linker *linker, int file, uint32_t address, uint32_t size, const char *label, uint32_t offset) {
+    if (linker->removed_count == linker->removed_capacity) {
+        linker->removed_capacity = linker->removed_capacity ? linker->removed_capacity * 2 : 16;
+        linker->removed = realloc(linker->removed, linker->removed_capacity * sizeof(LinkRemoval));
+        if (!linker->removed) {
+            fprintf(stderr, "Error: Out of memory for the link map.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    LinkRemoval *removal = &linker->removed[linker->removed_count++];
+    removal->file = file;
+    removal->address = address;
+    removal->size = size;
+    removal->offset = offset;
+    snprintf(removal->label, sizeof(removal->label), "%s", label);
+}
+
+static int compare_entry_address(const void *a, const void *b) {
+    uint32_t x = (*(const SymbolEntry *const *)a)->address;
+    uint32_t y = (*(const SymbolEntry *const *)b)->address;
+    return (x > y) - (x < y);
+}
+
+// Drop a unit's dead words in place, record them, and move its labels and
+// relocations to the compacted positions
+static void compact_unit(Linker *linker, int file, const uint8_t *live) {
+    Assembly *unit = &linker->units[file];
+    size_t first = unit->base / sizeof(uint32_t);
+    size_t *position = malloc((unit->word_count + 1) * sizeof(size_t));
+    if (!position) {
+        fprintf(stderr, "Error: Out of memory compacting '%s'.\n", linker->files[file]);
+        exit(EXIT_FAILURE);
+    }
+
+    // Removed runs are named after the closest label before them
+    const SymbolEntry **labels = malloc((unit->symbols.count + 1) * sizeof(SymbolEntry *));
+    if (!labels) {
+        fprintf(stderr, "Error: Out of memory compacting '%s'.\n", linker->files[file]);
+        exit(EXIT_FAILURE);
+    }
+    size_t label_count = 0, label = 0;
+    for (uint32_t slot = 0; slot < unit->symbols.capacity; slot++) {
+        if (unit->symbols.entries[slot].hash != 0) {
+            labels[label_count++] = &unit->symbols.entries[slot];
         }
     }
+    qsort(labels, label_count, sizeof(SymbolEntry *), compare_entry_address);
 
-    rewind(input); // Reset file pointer for second pass
+    size_t kept = 0;
+    for (size_t w = 0; w < unit->word_count; ) {
+        position[w] = kept;
+        if (live[first + w]) {
+            unit->code[kept++] = unit->code[w++];
+            continue;
+        }
+        uint32_t address = (uint32_t)(w * sizeof(uint32_t));
+        while (w < unit->word_count && !live[first + w]) {
+            position[w++] = kept;
+        }
+        while (label + 1 < label_count && labels[label + 1]->address <= address) {
+            label++;
+        }
+        const SymbolEntry *before = (label < label_count && labels[label]->address <= address) ? labels[label] : NULL;
+        add_removal(linker, file, unit->base + address, (uint32_t)(w * sizeof(uint32_t)) - address,
+                    before ? symtab_entry_name(&unit->symbols, before) : "",
+                    before ? address - before->address : address);
+    }
+    free(labels);
+    position[unit->word_count] = kept;
 
-    // Second Pass: Translate instructions into binary
-    while (fgets(line, sizeof(line), input)) {
-        char opcode[16];
-        sscanf(line, "%s", opcode);
+    // Labels of removed code are dropped; the rest move with their instruction
+    SymbolTable symbols;
+    symtab_init(&symbols);
+    for (uint32_t slot = 0; slot < unit->symbols.capacity; slot++) {
+        const SymbolEntry *entry = &unit->symbols.entries[slot];
+        size_t word = entry->address / sizeof(uint32_t);
+        if (entry->hash != 0 && (word >= unit->word_count || live[first + word])) {
+            size_t moved = position[word < unit->word_count ? word : unit->word_count];
+            symtab_define(&symbols, symtab_entry_name(&unit->symbols, entry), (uint32_t)(moved * sizeof(uint32_t)));
+        }
+    }
+    symtab_free(&unit->symbols);
+    unit->symbols = symbols;
 
-        if (opcode[0] == ';' || strchr(line, ':')) {
-            continue; // Skip comments and label definitions in second pass
+    size_t fixups = 0;
+    for (size_t f = 0; f < unit->fixups.count; f++) {
+        Fixup fixup = unit->fixups.items[f];
+        if (fixup.section == SECTION_DATA || live[first + fixup.word]) {
+            fixup.word = fixup.section == SECTION_DATA ? fixup.word : position[fixup.word];
+            unit->fixups.items[fixups++] = fixup;
         }
+    }
+    unit->fixups.count = fixups;
+    unit->word_count = kept;
+    free(position);
+}
 
-        uint32_t binary_instruction = translate_assembly_line_to_binary(line);
-        fwrite(&binary_instruction, sizeof(binary_instruction), 1, output);
+long eliminate_dead_code(Linker *linker) {
+    size_t before = linker->word_count;
+    Reachability graph = { .image = linker->image, .word_count = before };
+    size_t reference_total = 0;
+    for (int i = 0; i < linker->file_count; i++) {
+        reference_total += linker->units[i].fixups.count;
+    }
+    graph.live = calloc(before + 1, 1);
+    graph.stack = malloc((before + 1) * sizeof(size_t));
+    LinkReference *references = malloc((reference_total + 1) * sizeof(LinkReference));
+    if (!graph.live || !graph.stack || !references) {
+        fprintf(stderr, "Error: Out of memory for dead code elimination.\n");
+        free(graph.live);
+        free(graph.stack);
+        free(references);
+        return -1;
     }
 
-    fclose(input);
-    fclose(output);
+    // Units are laid out in order and their fixups recorded in order, so the
+    // references come out sorted by word. Code whose address is stored in
+    // data (a .word table of handlers) is reachable from the start.
+    uint32_t entry;
+    if (!find_label(&linker->globals, "_start", &entry) || entry == LINK_AMBIGUOUS) {
+        entry = 0;
+    }
+    reach(&graph, entry);
+    for (int i = 0; i < linker->file_count; i++) {
+        const Assembly *unit = &linker->units[i];
+        for (size_t f = 0; f < unit->fixups.count; f++) {
+            const Fixup *fixup = &unit->fixups.items[f];
+            uint32_t value;
+            int is_code;
+            reference_value(linker, i, fixup, &value, &is_code);
+            if (!is_code) {
+                continue;
+            }
+            if (fixup->section == SECTION_DATA) {
+                reach(&graph, value);
+            } else {
+                references[graph.reference_count++] = (LinkReference){ unit->base / sizeof(uint32_t) + fixup->word, value };
+            }
+        }
+    }
+    graph.references = references;
+    mark_reachable(&graph);
+
+    for (int i = 0; i < linker->file_count; i++) {
+        compact_unit(linker, i, graph.live);
+    }
+    free(graph.live);
+    free(graph.stack);
+    free(references);
 
-    printf("Assembly complete: %s\n", bin_file);
+    layout_units(linker);
+    if (relocate_units(linker) != 0) {
+        return -1;
+    }
+    return (long)((before - linker->word_count) * sizeof(uint32_t));
+}
+
+int write_link_map(const Linker *linker, const char *map_file) {
+    FILE *out = fopen(map_file, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Cannot open file '%s'.\n", map_file);
+        return -1;
+    }
+    fprintf(out, "Link map: %zu bytes of code, %zu bytes of data\n\nFiles:\n",
+            linker->word_count * sizeof(uint32_t), linker->data_size);
+    for (int i = 0; i < linker->file_count; i++) {
+        const Assembly *unit = &linker->units[i];
+        fprintf(out, "  0x%04X  %6zu bytes  %s\n", CODE_START + unit->base,
+                unit->word_count * sizeof(uint32_t), linker->files[i]);
+        if (unit->data_size > 0) {
+            fprintf(out, "  0x%04X  %6zu bytes  %s (data)\n", DATA_START + unit->data_base,
+                    unit->data_size, linker->files[i]);
+        }
+    }
+
+    size_t count = 0;
+    for (int i = 0; i < linker->file_count; i++) {
+        count += linker->units[i].symbols.count + linker->units[i].data_symbols.count;
+    }
+    MapSymbol *symbols = malloc((count + 1) * sizeof(MapSymbol));
+    if (!symbols) {
+        fprintf(stderr, "Error: Out of memory for the link map.\n");
+        fclose(out);
+        return -1;
+    }
+    count = 0;
+    for (int i = 0; i < linker->file_count; i++) {
+        const Assembly *unit = &linker->units[i];
+        for (uint32_t slot = 0; slot < unit->symbols.capacity; slot++) {
+            const SymbolEntry *entry = &unit->symbols.entries[slot];
+            if (entry->hash != 0) {
+                symbols[count++] = (MapSymbol){ CODE_START + unit->base + entry->address,
+                                                symtab_entry_name(&unit->symbols, entry), i };
+            }
+        }
+        for (uint32_t slot = 0; slot < unit->data_symbols.capacity; slot++) {
+            const SymbolEntry *entry = &unit->data_symbols.entries[slot];
+            if (entry->hash != 0) {
+                symbols[count++] = (MapSymbol){ DATA_START + unit->data_base + entry->address,
+                                                symtab_entry_name(&unit->data_symbols, entry), i };
+            }
+        }
+    }
+    qsort(symbols, count, sizeof(MapSymbol), compare_map_symbols);
+    fprintf(out, "\nSymbols:\n");
+    for (size_t i = 0; i < count; i++) {
+        fprintf(out, "  0x%04X  %-24s %s\n", symbols[i].address, symbols[i].name, linker->files[symbols[i].file]);
+    }
+    free(symbols);
+
+    // Removed code is listed at its address before compaction
+    uint64_t removed = 0;
+    for (size_t i = 0; i < linker->removed_count; i++) {
+        removed += linker->removed[i].size;
+    }
+    fprintf(out, "\nRemoved (unreachable from the entry point): %llu bytes\n", (unsigned long long)removed);
+    for (size_t i = 0; i < linker->removed_count; i++) {
+        const LinkRemoval *removal = &linker->removed[i];
+        char name[LABEL_NAME_MAX + 16];
+        if (!removal->label[0]) {
+            snprintf(name, sizeof(name), "+%u", removal->offset);
+        } else if (removal->offset) {
+            snprintf(name, sizeof(name), "%s+%u", removal->label, removal->offset);
+        } else {
+            snprintf(name, sizeof(name), "%s", removal->label);
+        }
+        fprintf(out, "  0x%04X  %6u bytes  %-24s %s\n", CODE_START + removal->address, removal->size,
+                name, linker->files[removal->file]);
+    }
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Error: Failed to write '%s'.\n", map_file);
+        return -1;
+    }
     return 0;
 }
+
+int generate_binary(Linker *linker, const char *output_file) {
+    // Every unit's labels go into the executable, for traces and profiles
+    ObjectBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    symtab_init(&builder.index);
+    for (int i = 0; i < linker->file_count; i++) {
+        const Assembly *unit = &linker->units[i];
+        add_object_symbols(&builder, &unit->symbols, CODE_START + unit->base, SECTION_CODE, NULL);
+        add_object_symbols(&builder, &unit->data_symbols, DATA_START + unit->data_base, SECTION_DATA, NULL);
+    }
+
+    // A _start defined in exactly one file is the entry point
+    uint32_t entry;
+    if (!find_label(&linker->globals, "_start", &entry) || entry == LINK_AMBIGUOUS) {
+        entry = 0;
+    }
+    int status = write_object(output_file, OBJ_EXECUTABLE, linker->image, linker->word_count,
+                              linker->data, linker->data_size, CODE_START + entry, &builder);
+    free_object_builder(&builder);
+    return status;
+}
+
+void free_linker(Linker *linker) {
+    for (int i = 0; i < linker->file_count; i++) {
+        if (linker->units) {
+            free_assembly(&linker->units[i]);
+        }
+        free(linker->files[i]);
+    }
+    free(linker->units);
+    free(linker->files);
+    free(linker->image);
+    free(linker->data);
+    free(linker->removed);
+    symtab_free(&linker->globals);
+    symtab_free(&linker->data_globals);
+    memset(linker, 0, sizeof(*linker));
+}
@@ -4,8 +4,11 @@
 #include "cpu.h"
 #include "memory.h"
 #include "hll_translator.h"
+#include "hll_opt.h"
+#include "pipeline.h"
 #include "linker.h"
 #include "debug.h"
+#include "debugger.h"
 
 
 int compile_and_execute_c_file(const char *c_file) {
@@ -26,13 +29,64 @@ int compile_and_execute_c_file(const char *c_file) {
 }
 
 
+// -O0/-O1/-O2 and --<pass>/--no-<pass>; returns 0 for any other argument
+static int parse_pass_option(const char *arg, unsigned *passes) {
+    unsigned pass = 0;
+    if (strcmp(arg, "-O0") == 0) {
+        *passes = 0;
+    } else if (strcmp(arg, "-O1") == 0) {
+        *passes = IR_PASSES_O1;
+    } else if (strcmp(arg, "-O2") == 0) {
+        *passes = IR_PASSES_O2;
+    } else if (strncmp(arg, "--no-", 5) == 0 && (pass = ir_pass_named(arg + 5)) != 0) {
+        *passes &= ~pass;
+    } else if (strncmp(arg, "--", 2) == 0 && (pass = ir_pass_named(arg + 2)) != 0) {
+        *passes |= pass;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+// Trace options shared by run and exec; returns 0 for any other argument
+static int parse_trace_option(const char *arg, CPU *cpu) {
+    if (strcmp(arg, "--full") == 0) {
+        cpu->trace_mode = TRACE_FULL;
+    } else if (strcmp(arg, "--quiet") == 0) {
+        cpu->trace_mode = TRACE_NONE;
+    } else if (strcmp(arg, "--profile") == 0) {
+        cpu->trace_mode = TRACE_NONE;
+        cpu->profiling = true;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
 int main(int argc, char *argv[]) {
     if (argc < 3) {
         fprintf(stderr, "Usage: %s <command> <input_file> [output_file]\n", argv[0]);
         fprintf(stderr, "Commands:\n");
-        fprintf(stderr, "  translate <input.hll> <output.asm>   Translate HLL to assembly\n");
-        fprintf(stderr, "  assemble <input.asm> <output.bin>   Assemble assembly to binary\n");
-        fprintf(stderr, "  run <input.bin>                     Run binary file\n");
+        fprintf(stderr, "  translate <input.hll> <output.asm> [-O0|-O1|-O2] [--<pass>|--no-<pass>]\n");
+        fprintf(stderr, "                                      Translate HLL to assembly; -O1 folds constants,\n");
+        fprintf(stderr, "                                      reduces strength and removes dead code, -O2 also\n");
+        fprintf(stderr, "                                      runs cse and licm (passes: constants, strength,\n");
+        fprintf(stderr, "                                      cse, licm, dce)\n");
+        fprintf(stderr, "  assemble <input.asm> <output.bin> [-O] [--relocatable] [--no-cache]\n");
+        fprintf(stderr, "                                      Assemble to an executable (or a relocatable object);\n");
+        fprintf(stderr, "                                      -O runs the peephole optimizer\n");
+        fprintf(stderr, "  link <output.bin> <a.asm|a.o> [...] [--map <file>] [--keep-dead]\n");
+        fprintf(stderr, "                                      Assemble files in parallel and link them, dropping\n");
+        fprintf(stderr, "                                      code unreachable from the entry point\n");
+        fprintf(stderr, "  run <input.bin> [--full|--quiet|--profile]\n");
+        fprintf(stderr, "                                      Run binary file (--full: dump all memory each step,\n");
+        fprintf(stderr, "                                      --quiet: program output only,\n");
+        fprintf(stderr, "                                      --profile: instruction counts per symbol)\n");
+        fprintf(stderr, "  exec <input.hll|input.asm> [--hll|--asm] [-O0|-O1|-O2] [--<pass>|--no-<pass>] [--peephole]\n");
+        fprintf(stderr, "       [--save-asm <file>] [--save-bin <file>] [--full|--quiet|--profile]\n");
+        fprintf(stderr, "                                      Translate, assemble, load and run in memory,\n");
+        fprintf(stderr, "                                      writing intermediate files only when asked\n");
+        fprintf(stderr, "  debug <input.bin>                   Debug with breakpoints and watchpoints\n");
         fprintf(stderr, "  compile <input.c>                   Compile C program and run\n");
         return 1;
     }
@@ -46,10 +100,18 @@ int main(int argc, char *argv[]) {
     if (strcmp(command, "translate") == 0) {
         // Translate HLL to Assembly
         if (!output_file) {
-            fprintf(stderr, "Usage: %s translate <input.hll> <output.asm>\n", argv[0]);
+            fprintf(stderr, "Usage: %s translate <input.hll> <output.asm> [-O0|-O1|-O2] [--<pass>|--no-<pass>]\n", argv[0]);
             return 1;
         }
 
+        unsigned passes = 0;
+        for (int i = 4; i < argc; i++) {
+            if (!parse_pass_option(argv[i], &passes)) {
+                fprintf(stderr, "Error: Unknown translate option '%s'.\n", argv[i]);
+                return 1;
+            }
+        }
+
         FILE *hll_fp = fopen(input_file, "r");
         if (!hll_fp) {
             fprintf(stderr, "Error: Cannot open HLL file '%s'.\n", input_file);
@@ -65,7 +127,7 @@ int main(int argc, char *argv[]) {
         fclose(hll_fp);
         hll_code[length] = '\0';
 
-        if (translate_hll_to_assembly(hll_code, output_file) != 0) {
+        if (translate_hll_to_assembly(hll_code, output_file, passes) != 0) {
             fprintf(stderr, "Error: Translation from HLL to assembly failed.\n");
             free(hll_code);
             return 1;
@@ -77,17 +139,80 @@ int main(int argc, char *argv[]) {
     } else if (strcmp(command, "assemble") == 0) {
         // Assemble Assembly to Binary
         if (!output_file) {
-            fprintf(stderr, "Usage: %s assemble <input.asm> <output.bin>\n", argv[0]);
+            fprintf(stderr, "Usage: %s assemble <input.asm> <output.bin> [-O] [--relocatable] [--no-cache]\n", argv[0]);
             return 1;
         }
 
-        if (assemble(input_file, output_file) != 0) {
+        AssemblerOptions options = { .relocatable = 0, .use_cache = 1, .optimize = 0 };
+        for (int i = 4; i < argc; i++) {
+            if (strcmp(argv[i], "-O") == 0) {
+                options.optimize = 1;
+            } else if (strcmp(argv[i], "--relocatable") == 0) {
+                options.relocatable = 1;
+            } else if (strcmp(argv[i], "--no-cache") == 0) {
+                options.use_cache = 0;
+            } else {
+                fprintf(stderr, "Error: Unknown assemble option '%s'.\n", argv[i]);
+                return 1;
+            }
+        }
+        if (assemble_with_options(input_file, output_file, &options) != 0) {
             fprintf(stderr, "Error: Assembly to binary conversion failed for '%s'.\n", input_file);
             return 1;
         }
 
         printf("Successfully assembled '%s' to '%s'.\n", input_file, output_file);
 
+    } else if (strcmp(command, "link") == 0) {
+        // Assemble and link several files; the first holds the entry point
+        if (argc < 4) {
+            fprintf(stderr, "Usage: %s link <output.bin> <a.asm|a.o> [b.asm|b.o ...] [--map <file>] [--keep-dead]\n", argv[0]);
+            return 1;
+        }
+
+        Linker linker;
+        init_linker(&linker);
+        const char *map_file = NULL;
+        int keep_dead = 0;
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) {
+                map_file = argv[++i];
+            } else if (strcmp(argv[i], "--keep-dead") == 0) {
+                keep_dead = 1;
+            } else if (strncmp(argv[i], "--", 2) == 0) {
+                fprintf(stderr, "Error: Unknown link option '%s'.\n", argv[i]);
+                free_linker(&linker);
+                return 1;
+            } else {
+                add_file_to_linker(&linker, argv[i]);
+            }
+        }
+        long removed = 0;
+        if (resolve_symbols(&linker) != 0 || (!keep_dead && (removed = eliminate_dead_code(&linker)) < 0) ||
+            generate_binary(&linker, input_file) != 0 || (map_file && write_link_map(&linker, map_file) != 0)) {
+            fprintf(stderr, "Error: Linking '%s' failed.\n", input_file);
+            free_linker(&linker);
+            return 1;
+        }
+
+        printf("Linked %d file(s) into '%s' (%zu bytes", linker.file_count, input_file,
+               linker.word_count * sizeof(uint32_t));
+        if (removed > 0) {
+            printf(", %ld unreachable bytes removed", removed);
+        }
+        printf(").\n");
+        free_linker(&linker);
+
+    } else if (strcmp(command, "debug") == 0) {
+        // Debug Binary File
+        init_cpu(&cpu);
+        if (load_binary_program(&cpu, input_file) != 0) {
+            fprintf(stderr, "Error: Failed to load binary file '%s'.\n", input_file);
+            return 1;
+        }
+
+        debug_program(&cpu);
+
     }else if (strcmp(command, "compile") == 0) {
         if (compile_and_execute_c_file(input_file) != 0) {
             return 1;
@@ -95,7 +220,12 @@ int main(int argc, char *argv[]) {
     } else if (strcmp(command, "run") == 0) {
         // Run Binary File
         init_cpu(&cpu);
-        display_memory_segments(&cpu);
+        if (output_file) {
+            parse_trace_option(output_file, &cpu);
+        }
+        if (cpu.trace_mode != TRACE_NONE) {
+            display_memory_segments(&cpu);
+        }
 
         if (load_binary_program(&cpu, input_file) != 0) {
             fprintf(stderr, "Error: Failed to load binary file '%s'.\n", input_file);
@@ -104,6 +234,37 @@ int main(int argc, char *argv[]) {
 
         run_cpu(&cpu);
 
+    } else if (strcmp(command, "exec") == 0) {
+        // Translate, assemble, load and run in memory
+        PipelineOptions options = { .kind = SOURCE_AUTO, .passes = 0, .optimize = 0, .save_asm = NULL, .save_bin = NULL };
+        init_cpu(&cpu);
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "--hll") == 0) {
+                options.kind = SOURCE_HLL;
+            } else if (strcmp(argv[i], "--asm") == 0) {
+                options.kind = SOURCE_ASSEMBLY;
+            } else if (strcmp(argv[i], "--peephole") == 0) {
+                options.optimize = 1;
+            } else if (strcmp(argv[i], "--save-asm") == 0 && i + 1 < argc) {
+                options.save_asm = argv[++i];
+            } else if (strcmp(argv[i], "--save-bin") == 0 && i + 1 < argc) {
+                options.save_bin = argv[++i];
+            } else if (!parse_pass_option(argv[i], &options.passes) && !parse_trace_option(argv[i], &cpu)) {
+                fprintf(stderr, "Error: Unknown exec option '%s'.\n", argv[i]);
+                return 1;
+            }
+        }
+        if (cpu.trace_mode != TRACE_NONE) {
+            display_memory_segments(&cpu);
+        }
+
+        if (load_source_file(&cpu, input_file, &options) != 0) {
+            fprintf(stderr, "Error: Failed to build '%s'.\n", input_file);
+            return 1;
+        }
+
+        run_cpu(&cpu);
+
     } else if (strcmp(command, "compile") == 0) {
         // Compile C Program and Run
         char command[256];
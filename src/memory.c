@@ -1,8 +1,11 @@
 
 #include "memory.h"
 #include "../include/cpu.h"
+#include "debugger.h"
+#include "object.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include <stdint.h>
 
@@ -16,18 +19,105 @@ uint32_t read_memory(const uint8_t *memory, uint32_t address) {
     return *((uint32_t *)&memory[address]); // Read 4 bytes as a single 32-bit value
 }
 
+// Read a 32-bit value on behalf of the guest program
+uint32_t read_data(CPU *cpu, uint32_t address) {
+    uint32_t value = read_memory(cpu->memory, address);
+
+    // Watchpoints cost one bit test unless the line is actually watched
+    uint32_t first = address / DIRTY_LINE_SIZE;
+    uint32_t last = (address + 3) / DIRTY_LINE_SIZE;
+    if (((cpu->watch_lines[first / 64] >> (first % 64)) | (cpu->watch_lines[last / 64] >> (last % 64))) & 1) {
+        check_watchpoints(cpu, address, sizeof(uint32_t), WATCH_READ);
+    }
+    return value;
+}
+
 // Write a 32-bit value to memory
-void write_memory(uint8_t *memory, uint32_t address, uint32_t value) {
+void write_memory(CPU *cpu, uint32_t address, uint32_t value) {
     if (address + 4 > MEMORY_SIZE) {
         fprintf(stderr, "Error: Memory write out of bounds at address 0x%08X.\n", address);
         exit(EXIT_FAILURE);
     }
-    *((uint32_t *)&memory[address]) = value; // Write 4 bytes as a single 32-bit value
+    *((uint32_t *)&cpu->memory[address]) = value; // Write 4 bytes as a single 32-bit value
+
+    // A word touches at most two lines
+    uint32_t first = address / DIRTY_LINE_SIZE;
+    uint32_t last = (address + 3) / DIRTY_LINE_SIZE;
+    cpu->dirty_lines[first / 64] |= 1ull << (first % 64);
+    cpu->dirty_lines[last / 64] |= 1ull << (last % 64);
+
+    if (address < CODE_END) {
+        cpu->events |= EVENT_CODE_WRITE; // Predecoded instructions may be stale
+    }
+    if (((cpu->watch_lines[first / 64] >> (first % 64)) | (cpu->watch_lines[last / 64] >> (last % 64))) & 1) {
+        check_watchpoints(cpu, address, sizeof(uint32_t), WATCH_WRITE);
+    }
+}
+
+// Mark all lines overlapping [address, address + length) as dirty
+void mark_memory_dirty(CPU *cpu, uint32_t address, uint32_t length) {
+    if (length == 0) {
+        return;
+    }
+    uint32_t last = (address + length - 1) / DIRTY_LINE_SIZE;
+    for (uint32_t line = address / DIRTY_LINE_SIZE; line <= last && line < NUM_DIRTY_LINES; line++) {
+        cpu->dirty_lines[line / 64] |= 1ull << (line % 64);
+    }
+}
+
+bool block_in_bounds(uint32_t address, uint32_t length) {
+    return length <= MEMORY_SIZE && address <= MEMORY_SIZE - length;
+}
+
+uint32_t segment_end(uint32_t address) {
+    if (address < CODE_END) return CODE_END;
+    if (address < DATA_END) return DATA_END;
+    if (address < STACK_END) return STACK_END;
+    if (address < HEAP_END) return HEAP_END;
+    return 0;
+}
+
+bool block_in_segment(uint32_t address, uint32_t length) {
+    if (length == 0) {
+        return true;
+    }
+    uint32_t end = segment_end(address);
+    return end != 0 && length <= end - address; // 0: past the end of memory
+}
+
+// True if any line of the block holds a watchpoint
+static bool block_watched(const CPU *cpu, uint32_t address, uint32_t length) {
+    if (length == 0) {
+        return false;
+    }
+    uint32_t last = (address + length - 1) / DIRTY_LINE_SIZE;
+    for (uint32_t line = address / DIRTY_LINE_SIZE; line <= last; line++) {
+        if ((cpu->watch_lines[line / 64] >> (line % 64)) & 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void note_block_read(CPU *cpu, uint32_t address, uint32_t length) {
+    if (block_watched(cpu, address, length)) {
+        check_watchpoints(cpu, address, length, WATCH_READ);
+    }
+}
+
+void note_block_write(CPU *cpu, uint32_t address, uint32_t length) {
+    mark_memory_dirty(cpu, address, length);
+    if (address < CODE_END && length > 0) {
+        cpu->events |= EVENT_CODE_WRITE;
+    }
+    if (block_watched(cpu, address, length)) {
+        check_watchpoints(cpu, address, length, WATCH_WRITE);
+    }
 }
 
 // Load a program into the code segment
-int load_program(uint8_t *memory, const uint32_t *program, uint32_t size) {
-    if (memory == NULL || program == NULL) {
+int load_program(CPU *cpu, const uint32_t *program, uint32_t size) {
+    if (cpu == NULL || program == NULL) {
         fprintf(stderr, "Error: NULL pointer passed to load_program.\n");
         return -1; // Failure
     }
@@ -37,13 +127,84 @@ int load_program(uint8_t *memory, const uint32_t *program, uint32_t size) {
     }
     for (uint32_t i = 0; i < size; i++) {
         uint32_t address = CODE_START + i * sizeof(uint32_t);
-        write_memory(memory, address, program[i]);
+        write_memory(cpu, address, program[i]);
         printf("Loaded instruction %08X at address %08X\n", program[i], address); // Debug log
     }
     return 0; // Success
 }
 
+// Keep an executable's code symbols, sorted by address, for traces and profiles
+static void load_program_symbols(CPU *cpu, const ObjectFile *object) {
+    cpu->symbol_count = 0;
+    for (uint32_t i = 0; i < object->header.symbol_count; i++) {
+        const ObjectSymbol *symbol = &object->symbols[i];
+        if (symbol->section != SECTION_CODE || cpu->symbol_count == MAX_PROGRAM_SYMBOLS) {
+            continue;
+        }
+        int slot = cpu->symbol_count++;
+        while (slot > 0 && cpu->symbols[slot - 1].address > symbol->value) {
+            cpu->symbols[slot] = cpu->symbols[slot - 1];
+            slot--;
+        }
+        cpu->symbols[slot].address = symbol->value;
+        snprintf(cpu->symbols[slot].name, PROGRAM_SYMBOL_MAX, "%s", object_symbol_name(object, symbol));
+    }
+}
+
+// Guest memory is part of the CPU, so each section is copied in, straight
+// out of the file mapping for an object read from disk
+int load_executable_object(CPU *cpu, const ObjectFile *object, const char *name) {
+    const ObjectHeader *header = &object->header;
+    const ObjectSection *code = &header->sections[SECTION_CODE];
+    const ObjectSection *data = &header->sections[SECTION_DATA];
+    const ObjectSection *bss = &header->sections[SECTION_BSS];
+    const char *problem = NULL;
+    if (header->type != OBJ_EXECUTABLE) {
+        problem = "is a relocatable object; link it first";
+    } else if (code->address != CODE_START || code->size > CODE_END - CODE_START) {
+        problem = "has a code section outside the code segment";
+    } else if (data->address < DATA_START || data->address > DATA_END || data->size > DATA_END - data->address ||
+               bss->address < DATA_START || bss->address > DATA_END || bss->size > DATA_END - bss->address) {
+        problem = "has a data section outside the data segment";
+    } else if (code->size > 0 && (header->entry % 4 != 0 || header->entry < CODE_START || header->entry >= CODE_START + code->size)) {
+        problem = "has an entry point outside its code";
+    }
+    if (problem) {
+        fprintf(stderr, "Error: '%s' %s.\n", name, problem);
+        return -1;
+    }
+
+    if (code->size > 0) {
+        memcpy(&cpu->memory[code->address], object->contents[SECTION_CODE], code->size);
+    }
+    if (data->size > 0) {
+        memcpy(&cpu->memory[data->address], object->contents[SECTION_DATA], data->size);
+    }
+    memset(&cpu->memory[bss->address], 0, bss->size);
+    cpu->pc = header->entry;
+    load_program_symbols(cpu, object);
+
+    printf("Executable loaded: %s (code: %u bytes, data: %u bytes, bss: %u bytes, entry: %08X)\n",
+           name, code->size, data->size, bss->size, header->entry);
+    return 0;
+}
+
+static int load_executable(CPU *cpu, const char *file_path) {
+    ObjectFile object;
+    if (object_open(file_path, &object) != 0) {
+        return -1;
+    }
+    int status = load_executable_object(cpu, &object, file_path);
+    object_close(&object);
+    return status;
+}
+
 int load_binary_program(CPU *cpu, const char *file_path) {
+    if (object_is_object_file(file_path)) {
+        return load_executable(cpu, file_path);
+    }
+
+    // Raw image: 32-bit words copied to the start of the code segment
     FILE *file = fopen(file_path, "rb");
     if (!file) {
         fprintf(stderr, "Error: Cannot open binary file '%s'.\n", file_path);
@@ -71,6 +232,34 @@ int load_binary_program(CPU *cpu, const char *file_path) {
     return 0;
 }
 
+const ProgramSymbol *symbol_for_address(const CPU *cpu, uint32_t address, uint32_t *offset) {
+    // Last symbol at or below the address
+    int low = 0, high = cpu->symbol_count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (cpu->symbols[middle].address <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == 0) {
+        return NULL;
+    }
+    *offset = address - cpu->symbols[low - 1].address;
+    return &cpu->symbols[low - 1];
+}
+
+int symbol_address(const CPU *cpu, const char *name, uint32_t *address) {
+    for (int i = 0; i < cpu->symbol_count; i++) {
+        if (strcmp(cpu->symbols[i].name, name) == 0) {
+            *address = cpu->symbols[i].address;
+            return 0;
+        }
+    }
+    return -1;
+}
+
 
 // Display memory contents
 void display_memory(const uint8_t *memory, uint32_t start, uint32_t end, char format) {
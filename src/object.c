@@ -0,0 +1,192 @@
+#include "object.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint32_t align_up(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Write a block at an offset; seeking past the end leaves zero padding
+static int write_at(FILE *file, uint32_t offset, const void *data, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    if (fseek(file, offset, SEEK_SET) != 0 || fwrite(data, 1, size, file) != size) {
+        return -1;
+    }
+    return 0;
+}
+
+int object_write(const char *path, const ObjectFile *object) {
+    ObjectHeader header = object->header;
+    header.magic = OBJ_MAGIC;
+    header.version = OBJ_VERSION;
+    header.page_size = OBJ_PAGE_SIZE;
+
+    // Lay out the file: page-aligned contents, then the tables
+    uint32_t offset = sizeof(ObjectHeader);
+    for (int i = 0; i < OBJ_NUM_SECTIONS; i++) {
+        ObjectSection *section = &header.sections[i];
+        if (i == SECTION_BSS || section->size == 0) {
+            section->offset = 0;
+            continue;
+        }
+        section->offset = align_up(offset, OBJ_PAGE_SIZE);
+        offset = section->offset + section->size;
+    }
+    header.symbol_offset = align_up(offset, 4);
+    header.string_offset = header.symbol_offset + header.symbol_count * sizeof(ObjectSymbol);
+    header.reloc_offset = align_up(header.string_offset + header.string_size, 4);
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file '%s'.\n", path);
+        return -1;
+    }
+    int status = write_at(file, 0, &header, sizeof(header));
+    for (int i = 0; i < OBJ_NUM_SECTIONS && status == 0; i++) {
+        if (header.sections[i].offset) {
+            status = write_at(file, header.sections[i].offset, object->contents[i], header.sections[i].size);
+        }
+    }
+    if (status == 0) {
+        status = write_at(file, header.symbol_offset, object->symbols, header.symbol_count * sizeof(ObjectSymbol));
+    }
+    if (status == 0) {
+        status = write_at(file, header.string_offset, object->strings, header.string_size);
+    }
+    if (status == 0) {
+        status = write_at(file, header.reloc_offset, object->relocs, header.reloc_count * sizeof(ObjectReloc));
+    }
+    if (fclose(file) != 0 || status != 0) {
+        fprintf(stderr, "Error: Failed to write '%s'.\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int object_is_object_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    uint32_t magic = 0;
+    if (!file) {
+        return 0;
+    }
+    size_t read = fread(&magic, sizeof(magic), 1, file);
+    fclose(file);
+    return read == 1 && magic == OBJ_MAGIC;
+}
+
+// A table of count entries at offset must lie inside the file (an empty
+// table may sit at the aligned end of it)
+static int table_fits(size_t file_size, uint32_t offset, uint64_t count, size_t entry_size) {
+    return count == 0 || (offset <= file_size && count * entry_size <= file_size - offset);
+}
+
+// Bounds are checked before the tables they cover are read
+static int validate(const ObjectFile *object) {
+    const ObjectHeader *header = &object->header;
+    size_t size = object->mapping_size;
+    if (header->version != OBJ_VERSION ||
+        (header->type != OBJ_EXECUTABLE && header->type != OBJ_RELOCATABLE)) {
+        return -1;
+    }
+    for (int i = 0; i < OBJ_NUM_SECTIONS; i++) {
+        const ObjectSection *section = &header->sections[i];
+        if (i != SECTION_BSS && section->size > 0 && !table_fits(size, section->offset, section->size, 1)) {
+            return -1;
+        }
+    }
+    if (!table_fits(size, header->symbol_offset, header->symbol_count, sizeof(ObjectSymbol)) ||
+        !table_fits(size, header->string_offset, header->string_size, 1) ||
+        !table_fits(size, header->reloc_offset, header->reloc_count, sizeof(ObjectReloc))) {
+        return -1;
+    }
+    if (header->symbol_offset % 4 != 0 || header->reloc_offset % 4 != 0) {
+        return -1;
+    }
+    if (header->string_size > 0 && object->strings[header->string_size - 1] != '\0') {
+        return -1;
+    }
+    for (uint32_t i = 0; i < header->symbol_count; i++) {
+        const ObjectSymbol *symbol = &object->symbols[i];
+        if (symbol->name >= header->string_size ||
+            (symbol->section >= OBJ_NUM_SECTIONS && symbol->section != SECTION_UNDEFINED)) {
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < header->reloc_count; i++) {
+        const ObjectReloc *reloc = &object->relocs[i];
+        if (reloc->symbol >= header->symbol_count || reloc->section >= SECTION_BSS ||
+            reloc->offset % 4 != 0 || (uint64_t)reloc->offset + 4 > header->sections[reloc->section].size) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int object_open(const char *path, ObjectFile *object) {
+    memset(object, 0, sizeof(*object));
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Error: Cannot open file '%s'.\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    if ((size_t)info.st_size < sizeof(ObjectHeader)) {
+        fprintf(stderr, "Error: '%s' is not an object file.\n", path);
+        close(fd);
+        return -1;
+    }
+    object->mapping_size = (size_t)info.st_size;
+    object->mapping = mmap(NULL, object->mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (object->mapping == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map file '%s'.\n", path);
+        object->mapping = NULL;
+        return -1;
+    }
+
+    const uint8_t *base = object->mapping;
+    memcpy(&object->header, base, sizeof(ObjectHeader));
+    if (object->header.magic != OBJ_MAGIC) {
+        fprintf(stderr, "Error: '%s' is not an object file.\n", path);
+        object_close(object);
+        return -1;
+    }
+    for (int i = 0; i < OBJ_NUM_SECTIONS; i++) {
+        const ObjectSection *section = &object->header.sections[i];
+        object->contents[i] = (i != SECTION_BSS && section->size > 0) ? base + section->offset : NULL;
+    }
+    object->symbols = (const ObjectSymbol *)(base + object->header.symbol_offset);
+    object->strings = (const char *)(base + object->header.string_offset);
+    object->relocs = (const ObjectReloc *)(base + object->header.reloc_offset);
+
+    if (validate(object) != 0) {
+        fprintf(stderr, "Error: Object file '%s' is malformed.\n", path);
+        object_close(object);
+        return -1;
+    }
+    return 0;
+}
+
+void object_close(ObjectFile *object) {
+    if (object->mapping) {
+        munmap(object->mapping, object->mapping_size);
+    } else {
+        for (int i = 0; i < OBJ_NUM_SECTIONS; i++) {
+            free((void *)object->contents[i]);
+        }
+        free((void *)object->symbols);
+        free((void *)object->strings);
+        free((void *)object->relocs);
+    }
+    memset(object, 0, sizeof(*object));
+}
@@ -0,0 +1,804 @@
+#include "peephole.h"
+#include "cpu.h"    // NUM_REGISTERS, opcode descriptors
+#include "symtab.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define PEEP_TEXT 32        // Longest operand the assembler reads, plus NUL
+#define PEEP_LINE_MAX 256   // Longest source line the assembler accepts
+#define PEEP_MAX_ROUNDS 8   // Passes stop earlier once nothing changes
+#define PEEP_THREAD_HOPS 16 // Bounds jump threading through JUMP cycles
+
+typedef enum {
+    ITEM_LABEL,       // "name:"
+    ITEM_INSTRUCTION, // Parsed instruction
+    ITEM_VERBATIM     // Directive or unparsed line, copied as is
+} ItemKind;
+
+typedef struct {
+    uint8_t kind;             // ItemKind
+    uint8_t removed;
+    uint8_t operand_count;
+    Opcode opcode;
+    uint32_t line;            // Source line the item came from
+    char text[3][PEEP_TEXT];  // Operands, or the label name in text[0]
+    char *verbatim;           // ITEM_VERBATIM: the line without its newline
+} Item;
+
+typedef struct {
+    Item *items;
+    size_t count;
+    size_t capacity;
+    PeepholeStats stats;
+} Program;
+
+// What the optimizer knows about a register within a basic block
+typedef struct {
+    char constant[PEEP_TEXT]; // Value it holds (number or label), or ""
+    char location[PEEP_TEXT]; // Absolute memory location it mirrors, or ""
+} RegisterState;
+
+typedef enum {
+    SOURCE_UNKNOWN,
+    SOURCE_CONSTANT,  // Immediate number or label
+    SOURCE_REGISTER,  // Rn
+    SOURCE_LOCATION   // [addr] with an absolute address
+} SourceKind;
+
+static Item *add_item(Program *program, ItemKind kind, uint32_t line) {
+    if (program->count == program->capacity) {
+        program->capacity = program->capacity ? program->capacity * 2 : 256;
+        program->items = realloc(program->items, program->capacity * sizeof(Item));
+        if (!program->items) {
+            fprintf(stderr, "Error: Out of memory in the peephole optimizer.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    Item *item = &program->items[program->count++];
+    memset(item, 0, sizeof(*item));
+    item->kind = (uint8_t)kind;
+    item->line = line;
+    return item;
+}
+
+static void trim(char *text) {
+    size_t start = 0, length = strlen(text);
+    while (start < length && isspace((unsigned char)text[start])) {
+        start++;
+    }
+    while (length > start && isspace((unsigned char)text[length - 1])) {
+        length--;
+    }
+    memmove(text, text + start, length - start);
+    text[length - start] = '\0';
+}
+
+// Parse an instruction the way the assembler will; 0 if it would not accept it
+static int parse_instruction(Item *item, const char *text) {
+    char line[PEEP_LINE_MAX], mnemonic[16] = "";
+    snprintf(line, sizeof(line), "%.*s", (int)strcspn(text, ";"), text);
+    if (sscanf(line, "%15s %31[^,], %31[^,], %31[^\n]", mnemonic, item->text[0], item->text[1], item->text[2]) < 1) {
+        return 0;
+    }
+    int op = find_opcode(mnemonic);
+    if (op < 0) {
+        return 0;
+    }
+    item->opcode = (Opcode)op;
+    item->operand_count = (uint8_t)opcode_table[op].operand_count;
+    for (int i = 0; i < 3; i++) {
+        trim(item->text[i]);
+        if (i >= item->operand_count && item->text[i][0] != '\0') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void add_verbatim(Program *program, const char *text, uint32_t line) {
+    Item *item = add_item(program, ITEM_VERBATIM, line);
+    item->verbatim = strdup(text);
+}
+
+// Split the source into labels, instructions and verbatim lines
+static int parse_program(Program *program, const char *source, size_t size) {
+    char line[PEEP_LINE_MAX];
+    const char *end = source + size;
+    uint32_t number = 0;
+    for (const char *p = source; p < end; ) {
+        const char *newline = memchr(p, '\n', (size_t)(end - p));
+        size_t length = (size_t)((newline ? newline : end) - p);
+        number++;
+        if (length >= sizeof(line)) {
+            return -1; // The assembler reports it
+        }
+        memcpy(line, p, length);
+        line[length] = '\0';
+        p += length + 1;
+
+        char *text = line;
+        while (isspace((unsigned char)*text)) {
+            text++;
+        }
+        if (*text == '\0' || *text == ';') {
+            continue;
+        }
+        if (*text == '.') {
+            add_verbatim(program, text, number); // Directive
+            continue;
+        }
+        size_t token = strcspn(text, " \t\r;");
+        char *colon = memchr(text, ':', token);
+        if (colon) {
+            if ((size_t)(colon - text) >= PEEP_TEXT) {
+                add_verbatim(program, text, number);
+                continue;
+            }
+            Item *label = add_item(program, ITEM_LABEL, number);
+            memcpy(label->text[0], text, (size_t)(colon - text));
+            text = colon + 1;
+            while (isspace((unsigned char)*text)) {
+                text++;
+            }
+            if (*text == '\0' || *text == ';') {
+                continue;
+            }
+        }
+        Item *item = add_item(program, ITEM_INSTRUCTION, number);
+        if (parse_instruction(item, text)) {
+            program->stats.instructions++;
+        } else {
+            item->kind = ITEM_VERBATIM;
+            item->verbatim = strdup(text);
+        }
+    }
+    return 0;
+}
+
+// Operand classification
+
+static int register_index(const char *text) {
+    if (toupper((unsigned char)text[0]) != 'R' || !isdigit((unsigned char)text[1])) {
+        return -1;
+    }
+    char *end;
+    long index = strtol(text + 1, &end, 10);
+    return (*end == '\0' && index < NUM_REGISTERS) ? (int)index : -1;
+}
+
+// Register in a register-number field: "Rn", or a bare number ("LOAD 0, 3")
+static int field_register(const char *text) {
+    if (!isdigit((unsigned char)text[0])) {
+        return register_index(text);
+    }
+    char *end;
+    long index = strtol(text, &end, 0);
+    return (*end == '\0' && index < NUM_REGISTERS) ? (int)index : -1;
+}
+
+static int is_label_text(const char *text) {
+    return isalpha((unsigned char)text[0]) || text[0] == '_';
+}
+
+static int is_number_text(const char *text) {
+    return isdigit((unsigned char)text[0]) || (text[0] == '-' && isdigit((unsigned char)text[1]));
+}
+
+// Registers named anywhere in an operand ("R3", "[R3+4]")
+static uint32_t named_registers(const char *text) {
+    uint32_t mask = 0;
+    for (const char *p = text; *p; p++) {
+        if (toupper((unsigned char)*p) != 'R' || (p > text && (isalnum((unsigned char)p[-1]) || p[-1] == '_'))) {
+            continue;
+        }
+        char name[PEEP_TEXT];
+        size_t length = 1;
+        while (isalnum((unsigned char)p[length]) || p[length] == '_') {
+            length++;
+        }
+        snprintf(name, sizeof(name), "%.*s", (int)length, p);
+        int index = register_index(name);
+        if (index >= 0) {
+            mask |= 1u << index;
+        }
+        p += length - 1;
+    }
+    return mask;
+}
+
+// Registers an operand names. A bare number where a register is implicit
+// ("ADD R2, 5, R1") names register 5.
+static uint32_t operand_registers(OperandKind kind, const char *text) {
+    uint32_t mask = named_registers(text);
+    if (kind == OPK_DEST || kind == OPK_REG || kind == OPK_ADDR) {
+        int index = field_register(text);
+        if (index >= 0) {
+            mask |= 1u << index;
+        }
+    }
+    return mask;
+}
+
+// Canonical text of a constant: numbers in decimal, labels as written
+static void canonical_constant(const char *text, char *out) {
+    if (is_number_text(text)) {
+        snprintf(out, PEEP_TEXT, "%u", (uint32_t)strtol(text, NULL, 0));
+    } else {
+        snprintf(out, PEEP_TEXT, "%s", text);
+    }
+}
+
+static int numeric_constant(const char *constant, uint32_t *value) {
+    if (!is_number_text(constant)) {
+        return 0;
+    }
+    *value = (uint32_t)strtoul(constant, NULL, 10);
+    return 1;
+}
+
+// Absolute memory location of "[addr]", or 0 for indirect/indexed operands
+static int absolute_location(const char *text, char *location) {
+    size_t length = strlen(text);
+    if (text[0] != '[' || length < 3 || text[length - 1] != ']' || text[1] == '[') {
+        return 0;
+    }
+    char inner[PEEP_TEXT];
+    snprintf(inner, sizeof(inner), "%.*s", (int)(length - 2), text + 1);
+    trim(inner);
+    if (named_registers(inner) != 0 || (!is_label_text(inner) && !is_number_text(inner))) {
+        return 0;
+    }
+    canonical_constant(inner, location);
+    return 1;
+}
+
+// How a source operand gets its value (value receives the constant or location)
+static SourceKind classify_source(OperandKind kind, const char *text, char *value, int *reg) {
+    *reg = register_index(text);
+    if (*reg >= 0) {
+        return SOURCE_REGISTER;
+    }
+    if (text[0] == '#') {
+        if (!is_label_text(text + 1) && !is_number_text(text + 1)) {
+            return SOURCE_UNKNOWN;
+        }
+        canonical_constant(text + 1, value);
+        return SOURCE_CONSTANT;
+    }
+    if (text[0] == '[') {
+        return absolute_location(text, value) ? SOURCE_LOCATION : SOURCE_UNKNOWN;
+    }
+    if (is_label_text(text)) {
+        canonical_constant(text, value); // A label where a register is implicit is an immediate
+        return SOURCE_CONSTANT;
+    }
+    if (is_number_text(text)) {
+        if (kind == OPK_IMM) {
+            canonical_constant(text, value);
+            return SOURCE_CONSTANT;
+        }
+        long index = strtol(text, NULL, 0);
+        *reg = (index >= 0 && index < NUM_REGISTERS) ? (int)index : -1;
+        return *reg >= 0 ? SOURCE_REGISTER : SOURCE_UNKNOWN;
+    }
+    return SOURCE_UNKNOWN;
+}
+
+// Numeric value of a source operand, if the block has established one
+static int known_value(const RegisterState *state, OperandKind kind, const char *text, uint32_t *value) {
+    char constant[PEEP_TEXT];
+    int reg;
+    switch (classify_source(kind, text, constant, &reg)) {
+        case SOURCE_CONSTANT: return numeric_constant(constant, value);
+        case SOURCE_REGISTER: return numeric_constant(state[reg].constant, value);
+        default: return 0;
+    }
+}
+
+// Instruction properties
+
+static int is_compare_branch(Opcode op) {
+    return op >= BEQ && op <= BLE;
+}
+
+static int ends_block(Opcode op) {
+    return op == JUMP || op == JZ || op == JNZ || op == CALL || op == RET || op == HALT ||
+           op == BRK || op == DJNZ || op == LOOP || is_compare_branch(op);
+}
+
+static int is_unconditional(Opcode op) {
+    return op == JUMP || op == RET || op == HALT;
+}
+
+static int writes_flags(Opcode op) {
+    return op == ADD || op == SUB || (op >= EQ && op <= LE) || op == ALLOC || op == MEMCMP || op == VCMP;
+}
+
+static int writes_memory(Opcode op) {
+    return op == STORE || op == PUSH || op == CALL || op == MEMCPY || op == MEMSET ||
+           op == VSTORE || op == ALLOC || op == FREE;
+}
+
+// Operand holding a code label, or -1
+static int target_operand(Opcode op) {
+    if (op == JUMP || op == JZ || op == JNZ || op == CALL) {
+        return 0;
+    }
+    if (op == DJNZ || op == LOOP) {
+        return 1;
+    }
+    return is_compare_branch(op) ? 2 : -1;
+}
+
+// Register an instruction writes through its destination field, or -1
+static int destination(const Item *item) {
+    if (opcode_table[item->opcode].kinds[0] != OPK_DEST || item->opcode == OUT) {
+        return -1;
+    }
+    return field_register(item->text[0]);
+}
+
+static uint32_t registers_read(const Item *item) {
+    const OpcodeInfo *info = &opcode_table[item->opcode];
+    uint32_t mask = 0;
+    for (int i = 0; i < item->operand_count; i++) {
+        if (i == 0 && destination(item) >= 0 && item->opcode != DJNZ) {
+            continue; // Written, not read
+        }
+        mask |= operand_registers(info->kinds[i], item->text[i]);
+    }
+    return mask;
+}
+
+// Instructions that only compute a register (and possibly flags)
+static int is_pure(Opcode op) {
+    return op == LOAD || op == ADD || op == SUB || op == MUL || op == AND || op == OR || op == XOR ||
+           op == NOT || op == SHL || op == SHR || (op >= EQ && op <= LE);
+}
+
+static Item *next_live(Program *program, size_t *index) {
+    while (*index < program->count && program->items[*index].removed) {
+        (*index)++;
+    }
+    return *index < program->count ? &program->items[*index] : NULL;
+}
+
+// Flags are dead if they are rewritten before anything can read them.
+// Only the rest of the block is searched.
+static int flags_dead_after(Program *program, size_t index) {
+    for (size_t j = index + 1; ; j++) {
+        const Item *item = next_live(program, &j);
+        if (!item || item->kind != ITEM_INSTRUCTION || item->opcode == JZ || item->opcode == JNZ) {
+            return 0;
+        }
+        if (writes_flags(item->opcode)) {
+            return 1;
+        }
+        if (ends_block(item->opcode)) {
+            return 0;
+        }
+    }
+}
+
+static int register_dead_after(Program *program, size_t index, int reg) {
+    for (size_t j = index + 1; ; j++) {
+        const Item *item = next_live(program, &j);
+        if (!item || item->kind != ITEM_INSTRUCTION || (registers_read(item) & (1u << reg))) {
+            return 0;
+        }
+        if (destination(item) == reg) {
+            return 1;
+        }
+        if (ends_block(item->opcode)) {
+            return 0;
+        }
+    }
+}
+
+static void remove_item(Program *program, Item *item) {
+    item->removed = 1;
+    program->stats.removed++;
+}
+
+static void rewrite_as_load(Program *program, Item *item, uint32_t value) {
+    char destination_text[PEEP_TEXT];
+    memcpy(destination_text, item->text[0], PEEP_TEXT);
+    memset(item->text, 0, sizeof(item->text));
+    memcpy(item->text[0], destination_text, PEEP_TEXT);
+    snprintf(item->text[1], PEEP_TEXT, "0x%X", value);
+    item->opcode = LOAD;
+    item->operand_count = 2;
+    program->stats.rewritten++;
+}
+
+// Result of an ALU instruction on known operands; 0 if it cannot be folded
+static int fold(const Item *item, const RegisterState *state, uint32_t *result) {
+    const OpcodeInfo *info = &opcode_table[item->opcode];
+    uint32_t a, b;
+    if (!known_value(state, info->kinds[1], item->text[1], &a)) {
+        return 0;
+    }
+    if (item->opcode == NOT) {
+        *result = ~a;
+        return 1;
+    }
+    if (item->opcode == SHL || item->opcode == SHR) {
+        if (!is_number_text(item->text[2])) {
+            return 0;
+        }
+        uint32_t shift = (uint32_t)strtol(item->text[2], NULL, 0) & 0xFF; // Encoded in 8 bits
+        *result = shift >= 32 ? 0 : (item->opcode == SHL ? a << shift : a >> shift);
+        return 1;
+    }
+    if (!known_value(state, info->kinds[2], item->text[2], &b)) {
+        return 0;
+    }
+    switch (item->opcode) {
+        case ADD: *result = a + b; return 1;
+        case SUB: *result = a - b; return 1;
+        case MUL: *result = a * b; return 1;
+        case DIV:
+            if (b == 0) {
+                return 0; // Leave the run-time error in place
+            }
+            *result = a / b;
+            return 1;
+        case AND: *result = a & b; return 1;
+        case OR:  *result = a | b; return 1;
+        case XOR: *result = a ^ b; return 1;
+        default:  return 0;
+    }
+}
+
+static int branch_taken(Opcode op, int32_t a, int32_t b) {
+    switch (op) {
+        case BEQ: return a == b;
+        case BNE: return a != b;
+        case BLT: return a < b;
+        case BGE: return a >= b;
+        case BGT: return a > b;
+        default:  return a <= b;
+    }
+}
+
+static void forget_locations(RegisterState *state) {
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        state[r].location[0] = '\0';
+    }
+}
+
+// Fused branch for each compare (EQ..LE), taken when the compare gives 1
+// (JNZ) or 0 (JZ)
+static const Opcode fused_if_true[] = { BEQ, BNE, BGT, BLT, BGE, BLE };
+static const Opcode fused_if_false[] = { BNE, BEQ, BLE, BGE, BLT, BGT };
+
+// Item after which the code at a label starts: the last of the labels there.
+// 0 if the target is not a label of this program.
+static int label_position(Program *program, const SymbolTable *labels, const char *name, size_t *index) {
+    uint32_t label;
+    if (!is_label_text(name) || !symtab_lookup(labels, name, &label)) {
+        return 0;
+    }
+    *index = label;
+    for (size_t j = label + 1; ; j++) {
+        const Item *next = next_live(program, &j);
+        if (!next || next->kind != ITEM_LABEL) {
+            return 1;
+        }
+        *index = j;
+    }
+}
+
+// "GT Rt, a, b ; JZ L" becomes "BLE a, b, L" when neither Rt nor the flags
+// are read on either path out of the JZ
+static int fuse_compare(Program *program, const SymbolTable *labels, size_t index) {
+    Item *item = &program->items[index];
+    size_t j = index + 1;
+    Item *jump = next_live(program, &j);
+    int reg = destination(item);
+    size_t target;
+    if (reg < 0 || !jump || jump->kind != ITEM_INSTRUCTION || (jump->opcode != JZ && jump->opcode != JNZ) ||
+        !label_position(program, labels, jump->text[0], &target) ||
+        !register_dead_after(program, j, reg) || !flags_dead_after(program, j) ||
+        !register_dead_after(program, target, reg) || !flags_dead_after(program, target)) {
+        return 0;
+    }
+    memcpy(item->text[0], item->text[1], PEEP_TEXT);
+    memcpy(item->text[1], item->text[2], PEEP_TEXT);
+    memcpy(item->text[2], jump->text[0], PEEP_TEXT);
+    item->opcode = (jump->opcode == JNZ ? fused_if_true : fused_if_false)[item->opcode - EQ];
+    program->stats.rewritten++;
+    remove_item(program, jump);
+    return 1;
+}
+
+// Redundant LOAD/STORE elimination, constant propagation and compare fusion,
+// one block at a time
+static void propagate_values(Program *program) {
+    RegisterState state[NUM_REGISTERS];
+    memset(state, 0, sizeof(state));
+    SymbolTable labels;
+    symtab_init(&labels);
+    for (size_t i = 0; i < program->count; i++) {
+        if (program->items[i].kind == ITEM_LABEL && !program->items[i].removed) {
+            symtab_define(&labels, program->items[i].text[0], (uint32_t)i);
+        }
+    }
+
+    for (size_t i = 0; i < program->count; i++) {
+        Item *item = &program->items[i];
+        if (item->removed) {
+            continue;
+        }
+        if (item->kind != ITEM_INSTRUCTION) {
+            memset(state, 0, sizeof(state)); // A label may be entered from anywhere
+            continue;
+        }
+
+        const OpcodeInfo *info = &opcode_table[item->opcode];
+        int d = destination(item);
+        char value[PEEP_TEXT] = "";
+        int reg;
+        uint32_t result;
+
+        if (item->opcode == LOAD && d >= 0) {
+            RegisterState loaded = { "", "" };
+            switch (classify_source(info->kinds[1], item->text[1], value, &reg)) {
+                case SOURCE_CONSTANT:
+                    if (strcmp(state[d].constant, value) == 0) {
+                        remove_item(program, item); // Same constant again
+                        continue;
+                    }
+                    snprintf(loaded.constant, PEEP_TEXT, "%s", value);
+                    break;
+                case SOURCE_LOCATION:
+                    if (strcmp(state[d].location, value) == 0) {
+                        remove_item(program, item); // Already holds that word
+                        continue;
+                    }
+                    snprintf(loaded.location, PEEP_TEXT, "%s", value);
+                    for (int r = 0; r < NUM_REGISTERS; r++) {
+                        if (r != d && strcmp(state[r].location, value) == 0) {
+                            snprintf(item->text[1], PEEP_TEXT, "R%d", r); // Copy instead of reading memory
+                            program->stats.rewritten++;
+                            loaded = state[r];
+                            break;
+                        }
+                    }
+                    break;
+                case SOURCE_REGISTER:
+                    if (reg == d ||
+                        (state[d].constant[0] && strcmp(state[d].constant, state[reg].constant) == 0) ||
+                        (state[d].location[0] && strcmp(state[d].location, state[reg].location) == 0)) {
+                        remove_item(program, item);
+                        continue;
+                    }
+                    loaded = state[reg];
+                    break;
+                default:
+                    break;
+            }
+            state[d] = loaded;
+            continue;
+        }
+
+        if (item->opcode == STORE) {
+            char location[PEEP_TEXT] = "";
+            const char *address = item->text[1];
+            int known = absolute_location(address, location);
+            if (!known && (address[0] == '#' || (is_label_text(address) && register_index(address) < 0))) {
+                canonical_constant(address[0] == '#' ? address + 1 : address, location); // Immediate address
+                known = 1;
+            }
+            SourceKind source = classify_source(info->kinds[0], item->text[0], value, &reg);
+            if (known && source == SOURCE_REGISTER && strcmp(state[reg].location, location) == 0) {
+                remove_item(program, item); // Storing back what was loaded from there
+                continue;
+            }
+            forget_locations(state); // Other locations may overlap this one
+            if (known && source == SOURCE_REGISTER) {
+                snprintf(state[reg].location, PEEP_TEXT, "%s", location);
+            }
+            continue;
+        }
+
+        if (d >= 0 && is_pure(item->opcode) && fold(item, state, &result) &&
+            (!writes_flags(item->opcode) || flags_dead_after(program, i))) {
+            rewrite_as_load(program, item, result);
+            memset(&state[d], 0, sizeof(state[d]));
+            snprintf(state[d].constant, PEEP_TEXT, "%u", result);
+            continue;
+        }
+
+        if (item->opcode >= EQ && item->opcode <= LE && fuse_compare(program, &labels, i)) {
+            info = &opcode_table[item->opcode];
+            d = -1; // The fused branch writes no register
+        }
+
+        if (is_compare_branch(item->opcode)) {
+            uint32_t a, b;
+            if (known_value(state, info->kinds[0], item->text[0], &a) &&
+                known_value(state, info->kinds[1], item->text[1], &b)) {
+                if (branch_taken(item->opcode, (int32_t)a, (int32_t)b)) {
+                    memcpy(item->text[0], item->text[2], PEEP_TEXT);
+                    item->text[1][0] = item->text[2][0] = '\0';
+                    item->opcode = JUMP;
+                    item->operand_count = 1;
+                    program->stats.rewritten++;
+                } else {
+                    remove_item(program, item); // Never taken
+                    continue; // The block goes on
+                }
+            }
+        }
+
+        if (writes_memory(item->opcode)) {
+            forget_locations(state);
+        }
+        if (d >= 0) {
+            memset(&state[d], 0, sizeof(state[d]));
+        }
+        if (ends_block(item->opcode)) {
+            memset(state, 0, sizeof(state));
+        }
+    }
+    symtab_free(&labels);
+}
+
+// Retarget jumps that land on a JUMP, and drop jumps to the next instruction.
+// A landing at the end label of a LOOP is kept: the CPU counts an iteration
+// when the PC reaches that address, so jumping past it would end the loop.
+static void thread_jumps(Program *program) {
+    SymbolTable labels, loop_ends;
+    symtab_init(&labels);
+    symtab_init(&loop_ends);
+    for (size_t i = 0; i < program->count; i++) {
+        const Item *item = &program->items[i];
+        if (item->kind == ITEM_LABEL) {
+            symtab_define(&labels, item->text[0], (uint32_t)i); // Duplicates: the assembler reports them
+        } else if (item->kind == ITEM_INSTRUCTION && item->opcode == LOOP && is_label_text(item->text[1])) {
+            symtab_define(&loop_ends, item->text[1], 1);
+        }
+    }
+
+    for (size_t i = 0; i < program->count; i++) {
+        Item *item = &program->items[i];
+        int operand = item->kind == ITEM_INSTRUCTION && !item->removed ? target_operand(item->opcode) : -1;
+        if (operand < 0 || item->opcode == LOOP || !is_label_text(item->text[operand])) {
+            continue; // LOOP's end label marks a position, not a jump
+        }
+
+        char *target = item->text[operand];
+        char original[PEEP_TEXT];
+        memcpy(original, target, PEEP_TEXT);
+        uint32_t label;
+        for (int hop = 0; hop < PEEP_THREAD_HOPS && symtab_lookup(&labels, target, &label); hop++) {
+            size_t j = label;
+            const Item *landing;
+            int loop_end = 0;
+            uint32_t unused;
+            while ((landing = next_live(program, &j)) && landing->kind == ITEM_LABEL) {
+                loop_end |= symtab_lookup(&loop_ends, landing->text[0], &unused);
+                j++;
+            }
+            if (loop_end || !landing || landing->kind != ITEM_INSTRUCTION || landing->opcode != JUMP ||
+                !is_label_text(landing->text[0]) || strcmp(landing->text[0], target) == 0) {
+                break;
+            }
+            memcpy(target, landing->text[0], PEEP_TEXT);
+        }
+        if (strcmp(target, original) != 0) {
+            program->stats.rewritten++;
+        }
+
+        if (item->opcode == JUMP || item->opcode == JZ || item->opcode == JNZ || is_compare_branch(item->opcode)) {
+            size_t j = i + 1;
+            const Item *next;
+            while ((next = next_live(program, &j)) && next->kind == ITEM_LABEL) {
+                if (strcmp(next->text[0], target) == 0) {
+                    remove_item(program, item); // Lands on the next instruction anyway
+                    break;
+                }
+                j++;
+            }
+        }
+    }
+    symtab_free(&labels);
+    symtab_free(&loop_ends);
+}
+
+// Remove code no path reaches, and register writes nothing reads
+static void remove_dead_code(Program *program) {
+    for (size_t i = 0; i < program->count; i++) {
+        Item *item = &program->items[i];
+        if (item->kind != ITEM_INSTRUCTION || item->removed) {
+            continue;
+        }
+        if (is_unconditional(item->opcode)) {
+            for (size_t j = i + 1; j < program->count && program->items[j].kind == ITEM_INSTRUCTION; j++) {
+                if (!program->items[j].removed) {
+                    remove_item(program, &program->items[j]);
+                }
+            }
+            continue;
+        }
+        int d = destination(item);
+        if (d >= 0 && is_pure(item->opcode) && register_dead_after(program, i, d) &&
+            (!writes_flags(item->opcode) || flags_dead_after(program, i))) {
+            remove_item(program, item);
+        }
+    }
+}
+
+// Emit every item on its original line, so line numbers are unchanged
+static char *render_program(const Program *program, size_t *size) {
+    size_t capacity = 4096, length = 0;
+    char *output = malloc(capacity);
+    uint32_t line = 1;
+    for (size_t i = 0; output && i <= program->count; i++) {
+        const Item *item = i < program->count ? &program->items[i] : NULL;
+        char text[PEEP_LINE_MAX + 8] = "";
+        int n = 0;
+        if (item && !item->removed) {
+            if (item->kind == ITEM_LABEL) {
+                n = snprintf(text, sizeof(text), "%s: ", item->text[0]);
+            } else if (item->kind == ITEM_VERBATIM) {
+                n = snprintf(text, sizeof(text), "%s", item->verbatim);
+            } else {
+                n = snprintf(text, sizeof(text), "%s", opcode_table[item->opcode].mnemonic);
+                for (int k = 0; k < item->operand_count; k++) {
+                    n += snprintf(text + n, sizeof(text) - (size_t)n, "%s%s", k ? ", " : " ", item->text[k]);
+                }
+            }
+        }
+        uint32_t target = item ? item->line : line + 1;
+        size_t needed = length + (target > line ? target - line : 0) + (size_t)n + 2;
+        if (needed > capacity) {
+            while (needed > capacity) {
+                capacity *= 2;
+            }
+            char *grown = realloc(output, capacity);
+            if (!grown) {
+                free(output);
+                return NULL;
+            }
+            output = grown;
+        }
+        for (; line < target; line++) {
+            output[length++] = '\n';
+        }
+        memcpy(output + length, text, (size_t)n);
+        length += (size_t)n;
+    }
+    if (output) {
+        output[length] = '\0';
+    }
+    *size = length;
+    return output;
+}
+
+char *peephole_optimize(const char *source, size_t size, size_t *optimized_size, PeepholeStats *stats) {
+    Program program;
+    memset(&program, 0, sizeof(program));
+    char *output = NULL;
+    if (parse_program(&program, source, size) == 0) {
+        for (int round = 0; round < PEEP_MAX_ROUNDS; round++) {
+            PeepholeStats before = program.stats;
+            propagate_values(&program);
+            thread_jumps(&program);
+            remove_dead_code(&program);
+            if (program.stats.removed == before.removed && program.stats.rewritten == before.rewritten) {
+                break;
+            }
+        }
+        output = render_program(&program, optimized_size);
+    }
+    *stats = program.stats;
+    for (size_t i = 0; i < program.count; i++) {
+        free(program.items[i].verbatim);
+    }
+    free(program.items);
+    return output;
+}
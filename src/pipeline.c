@@ -0,0 +1,108 @@
+#include "pipeline.h"
+#include "hll_translator.h"
+#include "linker.h"
+#include "memory.h"
+#include "object.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static int is_hll(const char *name, SourceKind kind) {
+    if (kind != SOURCE_AUTO) {
+        return kind == SOURCE_HLL;
+    }
+    const char *extension = strrchr(name, '.');
+    return extension && strcmp(extension, ".hll") == 0;
+}
+
+static int save_text(const char *path, const char *text, size_t size) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file '%s'.\n", path);
+        return -1;
+    }
+    int status = fwrite(text, 1, size, file) == size ? 0 : -1;
+    if (fclose(file) != 0 || status != 0) {
+        fprintf(stderr, "Error: Failed to write '%s'.\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int load_source(CPU *cpu, const char *source, size_t size, const char *name, const PipelineOptions *options) {
+    const char *assembly = source;
+    size_t assembly_size = size;
+    char *translated = NULL;
+    if (is_hll(name, options->kind)) {
+        IrStats stats;
+        translated = translate_hll_to_buffer(source, options->passes, &assembly_size, &stats);
+        if (!translated) {
+            fprintf(stderr, "Error: Translation of '%s' failed.\n", name);
+            return -1;
+        }
+        printf("Translated: %s (%u instructions, %u of %u values in registers)\n",
+               name, stats.instructions, stats.values - stats.spilled, stats.values);
+        assembly = translated;
+        if (options->save_asm && save_text(options->save_asm, assembly, assembly_size) != 0) {
+            free(translated);
+            return -1;
+        }
+    }
+
+    ObjectFile executable;
+    int status = assemble_buffer(assembly, assembly_size, name, options->optimize, &executable);
+    free(translated);
+    if (status != 0) {
+        fprintf(stderr, "Error: Assembly of '%s' failed.\n", name);
+        return -1;
+    }
+    if (options->save_bin) {
+        status = object_write(options->save_bin, &executable);
+    }
+    if (status == 0) {
+        status = load_executable_object(cpu, &executable, name);
+    }
+    object_close(&executable);
+    return status;
+}
+
+int load_source_file(CPU *cpu, const char *path, const PipelineOptions *options) {
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Error: Cannot open file '%s'.\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    size_t size = (size_t)info.st_size;
+    char *source = malloc(size + 1);
+    if (!source) {
+        fprintf(stderr, "Error: Out of memory reading '%s'.\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t count = read(fd, source + done, size - done);
+        if (count <= 0) {
+            break;
+        }
+        done += (size_t)count;
+    }
+    close(fd);
+    if (done != size) {
+        fprintf(stderr, "Error: Cannot read file '%s'.\n", path);
+        free(source);
+        return -1;
+    }
+    source[size] = '\0'; // The translator reads a C string
+
+    int status = load_source(cpu, source, size, path, options);
+    free(source);
+    return status;
+}
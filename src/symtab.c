@@ -0,0 +1,127 @@
+#include "symtab.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// FNV-1a; never returns 0, which marks an empty slot
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (; *name; name++) {
+        hash ^= (uint8_t)*name;
+        hash *= 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+static void *checked_realloc(void *block, size_t size) {
+    void *grown = realloc(block, size);
+    if (!grown) {
+        fprintf(stderr, "Error: Out of memory growing the symbol table.\n");
+        exit(EXIT_FAILURE);
+    }
+    return grown;
+}
+
+// Slot holding name, or the empty slot where it would be inserted
+static uint32_t find_slot(const SymbolTable *table, const char *name, uint32_t hash) {
+    uint32_t mask = table->capacity - 1;
+    uint32_t slot = hash & mask;
+    while (table->entries[slot].hash != 0) {
+        const SymbolEntry *entry = &table->entries[slot];
+        if (entry->hash == hash && strcmp(table->strings + entry->name, name) == 0) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void grow_entries(SymbolTable *table) {
+    SymbolEntry *old = table->entries;
+    uint32_t old_capacity = table->capacity;
+
+    table->capacity = old_capacity * 2;
+    table->entries = calloc(table->capacity, sizeof(SymbolEntry));
+    if (!table->entries) {
+        fprintf(stderr, "Error: Out of memory growing the symbol table.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old[i].hash != 0) {
+            uint32_t mask = table->capacity - 1;
+            uint32_t slot = old[i].hash & mask;
+            while (table->entries[slot].hash != 0) {
+                slot = (slot + 1) & mask;
+            }
+            table->entries[slot] = old[i];
+        }
+    }
+    free(old);
+}
+
+// Copy a name into the arena and return its offset
+static uint32_t intern(SymbolTable *table, const char *name) {
+    size_t length = strlen(name) + 1;
+    if (table->strings_used + length > table->strings_capacity) {
+        size_t capacity = table->strings_capacity ? table->strings_capacity : 1024;
+        while (table->strings_used + length > capacity) {
+            capacity *= 2;
+        }
+        table->strings = checked_realloc(table->strings, capacity);
+        table->strings_capacity = capacity;
+    }
+    uint32_t offset = (uint32_t)table->strings_used;
+    memcpy(table->strings + offset, name, length);
+    table->strings_used += length;
+    return offset;
+}
+
+void symtab_init(SymbolTable *table) {
+    memset(table, 0, sizeof(*table));
+    table->capacity = SYMTAB_INITIAL_CAPACITY;
+    table->entries = calloc(table->capacity, sizeof(SymbolEntry));
+    if (!table->entries) {
+        fprintf(stderr, "Error: Out of memory creating the symbol table.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void symtab_free(SymbolTable *table) {
+    free(table->entries);
+    free(table->strings);
+    memset(table, 0, sizeof(*table));
+}
+
+int symtab_define(SymbolTable *table, const char *name, uint32_t address) {
+    if ((table->count + 1) * 4 > table->capacity * 3) {
+        grow_entries(table); // Keep the load factor at or below 3/4
+    }
+    uint32_t hash = hash_name(name);
+    uint32_t slot = find_slot(table, name, hash);
+    if (table->entries[slot].hash != 0) {
+        return -1;
+    }
+    table->entries[slot].name = intern(table, name);
+    table->entries[slot].hash = hash;
+    table->entries[slot].address = address;
+    table->count++;
+    return 0;
+}
+
+int symtab_lookup(const SymbolTable *table, const char *name, uint32_t *address) {
+    uint32_t slot = find_slot(table, name, hash_name(name));
+    if (table->entries[slot].hash == 0) {
+        return 0;
+    }
+    *address = table->entries[slot].address;
+    return 1;
+}
+
+int symtab_update(SymbolTable *table, const char *name, uint32_t address) {
+    uint32_t slot = find_slot(table, name, hash_name(name));
+    if (table->entries[slot].hash == 0) {
+        return -1;
+    }
+    table->entries[slot].address = address;
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "vector.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+
+#ifdef __SSE2__
+// Registers are 16-byte aligned, so aligned loads/stores are safe
+#define LOAD_V(v) _mm_load_si128((const __m128i *)(v)->lanes)
+#define STORE_V(v, x) _mm_store_si128((__m128i *)(v)->lanes, (x))
+#endif
+
+void vector_add(VectorRegister *d, const VectorRegister *a, const VectorRegister *b) {
+#ifdef __SSE2__
+    STORE_V(d, _mm_add_epi32(LOAD_V(a), LOAD_V(b)));
+#else
+    for (int i = 0; i < VECTOR_LANES; i++) d->lanes[i] = a->lanes[i] + b->lanes[i];
+#endif
+}
+
+void vector_sub(VectorRegister *d, const VectorRegister *a, const VectorRegister *b) {
+#ifdef __SSE2__
+    STORE_V(d, _mm_sub_epi32(LOAD_V(a), LOAD_V(b)));
+#else
+    for (int i = 0; i < VECTOR_LANES; i++) d->lanes[i] = a->lanes[i] - b->lanes[i];
+#endif
+}
+
+void vector_mul(VectorRegister *d, const VectorRegister *a, const VectorRegister *b) {
+#ifdef __SSE4_1__
+    STORE_V(d, _mm_mullo_epi32(LOAD_V(a), LOAD_V(b)));
+#else
+    // SSE2 has no 32-bit low multiply; the compiler vectorizes this loop where it can
+    for (int i = 0; i < VECTOR_LANES; i++) d->lanes[i] = a->lanes[i] * b->lanes[i];
+#endif
+}
+
+void vector_and(VectorRegister *d, const VectorRegister *a, const VectorRegister *b) {
+#ifdef __SSE2__
+    STORE_V(d, _mm_and_si128(LOAD_V(a), LOAD_V(b)));
+#else
+    for (int i = 0; i < VECTOR_LANES; i++) d->lanes[i] = a->lanes[i] & b->lanes[i];
+#endif
+}
+
+void vector_or(VectorRegister *d, const VectorRegister *a, const VectorRegister *b) {
+#ifdef __SSE2__
+    STORE_V(d, _mm_or_si128(LOAD_V(a), LOAD_V(b)));
+#else
+    for (int i = 0; i < VECTOR_LANES; i++) d->lanes[i] = a->lanes[i] | b->lanes[i];
+#endif
+}
+
+void vector_xor(VectorRegister *d, const VectorRegister *a, const VectorRegister *b) {
+#ifdef __SSE2__
+    STORE_V(d, _mm_xor_si128(LOAD_V(a), LOAD_V(b)));
+#else
+    for (int i = 0; i < VECTOR_LANES; i++) d->lanes[i] = a->lanes[i] ^ b->lanes[i];
+#endif
+}
+
+bool vector_cmpeq(VectorRegister *d, const VectorRegister *a, const VectorRegister *b) {
+#ifdef __SSE2__
+    __m128i mask = _mm_cmpeq_epi32(LOAD_V(a), LOAD_V(b));
+    STORE_V(d, mask);
+    return _mm_movemask_epi8(mask) == 0xFFFF;
+#else
+    bool all_equal = true;
+    for (int i = 0; i < VECTOR_LANES; i++) {
+        d->lanes[i] = (a->lanes[i] == b->lanes[i]) ? 0xFFFFFFFFu : 0;
+        all_equal = all_equal && d->lanes[i];
+    }
+    return all_equal;
+#endif
+}